@@ -0,0 +1,301 @@
+// made by inny
+
+#include <algorithm>
+#include "column.h"
+#include "epoch.h"
+#include "workers.h"
+#include "world.h"
+#include "blocksim.h"
+
+using namespace std;
+
+// the six faces, then the four cells a block could slide down from
+static const int WAKE = 10;
+static const int wakeOffsets[WAKE][3] = {
+  { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 },
+  { 1, 1, 0 }, { -1, 1, 0 }, { 0, 1, 1 }, { 0, 1, -1 }
+};
+
+static const int sides[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+BlockSim::Active::Active( Chunk *c )
+  : chunk(c), x(c->x()), y(c->y()), z(c->z()),
+    queued( Chunk::VOLUME, 0 ), moved( Chunk::VOLUME, 0 ), idle(0)
+{
+  /* */
+}
+
+BlockSim::BlockSim( World &w, WorkerPool &p )
+  : world(w), pool(p), ticks(0), cellsRun(0), cellsChanged(0)
+{
+  /* */
+}
+
+BlockSim::~BlockSim()
+{
+  for ( ActiveMap::iterator it = active.begin(); it != active.end(); ++it )
+    delete it->second;
+}
+
+BlockSim::Active *BlockSim::activity( Chunk *c )
+{
+  ActiveMap::iterator finder = active.find( c );
+  if ( finder != active.end() ) return finder->second;
+
+  Active *a = new Active( c );
+  active[c] = a;
+  return a;
+}
+
+// never creates anything, so it's safe from inside a phase
+BlockSim::Active *BlockSim::activityAt( int x, int y, int z, int &cell )
+{
+  Chunk *c = world.chunkAt( x, y, z );
+  if (!c) return 0;
+
+  ActiveMap::iterator finder = active.find( c );
+  if ( finder == active.end() ) return 0;
+
+  cell = Chunk::cell( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK );
+  return finder->second;
+}
+
+void BlockSim::queue( Active *a, int cell )
+{
+  if ( a->queued[cell] ) return;
+  a->queued[cell] = 1;
+  a->back.push_back( cell );
+}
+
+// -----------------------------------------------------------------------------
+
+void BlockSim::wake( int x, int y, int z )
+{
+  Chunk *c = world.chunkAt( x, y, z );
+  if (!c) return;
+  queue( activity(c), Chunk::cell( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK ) );
+}
+
+void BlockSim::place( int x, int y, int z, unsigned short type )
+{
+  Chunk *c = world.chunkAt( x, y, z );
+  if (!c) return;
+  c->setTypeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK, type );
+
+  wake( x, y, z );
+  for ( int i = 0; i < WAKE; i++ )
+    wake( x+wakeOffsets[i][0], y+wakeOffsets[i][1], z+wakeOffsets[i][2] );
+
+  recull( x, y, z );
+  remesh();
+}
+
+unsigned short BlockSim::get( Active &a, int x, int y, int z )
+{
+  const int lx = x - a.x, ly = y - a.y, lz = z - a.z;
+  if ( Chunk::contains( lx, ly, lz ) ) return a.chunk->typeAt( lx, ly, lz );
+
+  // nothing flows out of the loaded world
+  Chunk *c = world.chunkAt( x, y, z );
+  if (!c) return Voxel::STONE;
+  return c->typeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK );
+}
+
+void BlockSim::set( Active &a, int x, int y, int z, unsigned short type )
+{
+  int cell;
+  Active *target = activityAt( x, y, z, cell );
+  if (!target) return;
+
+  target->chunk->writeTypeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK, type );
+  target->moved[cell] = 1;
+  a.marks.push_back( make_pair( target, cell ) );
+  a.changes.push_back( Cell(x, y, z) );
+  wakeAround( a, x, y, z );
+}
+
+void BlockSim::wakeAround( Active &a, int x, int y, int z )
+{
+  int cell;
+  Active *target = activityAt( x, y, z, cell );
+  if (target) a.wakes.push_back( make_pair( target, cell ) );
+
+  for ( int i = 0; i < WAKE; i++ ) {
+    target = activityAt( x+wakeOffsets[i][0], y+wakeOffsets[i][1], z+wakeOffsets[i][2], cell );
+    if (target) a.wakes.push_back( make_pair( target, cell ) );
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void BlockSim::runSand( Active &a, int x, int y, int z )
+{
+  const unsigned short below = get( a, x, y-1, z );
+  if ( below == Voxel::AIR || Voxel::isWater(below) ) {
+    set( a, x, y-1, z, Voxel::SAND );
+    set( a, x, y, z, below );
+    return;
+  }
+
+  // slide off a ledge, starting from a different side each time
+  const unsigned int start = ( (x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u) ^ ticks ) >> 4;
+  for ( int k = 0; k < 4; k++ ) {
+    const int *d = sides[ (start + k) & 3 ];
+    if ( get( a, x+d[0], y, z+d[1] ) != Voxel::AIR ) continue;
+    const unsigned short under = get( a, x+d[0], y-1, z+d[1] );
+    if ( under != Voxel::AIR && !Voxel::isWater(under) ) continue;
+
+    set( a, x+d[0], y-1, z+d[1], Voxel::SAND );
+    set( a, x, y, z, under );
+    return;
+  }
+}
+
+void BlockSim::runWater( Active &a, int x, int y, int z, unsigned short type )
+{
+  const unsigned short full = Voxel::WATER + Voxel::WATER_LEVELS - 1;
+
+  if ( get( a, x, y-1, z ) == Voxel::AIR ) {
+    set( a, x, y-1, z, full );
+    return;
+  }
+
+  // each step sideways costs a level, so a spill stops on its own
+  if ( type == Voxel::WATER ) return;
+  for ( int k = 0; k < 4; k++ ) {
+    const int *d = sides[k];
+    const unsigned short side = get( a, x+d[0], y, z+d[1] );
+    if ( side == Voxel::AIR || (Voxel::isWater(side) && side < type-1) )
+      set( a, x+d[0], y, z+d[1], type-1 );
+  }
+}
+
+void BlockSim::run( Active &a )
+{
+  for ( int i = 0; i < a.front.size(); i++ ) {
+    const int cell = a.front[i];
+    if ( a.moved[cell] ) continue;
+
+    int lx, ly, lz;
+    Chunk::cellCoords( cell, lx, ly, lz );
+    const unsigned short type = a.chunk->typeAt( lx, ly, lz );
+
+    if ( type == Voxel::SAND )
+      runSand( a, a.x+lx, a.y+ly, a.z+lz );
+    else if ( Voxel::isWater(type) )
+      runWater( a, a.x+lx, a.y+ly, a.z+lz, type );
+  }
+}
+
+// jobs in one column would share its tops, so they're raised after the phases
+void BlockSim::raise( int x, int y, int z )
+{
+  Chunk *c = world.chunkAt( x, y, z );
+  if ( !c || !c->columnOf() ) return;
+  const int lx = x & Chunk::XMASK, lz = z & Chunk::ZMASK;
+  if ( c->typeAt( lx, y & Chunk::YMASK, lz ) ) c->columnOf()->raise( lx, y, lz );
+}
+
+// fixes the face masks of a changed cell and the six around it
+void BlockSim::recull( int x, int y, int z )
+{
+  for ( int i = 0; i <= 6; i++ ) {
+    const int cx = x + (i < 6 ? wakeOffsets[i][0] : 0);
+    const int cy = y + (i < 6 ? wakeOffsets[i][1] : 0);
+    const int cz = z + (i < 6 ? wakeOffsets[i][2] : 0);
+    Chunk *c = world.chunkAt( cx, cy, cz );
+    if (!c) continue;
+    c->cullCell( cx & Chunk::XMASK, cy & Chunk::YMASK, cz & Chunk::ZMASK );
+    dirty.push_back( c );
+  }
+}
+
+// only the chunks something changed in get their meshes rebuilt
+void BlockSim::remesh()
+{
+  sort( dirty.begin(), dirty.end() );
+  dirty.erase( unique( dirty.begin(), dirty.end() ), dirty.end() );
+  for ( int i = 0; i < dirty.size(); i++ ) dirty[i]->invalidateMesh();
+  dirty.clear();
+}
+
+void BlockSim::tick()
+{
+  ticks++;
+  cellsRun = 0;
+  cellsChanged = 0;
+
+  // last tick's queue becomes this tick's work; quiet chunks retire
+  vector<Active*> busy;
+  ActiveMap::iterator it = active.begin();
+  while ( it != active.end() ) {
+    Active *a = it->second;
+    a->front.swap( a->back );
+    a->back.clear();
+    for ( int i = 0; i < a->front.size(); i++ ) a->queued[ a->front[i] ] = 0;
+
+    if ( !a->front.empty() ) {
+      a->idle = 0;
+      busy.push_back( a );
+    }
+    else if ( ++a->idle > IDLE_TICKS ) {
+      delete a;
+      active.erase( it++ );
+      continue;
+    }
+    ++it;
+  }
+
+  // jobs may write one cell into any neighbour, which needs bookkeeping.
+  // Two jobs of a phase can write the same neighbour, so one that's empty
+  // gets its arrays here rather than from both at once. Nothing moves up,
+  // and a chunk with no blocks has nothing to move
+  for ( int i = 0; i < busy.size(); i++ ) {
+    const bool moves = !busy[i]->chunk->isEmpty();
+    for ( int dz = -1; dz <= 1; dz++ )
+      for ( int dy = -1; dy <= 1; dy++ )
+        for ( int dx = -1; dx <= 1; dx++ ) {
+          Chunk *c = world.chunkAt( busy[i]->x + dx*Chunk::XSIZE,
+                                    busy[i]->y + dy*Chunk::YSIZE,
+                                    busy[i]->z + dz*Chunk::ZSIZE );
+          if (!c) continue;
+          activity( c );
+          if ( moves && dy <= 0 ) c->own();
+        }
+  }
+
+  for ( int p = 0; p < 8; p++ ) phases[p].clear();
+  for ( int i = 0; i < busy.size(); i++ ) {
+    const int p = ( (busy[i]->x >> Chunk::XSHIFT) & 1 ) |
+                  ( ((busy[i]->y >> Chunk::YSHIFT) & 1) << 1 ) |
+                  ( ((busy[i]->z >> Chunk::ZSHIFT) & 1) << 2 );
+    phases[p].push_back( busy[i] );
+    cellsRun += busy[i]->front.size();
+  }
+
+  for ( int p = 0; p < 8; p++ ) {
+    vector<Active*> &phase = phases[p];
+    pool.run( phase.size(), [&]( int k ) {
+      Epoch::Guard guard;
+      run( *phase[k] );
+    });
+  }
+
+  for ( int i = 0; i < busy.size(); i++ ) {
+    Active *a = busy[i];
+    for ( int k = 0; k < a->wakes.size(); k++ ) queue( a->wakes[k].first, a->wakes[k].second );
+    for ( int k = 0; k < a->marks.size(); k++ ) a->marks[k].first->moved[ a->marks[k].second ] = 0;
+
+    for ( int k = 0; k < a->changes.size(); k++ ) {
+      raise( a->changes[k].x, a->changes[k].y, a->changes[k].z );
+      recull( a->changes[k].x, a->changes[k].y, a->changes[k].z );
+    }
+    cellsChanged += a->changes.size();
+
+    a->wakes.clear();
+    a->marks.clear();
+    a->changes.clear();
+  }
+
+  remesh();
+}
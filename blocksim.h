@@ -0,0 +1,98 @@
+// made by inny
+
+#ifndef OPENMINE_BLOCKSIM_H
+#define OPENMINE_BLOCKSIM_H
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "chunk.h"
+
+class World;
+class WorkerPool;
+
+// Falling sand and spreading water. Only cells that changed last tick, or
+// sit next to a change, get looked at, so a still world costs nothing.
+//
+// A tick runs in eight phases, one per parity of the chunk coordinates.
+// Chunks of one parity are a whole chunk apart, and an update only reaches
+// one cell out, so the chunks of a phase run on the pool without locks.
+// Anything a job wants to tell another chunk waits in its own lists until
+// the phase ends, and whatever chunks share, their arrays being made or
+// their column's tops, is seen to on the calling thread around the phases.
+class BlockSim
+{
+  protected:
+    struct Cell
+    {
+      int x, y, z;
+      Cell( int xx=0, int yy=0, int zz=0 ) : x(xx), y(yy), z(zz) { /* */ };
+    };
+
+    struct Active
+    {
+      Chunk *chunk;
+      int x, y, z;
+
+      // this tick's cells and the next one's, as Chunk::cell indices
+      std::vector<int> front;
+      std::vector<int> back;
+      std::vector<unsigned char> queued;
+
+      // cells written this tick, so nothing moves twice
+      std::vector<unsigned char> moved;
+      int idle;
+
+      // filled by this chunk's job, applied between phases
+      std::vector< std::pair<Active*, int> > wakes;
+      std::vector< std::pair<Active*, int> > marks;
+      std::vector<Cell> changes;
+
+      Active( Chunk *c );
+    };
+
+    World &world;
+    WorkerPool &pool;
+
+    typedef std::map<Chunk*, Active*> ActiveMap;
+    ActiveMap active;
+    std::vector<Active*> phases[8];
+    std::vector<Chunk*> dirty;
+
+    int ticks;
+    int cellsRun;
+    int cellsChanged;
+
+    Active *activity( Chunk *c );
+    Active *activityAt( int x, int y, int z, int &cell );
+    void queue( Active *a, int cell );
+
+    void run( Active &a );
+    void runSand( Active &a, int x, int y, int z );
+    void runWater( Active &a, int x, int y, int z, unsigned short type );
+
+    unsigned short get( Active &a, int x, int y, int z );
+    void set( Active &a, int x, int y, int z, unsigned short type );
+    void wakeAround( Active &a, int x, int y, int z );
+    void raise( int x, int y, int z );
+    void recull( int x, int y, int z );
+    void remesh();
+
+  public:
+    // chunks idle this many ticks let go of their bookkeeping
+    static const int IDLE_TICKS = 20;
+
+    BlockSim( World &w, WorkerPool &p );
+    virtual ~BlockSim();
+
+    // sets a block and wakes it and its neighbours
+    void place( int x, int y, int z, unsigned short type );
+    void wake( int x, int y, int z );
+    void tick();
+
+    int lastRun() const { return cellsRun; };
+    int lastChanged() const { return cellsChanged; };
+    int activeChunks() const { return active.size(); };
+};
+
+#endif
@@ -0,0 +1,171 @@
+// made by inny
+
+#include <algorithm>
+#include <cmath>
+#include "util.h"
+#include "workers.h"
+#include "world.h"
+#include "bulkedit.h"
+
+using namespace std;
+
+BulkEdit::BulkEdit( World &w )
+  : world(w), chunksCulled(0), cullTime(0.0)
+{
+  /* */
+}
+
+// calls f( chunk, origin x y z, local box x0 y0 z0 x1 y1 z1 ) for every
+// loaded chunk the box reaches into
+template<typename F>
+void BulkEdit::eachChunk( int x0, int y0, int z0, int x1, int y1, int z1, F f )
+{
+  if ( x0 >= x1 || y0 >= y1 || z0 >= z1 ) return;
+
+  for ( int cz = z0 & ~Chunk::ZMASK; cz < z1; cz += Chunk::ZSIZE ) {
+    for ( int cy = y0 & ~Chunk::YMASK; cy < y1; cy += Chunk::YSIZE ) {
+      for ( int cx = x0 & ~Chunk::XMASK; cx < x1; cx += Chunk::XSIZE ) {
+        Chunk *c = world.chunkAt( cx, cy, cz );
+        if (!c) continue;
+        f( c, cx, cy, cz,
+           max( x0 - cx, 0 ), max( y0 - cy, 0 ), max( z0 - cz, 0 ),
+           min( x1 - cx, int(Chunk::XSIZE) ), min( y1 - cy, int(Chunk::YSIZE) ),
+           min( z1 - cz, int(Chunk::ZSIZE) ) );
+      }
+    }
+  }
+}
+
+// the face masks that can have changed are the box's cells and the ones
+// just outside it; chunks only read their neighbours' types, so they cull
+// side by side on the pool
+void BulkEdit::recull( int x0, int y0, int z0, int x1, int y1, int z1 )
+{
+  struct Job
+  {
+    Chunk *chunk;
+    Chunk *near[27];
+    int x0, y0, z0, x1, y1, z1;
+  };
+
+  const double start = seconds();
+  vector<Job> jobs;
+  eachChunk( x0-1, y0-1, z0-1, x1+1, y1+1, z1+1,
+    [&]( Chunk *c, int cx, int cy, int cz,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      Job job;
+      job.chunk = c;
+      for ( int dz = -1; dz <= 1; dz++ )
+        for ( int dy = -1; dy <= 1; dy++ )
+          for ( int dx = -1; dx <= 1; dx++ )
+            job.near[ (dx+1) + (dy+1)*3 + (dz+1)*9 ] =
+              world.chunkAt( cx + dx*Chunk::XSIZE, cy + dy*Chunk::YSIZE, cz + dz*Chunk::ZSIZE );
+      job.x0 = lx0; job.y0 = ly0; job.z0 = lz0;
+      job.x1 = lx1; job.y1 = ly1; job.z1 = lz1;
+      jobs.push_back( job );
+    });
+
+  world.workers().run( jobs.size(), [&]( int i ) {
+    const Job &job = jobs[i];
+    job.chunk->cullCells( job.near, job.x0, job.y0, job.z0, job.x1, job.y1, job.z1 );
+  });
+
+  // regions keep one dirty flag for all their members, so this stays here
+  for ( int i = 0; i < jobs.size(); i++ ) jobs[i].chunk->invalidateMesh();
+
+  chunksCulled = jobs.size();
+  cullTime = seconds() - start;
+}
+
+// -----------------------------------------------------------------------------
+
+long BulkEdit::fill( int x0, int y0, int z0, int x1, int y1, int z1, unsigned short type )
+{
+  long written = 0;
+  eachChunk( x0, y0, z0, x1, y1, z1,
+    [&]( Chunk *c, int, int, int,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      c->fillBox( lx0, ly0, lz0, lx1, ly1, lz1, type );
+      written += long(lx1 - lx0) * (ly1 - ly0) * (lz1 - lz0);
+    });
+  recull( x0, y0, z0, x1, y1, z1 );
+  return written;
+}
+
+long BulkEdit::replace( int x0, int y0, int z0, int x1, int y1, int z1,
+                        unsigned short from, unsigned short to )
+{
+  long written = 0;
+  eachChunk( x0, y0, z0, x1, y1, z1,
+    [&]( Chunk *c, int, int, int,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      for ( int z = lz0; z < lz1; z++ )
+        for ( int y = ly0; y < ly1; y++ )
+          written += c->replaceRow( lx0, lx1, y, z, from, to );
+    });
+  recull( x0, y0, z0, x1, y1, z1 );
+  return written;
+}
+
+long BulkEdit::carve( float cx, float cy, float cz, float radius, unsigned short type )
+{
+  const int x0 = floor( cx - radius ), x1 = floor( cx + radius ) + 1;
+  const int y0 = floor( cy - radius ), y1 = floor( cy + radius ) + 1;
+  const int z0 = floor( cz - radius ), z1 = floor( cz + radius ) + 1;
+  const float r2 = radius * radius;
+
+  long written = 0;
+  eachChunk( x0, y0, z0, x1, y1, z1,
+    [&]( Chunk *c, int ox, int oy, int oz,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      for ( int z = lz0; z < lz1; z++ ) {
+        const float dz = oz + z + 0.5f - cz;
+        for ( int y = ly0; y < ly1; y++ ) {
+          const float dy = oy + y + 0.5f - cy;
+          const float rest = r2 - dy*dy - dz*dz;
+          if ( rest < 0.0f ) continue;
+
+          // the run of cell centres this row has inside the sphere
+          const float h = sqrt( rest );
+          const int sx0 = max( int(ceil( cx - h - 0.5f )) - ox, lx0 );
+          const int sx1 = min( int(floor( cx + h - 0.5f )) + 1 - ox, lx1 );
+          if ( sx0 >= sx1 ) continue;
+          c->fillRow( sx0, sx1, y, z, type );
+          written += sx1 - sx0;
+        }
+      }
+    });
+  recull( x0, y0, z0, x1, y1, z1 );
+  return written;
+}
+
+void BulkEdit::copy( int x0, int y0, int z0, int x1, int y1, int z1, Schematic &out )
+{
+  out.xsize = max( x1 - x0, 0 );
+  out.ysize = max( y1 - y0, 0 );
+  out.zsize = max( z1 - z0, 0 );
+  out.types.assign( out.volume(), Voxel::AIR );
+
+  eachChunk( x0, y0, z0, x1, y1, z1,
+    [&]( Chunk *c, int cx, int cy, int cz,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      for ( int z = lz0; z < lz1; z++ )
+        for ( int y = ly0; y < ly1; y++ )
+          c->readRow( lx0, lx1, y, z, out.row( cy+y-y0, cz+z-z0 ) + (cx+lx0-x0) );
+    });
+}
+
+long BulkEdit::paste( const Schematic &in, int x, int y, int z )
+{
+  long written = 0;
+  eachChunk( x, y, z, x + in.xsize, y + in.ysize, z + in.zsize,
+    [&]( Chunk *c, int cx, int cy, int cz,
+         int lx0, int ly0, int lz0, int lx1, int ly1, int lz1 ) {
+      for ( int lz = lz0; lz < lz1; lz++ )
+        for ( int ly = ly0; ly < ly1; ly++ )
+          c->writeRow( lx0, lx1, ly, lz, in.row( cy+ly-y, cz+lz-z ) + (cx+lx0-x) );
+      written += long(lx1 - lx0) * (ly1 - ly0) * (lz1 - lz0);
+    });
+  recull( x, y, z, x + in.xsize, y + in.ysize, z + in.zsize );
+  return written;
+}
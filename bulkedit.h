@@ -0,0 +1,67 @@
+// made by inny
+
+#ifndef OPENMINE_BULKEDIT_H
+#define OPENMINE_BULKEDIT_H
+
+#include <vector>
+#include "chunk.h"
+
+class World;
+
+// A box of block types lifted out of the world, x fastest, then y, then z.
+struct Schematic
+{
+  int xsize;
+  int ysize;
+  int zsize;
+  std::vector<unsigned short> types;
+
+  Schematic() : xsize(0), ysize(0), zsize(0) { /* */ };
+  long volume() const { return long(xsize) * ysize * zsize; };
+  unsigned short *row( int y, int z ) { return &types[ (long(z) * ysize + y) * xsize ]; };
+  const unsigned short *row( int y, int z ) const { return &types[ (long(z) * ysize + y) * xsize ]; };
+};
+
+// Edits lots of blocks at once. Each operation walks the chunks under its
+// box and writes whole rows of Chunk types at a time, then every chunk it
+// wrote to, and any neighbour sharing a face with the box, gets the cells
+// around the box re-culled and its mesh invalidated exactly once. Boxes are
+// world coordinates, [x0, x1) [y0, y1) [z0, z1); blocks in chunks that
+// aren't loaded are left alone.
+//
+// Nothing here takes World::editLock(), hold it when calling from outside
+// World::update(). Falling blocks aren't woken either.
+class BulkEdit
+{
+  protected:
+    World &world;
+
+    // the chunks the last operation re-culled and how long that took
+    int chunksCulled;
+    double cullTime;
+
+    template<typename F>
+    void eachChunk( int x0, int y0, int z0, int x1, int y1, int z1, F f );
+    void recull( int x0, int y0, int z0, int x1, int y1, int z1 );
+
+  public:
+    BulkEdit( World &w );
+
+    // each returns the number of blocks written
+    long fill( int x0, int y0, int z0, int x1, int y1, int z1, unsigned short type );
+    long replace( int x0, int y0, int z0, int x1, int y1, int z1,
+                  unsigned short from, unsigned short to );
+
+    // every block whose centre lies within radius of the centre
+    long carve( float cx, float cy, float cz, float radius,
+                unsigned short type = Voxel::AIR );
+
+    // copy() sizes the schematic to the box; unloaded blocks come out as air
+    void copy( int x0, int y0, int z0, int x1, int y1, int z1, Schematic &out );
+    long paste( const Schematic &in, int x, int y, int z );
+
+    int lastChunks() const { return chunksCulled; };
+    double lastCullSeconds() const { return cullTime; };
+};
+
+#endif
@@ -0,0 +1,277 @@
+// made by inny
+
+#include <cmath>
+#include "opengl.h"
+#include "camera.h"
+
+using namespace std;
+
+Camera::Camera( float x, float y, float z, float xr, float yr )
+  : xpos(x), ypos(y), zpos(z), xrot(xr), yrot(yr), viewDist(80.0),
+    fogged(false), lensFovy(45.0), lensAspect(4.0 / 3.0), updated(true)
+{
+  /* */
+}
+
+void Camera::teleport( float x, float y, float z )
+{
+  updated = true;
+  xpos = x;
+  ypos = y;
+  zpos = z;
+}
+
+void Camera::walk( float amount )
+{
+  updated = true;
+  float yrotrad = yrot / 180.0 * M_PI;
+  xpos += amount * float(sin(yrotrad)) ;
+  zpos -= amount * float(cos(yrotrad)) ;
+}
+
+void Camera::ascend( float amount )
+{
+  updated = true;
+  ypos += amount;
+}
+
+void Camera::strafe( float amount )
+{
+  updated = true;
+  float rot = yrot + 90.0f;
+  while (rot > 360.0f) rot -= 360.0f;
+
+  float yrotrad = rot / 180.0 * M_PI;
+  xpos += amount * float(sin(yrotrad)) ;
+  zpos -= amount * float(cos(yrotrad)) ;
+}
+
+void Camera::turn( float amount )
+{
+  updated = true;
+  yrot += amount;
+  while ( yrot < -360.0f ) yrot += 360.0f;
+  while ( yrot >  360.0f ) yrot -= 360.0f;
+}
+
+void Camera::look( float amount )
+{
+  updated = true;
+  xrot += amount;
+
+  if ( xrot > 90.0f ) xrot = 90.0f;
+  if ( xrot < -90.0f ) xrot = -90.0f;
+}
+
+void Camera::orient( float xr, float yr )
+{
+  updated = true;
+  xrot = 0.0;
+  yrot = 0.0;
+  look( xr );
+  turn( yr );
+}
+
+void Camera::setLens( float fovy, float aspect )
+{
+  if ( fovy == lensFovy && aspect == lensAspect ) return;
+  updated = true;
+  lensFovy = fovy;
+  lensAspect = aspect;
+}
+
+void Camera::set3DPerspective( float fovy, float aspect )
+{
+  setLens( fovy, aspect );
+
+  const float zmin = 0.25;
+  const float zmax = viewDist;
+
+  GLfloat xmin, xmax, ymin, ymax;
+  ymax = zmin * tan(fovy * M_PI / 360.0);
+  ymin = -ymax;
+  xmin = ymin * aspect;
+  xmax = ymax * aspect;
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glFrustum(xmin, xmax, ymin, ymax, zmin, zmax);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+}
+
+void Camera::fogRange( float &start, float &end ) const
+{
+  end = viewDistance() * ( 72.0 / 80.0 );
+  start = end * ( 56.0 / 72.0 );
+}
+
+void Camera::adjustGL()
+{
+  // Should be on the MODELVIEW Matrix
+  glRotatef( xrot, 1.0, 0.0, 0.0 );
+  glRotatef( yrot, 0.0, 1.0, 0.0 );
+  glTranslated( -xpos, -ypos, -zpos );
+}
+
+// what set3DPerspective() loads, column major like GL
+void Camera::projection( float m[16] ) const
+{
+  const float zmin = 0.25;
+  const float zmax = viewDist;
+  const float ymax = zmin * tan(lensFovy * M_PI / 360.0);
+  const float xmax = ymax * lensAspect;
+
+  for ( int i = 0; i < 16; i++ ) m[i] = 0.0;
+  m[ 0] = zmin / xmax;
+  m[ 5] = zmin / ymax;
+  m[10] = -(zmax + zmin) / (zmax - zmin);
+  m[11] = -1.0;
+  m[14] = -2.0 * zmax * zmin / (zmax - zmin);
+}
+
+float Camera::reach() const
+{
+  const float t = tan(lensFovy * M_PI / 360.0);
+  return viewDist * sqrt( 1.0 + t * t * (1.0 + lensAspect * lensAspect) );
+}
+
+// what adjustGL() leaves on the modelview matrix
+void Camera::modelview( float m[16] ) const
+{
+  const float xr = xrot / 180.0 * M_PI;
+  const float yr = yrot / 180.0 * M_PI;
+  const float cx = cos(xr), sx = sin(xr);
+  const float cy = cos(yr), sy = sin(yr);
+
+  // rotate about x, then y, then move the eye to the origin
+  m[ 0] = cy;       m[ 4] = 0.0;  m[ 8] = sy;       m[12] = 0.0;
+  m[ 1] = sx * sy;  m[ 5] = cx;   m[ 9] = -sx * cy; m[13] = 0.0;
+  m[ 2] = -cx * sy; m[ 6] = sx;   m[10] = cx * cy;  m[14] = 0.0;
+  m[ 3] = 0.0;      m[ 7] = 0.0;  m[11] = 0.0;      m[15] = 1.0;
+
+  for ( int r = 0; r < 3; r++ )
+    m[12+r] = -( m[r] * xpos + m[4+r] * ypos + m[8+r] * zpos );
+}
+
+void Camera::readyFrustum()
+{
+  if (!updated) return;
+  updated = false;
+
+  // thanks mark morley
+  // http://www.crownandcutlass.com/features/technicaldetails/frustum.html
+
+  float   proj[16];
+  float   modl[16];
+  float   clip[16];
+
+  // worked out here instead of read back from GL, so the game thread can
+  // cull while the render thread owns the context
+  projection( proj );
+  modelview( modl );
+
+  // Combine the two matrices (multiply projection by modelview)
+  // Assumes no rotation on the Projection Matrix.
+  clip[ 0] = modl[ 0] * proj[ 0];
+  clip[ 1] = modl[ 1] * proj[ 5];
+  clip[ 2] = modl[ 2] * proj[10] + modl[ 3] * proj[14];
+  clip[ 3] = modl[ 2] * proj[11];
+
+  clip[ 4] = modl[ 4] * proj[ 0];
+  clip[ 5] = modl[ 5] * proj[ 5];
+  clip[ 6] = modl[ 6] * proj[10] + modl[ 7] * proj[14];
+  clip[ 7] = modl[ 6] * proj[11];
+
+  clip[ 8] = modl[ 8] * proj[ 0];
+  clip[ 9] = modl[ 9] * proj[ 5];
+  clip[10] = modl[10] * proj[10] + modl[11] * proj[14];
+  clip[11] = modl[10] * proj[11];
+
+  clip[12] = modl[12] * proj[ 0];
+  clip[13] = modl[13] * proj[ 5];
+  clip[14] = modl[14] * proj[10] + modl[15] * proj[14];
+  clip[15] = modl[14] * proj[11];
+
+  /* Extract the numbers for the RIGHT plane */
+  frustum[0][0] = clip[ 3] - clip[ 0];
+  frustum[0][1] = clip[ 7] - clip[ 4];
+  frustum[0][2] = clip[11] - clip[ 8];
+  frustum[0][3] = clip[15] - clip[12];
+
+  /* Extract the numbers for the LEFT plane */
+  frustum[1][0] = clip[ 3] + clip[ 0];
+  frustum[1][1] = clip[ 7] + clip[ 4];
+  frustum[1][2] = clip[11] + clip[ 8];
+  frustum[1][3] = clip[15] + clip[12];
+
+  /* Extract the BOTTOM plane */
+  frustum[2][0] = clip[ 3] + clip[ 1];
+  frustum[2][1] = clip[ 7] + clip[ 5];
+  frustum[2][2] = clip[11] + clip[ 9];
+  frustum[2][3] = clip[15] + clip[13];
+
+  /* Extract the TOP plane */
+  frustum[3][0] = clip[ 3] - clip[ 1];
+  frustum[3][1] = clip[ 7] - clip[ 5];
+  frustum[3][2] = clip[11] - clip[ 9];
+  frustum[3][3] = clip[15] - clip[13];
+
+  /* Extract the FAR plane */
+  frustum[4][0] = clip[ 3] - clip[ 2];
+  frustum[4][1] = clip[ 7] - clip[ 6];
+  frustum[4][2] = clip[11] - clip[10];
+  frustum[4][3] = clip[15] - clip[14];
+
+  /* Extract the NEAR plane */
+  frustum[5][0] = clip[ 3] + clip[ 2];
+  frustum[5][1] = clip[ 7] + clip[ 6];
+  frustum[5][2] = clip[11] + clip[10];
+  frustum[5][3] = clip[15] + clip[14];
+
+  /* Normalize the results */
+  for ( int i = 0; i<6; i++ ) {
+    float t = sqrt( frustum[i][0]*frustum[i][0] + frustum[i][1]*frustum[i][1] + frustum[i][2]*frustum[i][2] );
+    frustum[i][0] /= t;
+    frustum[i][1] /= t;
+    frustum[i][2] /= t;
+    frustum[i][3] /= t;
+  }
+}
+
+bool Camera::frustumContainsPoint( float x, float y, float z )
+{
+  for ( int p = 0; p < 6; p++ )
+    if( frustum[p][0]*x + frustum[p][1]*y + frustum[p][2]*z + frustum[p][3] <= 0 )
+      return false;
+
+  return true;
+}
+
+bool Camera::frustumContainsSphere( float x, float y, float z, float radius )
+{
+  for( int p = 0; p < 6; p++ )
+    if( (frustum[p][0]*x + frustum[p][1]*y + frustum[p][2]*z + frustum[p][3]) <= -radius )
+      return false;
+
+  return true;
+}
+
+bool Camera::frustumContainsCube( float x, float y, float z, float xs, float ys, float zs )
+{
+  for ( int p = 5; p < 6; p++ ) {
+    if ((frustum[p][0] *  x + frustum[p][1] *  y + frustum[p][2] *  z + frustum[p][3] > 0) ||
+        (frustum[p][0] * xs + frustum[p][1] *  y + frustum[p][2] *  z + frustum[p][3] > 0) ||
+        (frustum[p][0] *  x + frustum[p][1] * ys + frustum[p][2] *  z + frustum[p][3] > 0) ||
+        (frustum[p][0] * xs + frustum[p][1] * ys + frustum[p][2] *  z + frustum[p][3] > 0) ||
+        (frustum[p][0] *  x + frustum[p][1] *  y + frustum[p][2] * zs + frustum[p][3] > 0) ||
+        (frustum[p][0] * xs + frustum[p][1] *  y + frustum[p][2] * zs + frustum[p][3] > 0) ||
+        (frustum[p][0] *  x + frustum[p][1] * ys + frustum[p][2] * zs + frustum[p][3] > 0) ||
+        (frustum[p][0] * xs + frustum[p][1] * ys + frustum[p][2] * zs + frustum[p][3] > 0))
+      continue;
+    else
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,66 @@
+// made by inny
+
+#ifndef OPENMINE_CAMERA_H
+#define OPENMINE_CAMERA_H
+
+class Camera
+{
+  protected:
+    float xpos;
+    float ypos;
+    float zpos;
+    float xrot;
+    float yrot;
+
+    float viewDist;
+    bool fogged;
+    float lensFovy;
+    float lensAspect;
+
+    float frustum[6][4];
+
+    bool updated;
+
+  public:
+    Camera( float x=0.0, float y=0.0, float z=0.0, float xr=0.0, float yr=0.0 );
+    void teleport( float x, float y, float z );
+
+    float x() const { return xpos; };
+    float y() const { return ypos; };
+    float z() const { return zpos; };
+    float pitch() const { return xrot; };
+    float heading() const { return yrot; };
+
+    void walk( float amount );
+    void strafe( float amount );
+    void turn( float amount );
+    void look( float amount );
+    void ascend( float amount );
+
+    void orient( float xr, float yr );
+
+    // the lens alone is enough for readyFrustum(), which needs no GL
+    void setLens( float fovy, float aspect );
+    void set3DPerspective( float fovy, float aspect );
+    void adjustGL();
+    void projection( float m[16] ) const;
+    void modelview( float m[16] ) const;
+
+    void readyFrustum();
+    bool frustumContainsPoint( float x, float y, float z );
+    bool frustumContainsSphere( float x, float y, float z, float radius );
+    bool frustumContainsCube( float x, float y, float z, float xs, float ys, float zs );
+
+    void setViewDistance( float d ) { viewDist = d; updated = true; };
+    float viewDistance() const { return viewDist; };
+
+    // how far from the eye the far corners of the frustum are
+    float reach() const;
+
+    // fog follows the view distance, starting and ending where fogRange() says
+    void setFog( bool enabled ) { fogged = enabled; };
+    bool fogEnabled() const { return fogged; };
+    void fogRange( float &start, float &end ) const;
+};
+
+#endif
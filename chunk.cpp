@@ -0,0 +1,800 @@
+// made by inny
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "camera.h"
+#include "util.h"
+#include "column.h"
+#include "faceprogram.h"
+#include "memstats.h"
+#include "meshcache.h"
+#include "region.h"
+#include "world.h"
+#include "chunk.h"
+
+using namespace std;
+
+template<int X, int Y, int Z>
+atomic<unsigned int> ChunkT<X, Y, Z>::revisions( 0 );
+
+template<int X, int Y, int Z>
+atomic<long> ChunkT<X, Y, Z>::fullCulls( 0 );
+
+template<int X, int Y, int Z>
+atomic<long> ChunkT<X, Y, Z>::sideCulls( 0 );
+
+template<int X, int Y, int Z>
+atomic<long> ChunkT<X, Y, Z>::meshBuilds( 0 );
+
+template<int X, int Y, int Z>
+unsigned short ChunkT<X, Y, Z>::noTypes[VOLUME];
+
+template<int X, int Y, int Z>
+unsigned char ChunkT<X, Y, Z>::noVisibility[VOLUME];
+
+template<int X, int Y, int Z>
+ChunkT<X, Y, Z>::ChunkT( World *w, float x, float y, float z )
+  : world(w), column(0), xpos(x), ypos(y), zpos(z), types(noTypes), visibility(noVisibility),
+    generated( false ), meshed( false ), listSize(0),
+    drawn(0), faces(0), region(0), regionSlot(0), faceBuffer(0),
+    faceRecords(0), bufferSize(0), packed(false), storedFaces(0), revisionStamp( ++revisions ),
+    culledSides(0), shown(false),
+    query(0), querying(false), occluded(false)
+{
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    sideFaces[d] = 0;
+    sideRecords[d] = 0;
+  }
+  for ( int i = 0; i < X * Z; i++ ) surface[i] = -1;
+  if (world) column = world->acquireColumn( x, z );
+}
+
+template<int X, int Y, int Z>
+ChunkT<X, Y, Z>::~ChunkT()
+{
+  if (generated) glDeleteLists(index, Voxel::DIRECTIONS);
+  if (faceBuffer) glDeleteBuffers(1, &faceBuffer);
+  if (query) glDeleteQueries(1, &query);
+  if (column) world->releaseColumn( column );
+  if ( !isEmpty() ) {
+    delete[] types;
+    delete[] visibility;
+    MemoryStats::add( MemoryStats::CHUNK_VOXELS, -long(VOLUME * (sizeof(unsigned short) + 1)) );
+  }
+  MemoryStats::add( MemoryStats::GL_LISTS, -listSize );
+  MemoryStats::add( MemoryStats::GL_BUFFERS, -bufferSize );
+}
+
+// cells of our own, all air, before the first write
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::own()
+{
+  if ( !isEmpty() ) return;
+  types = new unsigned short[VOLUME]();
+  visibility = new unsigned char[VOLUME]();
+  MemoryStats::add( MemoryStats::CHUNK_VOXELS, VOLUME * (sizeof(unsigned short) + 1) );
+}
+
+// rows above the terrain are left empty
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::randomize()
+{
+  if ( ypos >= World::GROUND_ROWS * YSIZE ) return;
+  own();
+
+  float yc = 0.5 * float(World::GROUND);
+  for ( int z = 0; z < ZSIZE; z ++ ) {
+    for ( int y = 0; y < YSIZE; y ++ ) {
+      for ( int x = 0; x < XSIZE; x ++ ) {
+        float yp = ypos + float(y) + 0.5*Voxel::SIZE;
+
+        // the x and z terms come from the column, worked out once per stack
+        float chance = 1.0;
+
+        if ( (abs(yp-(yc/2)) < 5.0) && column->tunnel(x, z) )
+          chance = 0.001;
+
+        else if (yp > yc)
+          chance = (yp < column->height(x, z)) ? 1.0 : 0.001;
+
+        const int roll = cellHash( int(xpos)+x, int(ypos)+y, int(zpos)+z, 0 ) % 1000;
+        types[cell(x, y, z)] = ( roll < int(chance*1000.0) );
+      }
+    }
+  }
+
+#if 0
+  for ( int z = 0; z < 2; z++ )
+    for ( int y = 0; y < 2; y++ )
+      for ( int x = 0; x < 2; x++ )
+        types[cell(x*(XSIZE-1), y*(YSIZE-1), z*(ZSIZE-1))]=1;
+#endif
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::setTypeAt( int x, int y, int z, unsigned short t )
+{
+  writeTypeAt( x, y, z, t );
+  if ( t && column ) column->raise( x, int(ypos)+y, z );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::writeTypeAt( int x, int y, int z, unsigned short t )
+{
+  if ( isEmpty() ) {
+    if (!t) return;
+    own();
+  }
+  types[cell(x, y, z)] = t;
+}
+
+// a type whose two bytes match can go through memset
+static void fillTypes( unsigned short *p, int n, unsigned short t )
+{
+  if ( (t >> 8) == (t & 0xff) ) memset( p, t & 0xff, n * sizeof(unsigned short) );
+  else fill( p, p + n, t );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::fillSpan( int x0, int x1, int y, int z, unsigned short t )
+{
+#ifdef OPENMINE_MORTON_VOXELS
+  for ( int x = x0; x < x1; x++ ) types[cell(x, y, z)] = t;
+#else
+  fillTypes( types + cell(x0, y, z), x1 - x0, t );
+#endif
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::fillBox( int x0, int y0, int z0, int x1, int y1, int z1, unsigned short t )
+{
+  if ( isEmpty() ) {
+    if (!t) return;
+    own();
+  }
+
+  // the whole chunk is the same run in either layout
+  if ( x0 == 0 && y0 == 0 && z0 == 0 && x1 == XSIZE && y1 == YSIZE && z1 == ZSIZE ) {
+    fillTypes( types, VOLUME, t );
+  }
+  else {
+    for ( int z = z0; z < z1; z++ )
+      for ( int y = y0; y < y1; y++ )
+        fillSpan( x0, x1, y, z, t );
+  }
+
+  if ( !t || !column ) return;
+  for ( int z = z0; z < z1; z++ )
+    for ( int x = x0; x < x1; x++ )
+      column->raise( x, int(ypos)+y1-1, z );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::fillRow( int x0, int x1, int y, int z, unsigned short t )
+{
+  if ( isEmpty() ) {
+    if (!t) return;
+    own();
+  }
+  fillSpan( x0, x1, y, z, t );
+  if ( !t || !column ) return;
+  for ( int x = x0; x < x1; x++ ) column->raise( x, int(ypos)+y, z );
+}
+
+template<int X, int Y, int Z>
+int ChunkT<X, Y, Z>::replaceRow( int x0, int x1, int y, int z, unsigned short from, unsigned short to )
+{
+  if ( isEmpty() ) {
+    if ( from || !to ) return 0;
+    own();
+  }
+
+  int n = 0;
+  for ( int x = x0; x < x1; x++ ) {
+    unsigned short &t = types[cell(x, y, z)];
+    if ( t != from ) continue;
+    t = to;
+    if ( to && column ) column->raise( x, int(ypos)+y, z );
+    n++;
+  }
+  return n;
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::readRow( int x0, int x1, int y, int z, unsigned short *out ) const
+{
+#ifdef OPENMINE_MORTON_VOXELS
+  for ( int x = x0; x < x1; x++ ) *out++ = types[cell(x, y, z)];
+#else
+  memcpy( out, types + cell(x0, y, z), (x1 - x0) * sizeof(unsigned short) );
+#endif
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::writeRow( int x0, int x1, int y, int z, const unsigned short *in )
+{
+  if ( isEmpty() ) {
+    if ( find_if( in, in + (x1 - x0), []( unsigned short t ) { return t != 0; } ) == in + (x1 - x0) )
+      return;
+    own();
+  }
+#ifdef OPENMINE_MORTON_VOXELS
+  for ( int x = x0; x < x1; x++ ) types[cell(x, y, z)] = in[x - x0];
+#else
+  memcpy( types + cell(x0, y, z), in, (x1 - x0) * sizeof(unsigned short) );
+#endif
+  if (!column) return;
+  for ( int x = x0; x < x1; x++ )
+    if ( in[x - x0] ) column->raise( x, int(ypos)+y, z );
+}
+
+// generation stages may run on other threads, so the column only hears
+// about our blocks once they're done
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::publishTops()
+{
+  if ( !column || isEmpty() ) return;
+  for ( int i = 0; i < VOLUME; i++ ) {
+    if ( types[i] == 0 ) continue;
+    int x, y, z;
+    cellCoords( i, x, y, z );
+    column->raise( x, int(ypos)+y, z );
+  }
+}
+
+template<int X, int Y, int Z>
+bool ChunkT<X, Y, Z>::isSky() const
+{
+  return isEmpty() || ( column && column->highestTop() < int(ypos) );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::cullFaces()
+{
+  invalidateMesh();
+  fullCulls++;
+
+  // all air, whatever is next door
+  if ( isSky() ) {
+    if ( !isEmpty() ) memset( visibility, 0, VOLUME );
+    culledSides = 63;
+    return;
+  }
+
+  for ( int z = 0; z < ZSIZE; z++ ) {
+    for ( int y = 0; y < YSIZE; y++ ) {
+      for ( int x = 0; x < XSIZE; x++ ) {
+        maskCell( x, y, z );
+      }
+    }
+  }
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) noteSide( d, loadedPast(d), true );
+}
+
+// culls against the 3x3x3 block of chunks around us, indexed
+// (dx+1) + (dy+1)*3 + (dz+1)*9, without going through the world map
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::cullFaces( ChunkT * const *near )
+{
+  invalidateMesh();
+  fullCulls++;
+
+  // all air, whatever is next door
+  if ( isSky() ) {
+    if ( !isEmpty() ) memset( visibility, 0, VOLUME );
+    culledSides = 63;
+    return;
+  }
+
+  cullCells( near, 0, 0, 0, XSIZE, YSIZE, ZSIZE );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::cullCells( ChunkT * const *near, int x0, int y0, int z0, int x1, int y1, int z1 )
+{
+  // an empty chunk's faces are all culled already, only its sides are noted
+  if ( isEmpty() ) z1 = z0;
+  for ( int z = z0; z < z1; z++ ) {
+    for ( int y = y0; y < y1; y++ ) {
+      for ( int x = x0; x < x1; x++ ) {
+        const int i = cell(x, y, z);
+        if ( types[i] == 0 ) {
+          visibility[i] = 0;
+          continue;
+        }
+
+        // away from the walls every neighbour is one of ours
+        unsigned char mask = 0;
+        if ( x > 0 && x < XSIZE-1 && y > 0 && y < YSIZE-1 && z > 0 && z < ZSIZE-1 ) {
+          if ( types[cell(x,   y+1, z  )] == 0 ) mask |= 1;
+          if ( types[cell(x,   y-1, z  )] == 0 ) mask |= 2;
+          if ( types[cell(x,   y,   z+1)] == 0 ) mask |= 4;
+          if ( types[cell(x,   y,   z-1)] == 0 ) mask |= 8;
+          if ( types[cell(x+1, y,   z  )] == 0 ) mask |= 16;
+          if ( types[cell(x-1, y,   z  )] == 0 ) mask |= 32;
+        }
+        else {
+          if ( transparentNear(near, x,   y+1, z  ) ) mask |= 1;
+          if ( transparentNear(near, x,   y-1, z  ) ) mask |= 2;
+          if ( transparentNear(near, x,   y,   z+1) ) mask |= 4;
+          if ( transparentNear(near, x,   y,   z-1) ) mask |= 8;
+          if ( transparentNear(near, x+1, y,   z  ) ) mask |= 16;
+          if ( transparentNear(near, x-1, y,   z  ) ) mask |= 32;
+        }
+        visibility[i] = mask;
+      }
+    }
+  }
+
+  const bool reached[Voxel::DIRECTIONS] = { y1 == YSIZE, y0 == 0, z1 == ZSIZE, z0 == 0, x1 == XSIZE, x0 == 0 };
+  const bool whole[Voxel::DIRECTIONS] = {
+    x0 == 0 && x1 == XSIZE && z0 == 0 && z1 == ZSIZE, x0 == 0 && x1 == XSIZE && z0 == 0 && z1 == ZSIZE,
+    x0 == 0 && x1 == XSIZE && y0 == 0 && y1 == YSIZE, x0 == 0 && x1 == XSIZE && y0 == 0 && y1 == YSIZE,
+    y0 == 0 && y1 == YSIZE && z0 == 0 && z1 == ZSIZE, y0 == 0 && y1 == YSIZE && z0 == 0 && z1 == ZSIZE
+  };
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    if ( !reached[d] ) continue;
+    const int *s = Voxel::steps[d];
+    noteSide( d, near[ (s[0]+1) + (s[1]+1)*3 + (s[2]+1)*9 ] != 0, whole[d] );
+  }
+}
+
+// just the one cell thick slab along side d, for when a neighbour turns up
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::cullSide( ChunkT * const *near, int d )
+{
+  sideCulls++;
+  switch (d) {
+    case Voxel::UP:    cullCells( near, 0, YSIZE-1, 0, XSIZE, YSIZE, ZSIZE ); break;
+    case Voxel::DOWN:  cullCells( near, 0, 0, 0, XSIZE, 1, ZSIZE ); break;
+    case Voxel::SOUTH: cullCells( near, 0, 0, ZSIZE-1, XSIZE, YSIZE, ZSIZE ); break;
+    case Voxel::NORTH: cullCells( near, 0, 0, 0, XSIZE, YSIZE, 1 ); break;
+    case Voxel::EAST:  cullCells( near, XSIZE-1, 0, 0, XSIZE, YSIZE, ZSIZE ); break;
+    case Voxel::WEST:  cullCells( near, 0, 0, 0, 1, YSIZE, ZSIZE ); break;
+  }
+}
+
+// a side only counts as culled when all of it was, against a chunk that's
+// really there; past the edge of the world nothing is coming
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::noteSide( int d, bool present, bool whole )
+{
+  const int *s = Voxel::steps[d];
+  if ( !present && world )
+    present = !world->fitsBounds( xpos + s[0]*XSIZE, ypos + s[1]*YSIZE, zpos + s[2]*ZSIZE );
+
+  if ( !present ) culledSides &= ~(1 << d);
+  else if ( whole ) culledSides |= 1 << d;
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::maskCell( int x, int y, int z )
+{
+  if ( isEmpty() ) return;
+  const int i = cell(x, y, z);
+  if ( types[i] == 0 ) {
+    visibility[i] = 0;
+    return;
+  }
+
+  unsigned char mask = 0;
+  if ( transparentAt(x,   y+1, z  ) ) mask |= 1;
+  if ( transparentAt(x,   y-1, z  ) ) mask |= 2;
+  if ( transparentAt(x,   y,   z+1) ) mask |= 4;
+  if ( transparentAt(x,   y,   z-1) ) mask |= 8;
+  if ( transparentAt(x+1, y,   z  ) ) mask |= 16;
+  if ( transparentAt(x-1, y,   z  ) ) mask |= 32;
+  visibility[i] = mask;
+}
+
+// recomputes the face mask of one cell, the mesh is left alone. On a wall
+// with nothing loaded past it, that side stays open until something comes
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::cullCell( int x, int y, int z )
+{
+  maskCell( x, y, z );
+
+  const bool walls[Voxel::DIRECTIONS] = { y == YSIZE-1, y == 0, z == ZSIZE-1, z == 0, x == XSIZE-1, x == 0 };
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ )
+    if ( walls[d] ) noteSide( d, loadedPast(d), false );
+}
+
+template<int X, int Y, int Z>
+bool ChunkT<X, Y, Z>::loadedPast( int d )
+{
+  const int *s = Voxel::steps[d];
+  return world->chunkAt( xpos + s[0]*XSIZE, ypos + s[1]*YSIZE, zpos + s[2]*ZSIZE ) != 0;
+}
+
+// marks every built mesh stale so the next prepare() rebuilds it; no GL here,
+// edits happen off the render thread
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::invalidateMesh()
+{
+  revisionStamp = ++revisions;
+  meshed = false;
+  if (region) region->invalidate( regionSlot );
+  packed = false;
+  storedFaces = 0;
+  storedOwner.reset();
+}
+
+// one 64 bit word at a time; a clash would draw some other chunk's mesh, so
+// every step mixes the whole word
+static inline unsigned long long mixKey( unsigned long long h, unsigned long long w )
+{
+  h ^= w * 0x9E3779B97F4A7C15ULL;
+  h = (h << 31) | (h >> 33);
+  return h * 0xC2B2AE3D27D4EB4FULL;
+}
+
+template<int X, int Y, int Z>
+unsigned long long ChunkT<X, Y, Z>::meshKey( ChunkT * const *near ) const
+{
+  unsigned long long h = mixKey( MeshCache::MESHER_VERSION, X | (Y << 9) | (Z << 18) );
+  h = mixKey( h, layoutName()[0] );
+
+  const unsigned char *bytes = (const unsigned char*)types;
+  for ( int i = 0; i < int(VOLUME * sizeof(unsigned short)); i += 8 ) {
+    unsigned long long w;
+    memcpy( &w, bytes + i, 8 );
+    h = mixKey( h, w );
+  }
+
+  // the slab of each neighbour touching us, a bit per cell; nothing
+  // there counts as air like transparentNear() has it
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    const int *s = Voxel::steps[d];
+    const ChunkT *n = near[ (s[0]+1) + (s[1]+1)*3 + (s[2]+1)*9 ];
+    const int x0 = s[0] < 0 ? XSIZE-1 : 0, x1 = s[0] ? x0+1 : XSIZE;
+    const int y0 = s[1] < 0 ? YSIZE-1 : 0, y1 = s[1] ? y0+1 : YSIZE;
+    const int z0 = s[2] < 0 ? ZSIZE-1 : 0, z1 = s[2] ? z0+1 : ZSIZE;
+
+    unsigned long long bits = 0;
+    int filled = 0;
+    for ( int z = z0; z < z1; z++ ) {
+      for ( int y = y0; y < y1; y++ ) {
+        for ( int x = x0; x < x1; x++ ) {
+          bits = (bits << 1) | ( n && n->types[cell(x, y, z)] != 0 );
+          if ( ++filled == 64 ) {
+            h = mixKey( h, bits );
+            bits = 0;
+            filled = 0;
+          }
+        }
+      }
+    }
+    h = mixKey( h, bits ^ (unsigned long long)(d + 1) << 58 );
+  }
+
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  return h ^ (h >> 29);
+}
+
+// ends up where cullFaces( near ) would have, sides and all
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::adoptFaces( ChunkT * const *near, const GLuint *records, const int *counts,
+                                  const shared_ptr< const vector<GLuint> > &owner )
+{
+  invalidateMesh();
+
+  int total = 0;
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) total += counts[d];
+  memset( visibility, 0, VOLUME );
+  for ( int i = 0; i < total; i++ ) {
+    const GLuint r = records[i];
+    visibility[ cell( r & 255, (r >> 8) & 255, (r >> 16) & 255 ) ] |= 1 << ( (r >> 24) & 7 );
+  }
+
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    const int *s = Voxel::steps[d];
+    noteSide( d, near[ (s[0]+1) + (s[1]+1)*3 + (s[2]+1)*9 ] != 0, true );
+  }
+  keepFaces( records, counts, owner );
+}
+
+// until the next invalidateMesh()
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::keepFaces( const GLuint *records, const int *counts,
+                                 const shared_ptr< const vector<GLuint> > &owner )
+{
+  storedFaces = records;
+  storedOwner = owner;
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) sideRecords[d] = counts[d];
+}
+
+// a missing neighbour is outside the world, which is all air
+template<int X, int Y, int Z>
+inline bool ChunkT<X, Y, Z>::transparentNear( ChunkT * const *near, int x, int y, int z )
+{
+  const int dx = x < 0 ? -1 : x >= XSIZE ? 1 : 0;
+  const int dy = y < 0 ? -1 : y >= YSIZE ? 1 : 0;
+  const int dz = z < 0 ? -1 : z >= ZSIZE ? 1 : 0;
+  const ChunkT *c = near[ (dx+1) + (dy+1)*3 + (dz+1)*9 ];
+  if (!c) return true;
+  return c->types[cell(x & XMASK, y & YMASK, z & ZMASK)] == 0;
+}
+
+template<int X, int Y, int Z>
+inline bool ChunkT<X, Y, Z>::transparentAt( int x, int y, int z )
+{
+  if ( contains(x, y, z) ) return types[cell(x, y, z)] == 0;
+  return world->voxel( int(xpos)+x, int(ypos)+y, int(zpos)+z ).isTransparent();
+}
+
+template<int X, int Y, int Z>
+Voxel ChunkT<X, Y, Z>::voxel( int x, int y, int z )
+{
+  if ( !contains(x, y, z) ) {
+    return world->voxel( int(xpos)+x, int(ypos)+y, int(zpos)+z );
+  }
+
+  if ( isEmpty() ) return Voxel::shared;
+  const int i = cell(x, y, z);
+  return Voxel( &types[i], &visibility[i] );
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::drawChunkCube()
+{
+  const float xs = XSIZE;
+  const float ys = YSIZE;
+  const float zs = ZSIZE;
+
+  Vertex va( xpos,    ypos,    zpos );
+  Vertex vb( xpos,    ypos,    zpos+zs );
+  Vertex vc( xpos,    ypos+ys, zpos );
+  Vertex vd( xpos,    ypos+ys, zpos+zs );
+  Vertex ve( xpos+xs, ypos,    zpos );
+  Vertex vf( xpos+xs, ypos,    zpos+zs );
+  Vertex vg( xpos+xs, ypos+ys, zpos );
+  Vertex vh( xpos+xs, ypos+ys, zpos+zs );
+
+  Face tp( vc, vd, vh, vg );
+  Face bt( va, ve, vf, vb );
+  Face sd1( vh, vd, vb, vf );
+  Face sd2( vc, vg, ve, va );
+  Face sd3( vg, vh, vf, ve );
+  Face sd4( vd, vc, va, vb );
+
+  glBegin(GL_QUADS);
+  glColor3f(1.0, 1.0, 1.0);
+  tp.glUntexturedDraw();
+  bt.glUntexturedDraw();
+  sd1.glUntexturedDraw();
+  sd2.glUntexturedDraw();
+  sd3.glUntexturedDraw();
+  sd4.glUntexturedDraw();
+  glEnd();
+}
+
+template<int X, int Y, int Z>
+bool ChunkT<X, Y, Z>::visibleToCamera( Camera &camera, float xpos, float ypos, float zpos )
+{
+  return camera.frustumContainsSphere(xpos+(XSIZE/2),
+                                      ypos+(YSIZE/2),
+                                      zpos+(ZSIZE/2),
+                                      RADIUS);
+}
+
+// counts the samples of the bounding box that pass the depth test
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::issueQuery()
+{
+  if (!query) glGenQueries(1, &query);
+  glBeginQuery(GL_SAMPLES_PASSED, query);
+  drawChunkCube();
+  glEndQuery(GL_SAMPLES_PASSED);
+  querying = true;
+}
+
+// true once a result came in, false while the GPU is still on it
+template<int X, int Y, int Z>
+bool ChunkT<X, Y, Z>::pollQuery()
+{
+  if (!querying) return false;
+
+  GLint available = 0;
+  glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) return false;
+
+  GLuint samples = 0;
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+  occluded = (samples == 0);
+  querying = false;
+  return true;
+}
+
+// a face can only be seen from the side its normal points to, so a camera
+// past the chunk's min x sees none of its -x faces, and so on
+template<int X, int Y, int Z>
+unsigned char ChunkT<X, Y, Z>::facingMask( float cx, float cy, float cz ) const
+{
+  unsigned char mask = 0;
+  if ( cy > ypos ) mask |= 1 << Voxel::UP;
+  if ( cy < ypos+YSIZE ) mask |= 1 << Voxel::DOWN;
+  if ( cz > zpos ) mask |= 1 << Voxel::SOUTH;
+  if ( cz < zpos+ZSIZE ) mask |= 1 << Voxel::NORTH;
+  if ( cx > xpos ) mask |= 1 << Voxel::EAST;
+  if ( cx < xpos+XSIZE ) mask |= 1 << Voxel::WEST;
+  return mask;
+}
+
+template<int X, int Y, int Z>
+int ChunkT<X, Y, Z>::vertexCount( unsigned char facing ) const
+{
+  int count = 0;
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ )
+    if ( facing & (1 << d) ) count += sideFaces[d] * 4;
+  return count;
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::prepare( bool packedFaces )
+{
+  if ( packedFaces ) {
+    if (!packed) packFaces();
+  }
+  else if (!meshed) generateDisplayList();
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::draw( unsigned char facing )
+{
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ )
+    if ( (facing & (1 << d)) && sideFaces[d] ) glCallList(index + d);
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::drawPacked( FaceProgram &program, unsigned char facing )
+{
+  if ( faceRecords == 0 ) return;
+
+  program.setOrigin( xpos, ypos, zpos );
+  glBindBuffer( GL_ARRAY_BUFFER, faceBuffer );
+
+  // neighbouring directions that are both wanted go out as one draw
+  int start = 0, count = 0;
+  for ( int d = 0; d <= Voxel::DIRECTIONS; d++ ) {
+    if ( d < Voxel::DIRECTIONS && (facing & (1 << d)) ) {
+      count += sideRecords[d];
+      continue;
+    }
+    if ( count ) {
+      glVertexAttribIPointerEXT( FaceProgram::FACE, 1, GL_UNSIGNED_INT, 0,
+                                 (const GLvoid*)( start * sizeof(GLuint) ) );
+      glDrawArraysInstancedARB( GL_TRIANGLE_FAN, 0, 4, count );
+    }
+    if ( d < Voxel::DIRECTIONS ) start += count + sideRecords[d];
+    count = 0;
+  }
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::gatherFaces( vector<GLuint> &records, int *counts )
+{
+  meshBuilds++;
+
+  vector<GLuint> sides[Voxel::DIRECTIONS];
+  const int cells = isSky() ? 0 : VOLUME;
+  for ( int i = 0; i < cells; i++ ) {
+    if ( types[i] == 0 ) continue;
+    int x, y, z;
+    cellCoords( i, x, y, z );
+    Voxel( &types[i], &visibility[i] ).pack( sides, x, y, z );
+  }
+
+  records.clear();
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    counts[d] = sides[d].size();
+    records.insert( records.end(), sides[d].begin(), sides[d].end() );
+  }
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::packFaces()
+{
+  packed = true;
+
+  vector<GLuint> records;
+  const GLuint *data = storedFaces;
+  if (!data) {
+    gatherFaces( records, sideRecords );
+    if ( !records.empty() ) data = &records[0];
+  }
+
+  faceRecords = 0;
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    sideFaces[d] = sideRecords[d];
+    faceRecords += sideRecords[d];
+  }
+  faces = faceRecords;
+  if ( faceRecords ) {
+    if (!faceBuffer) glGenBuffers( 1, &faceBuffer );
+    glBindBuffer( GL_ARRAY_BUFFER, faceBuffer );
+    glBufferData( GL_ARRAY_BUFFER, faceRecords * sizeof(GLuint), data, GL_STATIC_DRAW );
+    MemoryStats::add( MemoryStats::GL_BUFFERS, packedBytes() - bufferSize );
+    bufferSize = packedBytes();
+  }
+
+  // the buffer has them now, so the cache's copy can go whenever it likes
+  storedFaces = 0;
+  storedOwner.reset();
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::joinRegion( Region *r, int slot )
+{
+  region = r;
+  regionSlot = slot;
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::buildMesh( vector<Face> &faceList )
+{
+  vector<Face> sides[Voxel::DIRECTIONS];
+  const int cells = isSky() ? 0 : VOLUME;
+  for ( int i = 0; i < cells; i++ ) {
+    if ( types[i] == 0 ) continue;
+    int x, y, z;
+    cellCoords( i, x, y, z );
+    Voxel( &types[i], &visibility[i] ).draw( sides, float(xpos+x), float(ypos+y),
+                                             float(zpos+z), Voxel::SIZE );
+  }
+
+  // appended a direction at a time, sideFaces says where each one starts
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    sideFaces[d] = sides[d].size();
+    faceList.insert( faceList.end(), sides[d].begin(), sides[d].end() );
+  }
+
+  faces = faceList.size();
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::generateDisplayList()
+{
+  // a rebuild compiles over the lists it already has
+  if (!generated) index = glGenLists(Voxel::DIRECTIONS);
+  generated = true;
+  meshed = true;
+  meshBuilds++;
+
+  vector<Face> faceList;
+  buildMesh( faceList );
+
+  int first = 0;
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    glNewList(index + d, GL_COMPILE);
+    glBegin(GL_QUADS);
+      for ( int i = first; i < first + sideFaces[d]; i++ ) faceList[i].glTexturedDraw();
+    glEnd();
+    glEndList();
+    first += sideFaces[d];
+  }
+
+  // the driver keeps about what glTexturedDraw() sends, 5 floats a vertex
+  MemoryStats::add( MemoryStats::GL_LISTS, listBytes() - listSize );
+  listSize = listBytes();
+}
+
+template<int X, int Y, int Z>
+void ChunkT<X, Y, Z>::buildVertices( vector<float> &vertices )
+{
+  meshBuilds++;
+  vector<Face> faceList;
+  buildMesh( faceList );
+
+  vertices.clear();
+  vertices.reserve( faceList.size() * 4 * 5 );
+  for ( int i = 0; i < faceList.size(); i++ ) faceList[i].appendInterleaved( vertices );
+}
+
+
+// every shape OPENMINE_CHUNK_SHAPE can pick, so they all keep compiling
+template class ChunkT<16, 16, 16>;
+template class ChunkT<32, 32, 32>;
+template class ChunkT<16, 256, 16>;
@@ -0,0 +1,352 @@
+// made by inny
+
+#ifndef OPENMINE_CHUNK_H
+#define OPENMINE_CHUNK_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "opengl.h"
+#include "geometry.h"
+#include "voxel.h"
+
+class Camera;
+class FaceProgram;
+class World;
+class Region;
+class Column;
+class WorldGen;
+
+constexpr int log2i( int n )
+{
+  return n <= 1 ? 0 : 1 + log2i( n / 2 );
+}
+
+constexpr float sqrtNewton( float x, float guess, int steps )
+{
+  return steps == 0 ? guess : sqrtNewton( x, 0.5f * (guess + x / guess), steps - 1 );
+}
+
+template<int X, int Y, int Z> struct MortonOrder;
+
+// Dimensions are template parameters so index math folds down to shifts and
+// masks; pick the instantiation with OPENMINE_CHUNK_SHAPE.
+template<int X, int Y, int Z>
+class ChunkT
+{
+  public:
+    static_assert( (X & (X-1)) == 0 && (Y & (Y-1)) == 0 && (Z & (Z-1)) == 0,
+                   "chunk dimensions must be powers of two" );
+    static_assert( X <= 256 && Y <= 256 && Z <= 256,
+                   "packed faces only have a byte per axis" );
+
+    static const int XSIZE = X;
+    static const int YSIZE = Y;
+    static const int ZSIZE = Z;
+    static constexpr int XSHIFT = log2i(X);
+    static constexpr int YSHIFT = log2i(Y);
+    static constexpr int ZSHIFT = log2i(Z);
+    static constexpr int XMASK = X - 1;
+    static constexpr int YMASK = Y - 1;
+    static constexpr int ZMASK = Z - 1;
+    static constexpr int VOLUME = X * Y * Z;
+    static constexpr float RADIUS = 0.5f * sqrtNewton( float(X*X + Y*Y + Z*Z), float(Y), 12 );
+
+  protected:
+    World *world;
+    Column *column;
+    float xpos;
+    float ypos;
+    float zpos;
+
+    // structure of arrays, indexed by cell(). Until a block is written a
+    // chunk points both at one shared all air pair, so sky holds no voxels
+    unsigned short *types;
+    unsigned char *visibility;
+    static unsigned short noTypes[VOLUME];
+    static unsigned char noVisibility[VOLUME];
+
+    // local height of the ground in each x, z once caves are carved, -1 for
+    // none; trees in neighbours generated later still grow from it
+    short surface[X * Z];
+
+    // one display list per Voxel::Direction, starting at index, holding
+    // the current mesh while meshed is set
+    bool generated;
+    bool meshed;
+    GLuint index;
+    int listSize;
+    int drawn;
+    int faces;
+    int sideFaces[Voxel::DIRECTIONS];
+
+    Region *region;
+    int regionSlot;
+
+    GLuint faceBuffer;
+    int faceRecords;
+    int sideRecords[Voxel::DIRECTIONS];
+    int bufferSize;
+    bool packed;
+
+    // packed records to upload as they are instead of gathering them, in
+    // direction order with sideRecords counting each; owned by a MeshCache,
+    // or by storedOwner if the cache made them this session
+    const GLuint *storedFaces;
+    std::shared_ptr< const std::vector<GLuint> > storedOwner;
+
+    // bumped whenever the chunk changes, from one counter shared by every
+    // chunk so a new chunk never repeats an old one's number
+    unsigned int revisionStamp;
+    static std::atomic<unsigned int> revisions;
+
+    // a bit per Voxel::Direction, set once the cells along that side have
+    // been culled against the chunk past it or the edge of the world
+    unsigned char culledSides;
+    bool shown;
+
+    // whole chunk culls, single side culls and mesh builds, every chunk
+    static std::atomic<long> fullCulls;
+    static std::atomic<long> sideCulls;
+    static std::atomic<long> meshBuilds;
+
+    // last GL_SAMPLES_PASSED answer for the bounding box
+    GLuint query;
+    bool querying;
+    bool occluded;
+
+    void fillSpan( int x0, int x1, int y, int z, unsigned short t );
+    void packFaces();
+    void gatherFaces( std::vector<GLuint> &records, int *counts );
+    void keepFaces( const GLuint *records, const int *counts,
+                    const std::shared_ptr< const std::vector<GLuint> > &owner );
+    void generateDisplayList();
+    void drawChunkCube();
+
+    bool transparentAt( int x, int y, int z );
+    static bool transparentNear( ChunkT * const *near, int x, int y, int z );
+    void maskCell( int x, int y, int z );
+    bool loadedPast( int d );
+    void noteSide( int d, bool present, bool whole );
+
+    // the generation stages work on the arrays directly
+    friend class WorldGen;
+
+  public:
+    // a chunk is generated, then ready once every side is culled against
+    // its real neighbour, then meshed once it's first handed out to draw
+    enum State { GENERATED, READY, MESHED };
+
+    ChunkT( World *w, float x=0.0, float y=0.0, float z=0.0 );
+    virtual ~ChunkT();
+    void randomize();
+    void publishTops();
+    void cullFaces();
+    void cullFaces( ChunkT * const *near );
+    void cullCell( int x, int y, int z );
+
+    // recomputes the face masks in [x0, x1) [y0, y1) [z0, z1) only and
+    // leaves the mesh alone, so chunks can be culled side by side and
+    // invalidated after
+    void cullCells( ChunkT * const *near, int x0, int y0, int z0, int x1, int y1, int z1 );
+    void cullSide( ChunkT * const *near, int d );
+    void invalidateMesh();
+
+    // everything the culled mesh depends on, hashed: our types and which
+    // cells against our walls are solid in the chunks beside us
+    unsigned long long meshKey( ChunkT * const *near ) const;
+
+    // takes a mesh made earlier from the same key instead of culling; the
+    // face masks are read back out of the records, which must outlive us
+    // unless owner keeps them
+    void adoptFaces( ChunkT * const *near, const GLuint *records, const int *counts,
+                     const std::shared_ptr< const std::vector<GLuint> > &owner );
+
+    State state() const { return shown ? MESHED : culledSides == 63 ? READY : GENERATED; };
+    void markShown() { shown = true; };
+    bool sideCulled( int d ) const { return culledSides & (1 << d); };
+    static long fullCullCount() { return fullCulls.load(); };
+    static long sideCullCount() { return sideCulls.load(); };
+    static long meshBuildCount() { return meshBuilds.load(); };
+    unsigned int revision() const { return revisionStamp; };
+    static unsigned int latestRevision() { return revisions.load(); };
+
+    // rebuilds a stale mesh, the only part of drawing that reads the voxels,
+    // so it runs under World's edit lock and draw() after it doesn't need to
+    void prepare( bool packedFaces );
+
+    // facing is a mask of Voxel::Direction bits, see facingMask()
+    void draw( unsigned char facing = 63 );
+    void drawPacked( FaceProgram &program, unsigned char facing = 63 );
+    void buildMesh( std::vector<Face> &faceList );
+    void buildVertices( std::vector<float> &vertices );
+    // Voxel::shared for an empty chunk, write with setTypeAt()
+    Voxel voxel( int x, int y, int z );
+    unsigned short typeAt( int x, int y, int z ) const { return types[cell(x, y, z)]; };
+    void setTypeAt( int x, int y, int z, unsigned short t );
+
+    // setTypeAt() leaving the column's tops alone, for writers running
+    // beside others in the same column; they raise it themselves after
+    void writeTypeAt( int x, int y, int z, unsigned short t );
+
+    // bulk edits a row along x at a time, [x0, x1) at y, z. Nothing is
+    // culled or invalidated, the caller does that once when it's done
+    void fillBox( int x0, int y0, int z0, int x1, int y1, int z1, unsigned short t );
+    void fillRow( int x0, int x1, int y, int z, unsigned short t );
+    int replaceRow( int x0, int x1, int y, int z, unsigned short from, unsigned short to );
+    void readRow( int x0, int x1, int y, int z, unsigned short *out ) const;
+    void writeRow( int x0, int x1, int y, int z, const unsigned short *in );
+    Column *columnOf() const { return column; };
+
+    // nothing was ever written, there's no cell to cull, mesh or draw
+    bool isEmpty() const { return types == noTypes; };
+
+    // gives an empty chunk arrays of its own, all air. setTypeAt() does it
+    // on the first solid write, but not safely from two threads at once
+    void own();
+    bool isSky() const;
+    float x() const { return xpos; };
+    float y() const { return ypos; };
+    float z() const { return zpos; };
+    int lastDrawn() const { return drawn; };
+    void setDrawn( int drawCount ) { drawn = drawCount; };
+    int vertexCount() const { return faces * 4; };
+    int vertexCount( unsigned char facing ) const;
+    int sideVertices( int side ) const { return sideFaces[side] * 4; };
+    unsigned char facingMask( float cx, float cy, float cz ) const;
+
+    // squared, from the centre, for ordering draws
+    float distanceTo( float cx, float cy, float cz ) const {
+      const float dx = xpos + X * 0.5 - cx, dy = ypos + Y * 0.5 - cy, dz = zpos + Z * 0.5 - cz;
+      return dx*dx + dy*dy + dz*dz;
+    };
+    int listBytes() const { return faces * 4 * 5 * sizeof(float); };
+    int packedBytes() const { return faceRecords * sizeof(GLuint); };
+
+    // box queries are read back frames later, never waited on
+    void issueQuery();
+    bool pollQuery();
+    bool queryPending() const { return querying; };
+    bool isOccluded() const { return occluded; };
+    void setOccluded( bool o ) { occluded = o; };
+
+    void joinRegion( Region *r, int slot );
+    Region *memberOf() const { return region; };
+    int memberSlot() const { return regionSlot; };
+
+    static bool visibleToCamera( Camera &camera, float xpos, float ypos, float zpos );
+
+    static bool contains( int x, int y, int z );
+    static int cell( int x, int y, int z );
+    static void cellCoords( int i, int &x, int &y, int &z );
+    static const char *layoutName();
+    static const char *shapeName();
+};
+
+#if defined(OPENMINE_CHUNK_32)
+typedef ChunkT<32, 32, 32> Chunk;
+#elif defined(OPENMINE_CHUNK_COLUMN)
+typedef ChunkT<16, 256, 16> Chunk;
+#else
+typedef ChunkT<16, 16, 16> Chunk;
+#endif
+
+#ifdef OPENMINE_MORTON_VOXELS
+// Morton (Z-order) numbering interleaves the coordinate bits, so neighbours
+// along any axis land a few cells apart instead of a whole row or slab.
+// Once the shorter axes run out of bits the longer ones carry on alone.
+template<int X, int Y, int Z>
+struct MortonOrder
+{
+  int spread[3][256];
+  unsigned char coords[X*Y*Z][3];
+
+  MortonOrder()
+  {
+    const int sizes[3] = { X, Y, Z };
+    int next = 0;
+    for ( int axis = 0; axis < 3; axis++ )
+      for ( int c = 0; c < 256; c++ )
+        spread[axis][c] = 0;
+
+    for ( int b = 0; (1 << b) < X || (1 << b) < Y || (1 << b) < Z; b++ ) {
+      for ( int axis = 0; axis < 3; axis++ ) {
+        if ( (1 << b) >= sizes[axis] ) continue;
+        for ( int c = 0; c < sizes[axis]; c++ )
+          if ( c & (1 << b) ) spread[axis][c] |= 1 << next;
+        next++;
+      }
+    }
+
+    for ( int z = 0; z < Z; z++ )
+      for ( int y = 0; y < Y; y++ )
+        for ( int x = 0; x < X; x++ ) {
+          unsigned char *c = coords[ spread[0][x] | spread[1][y] | spread[2][z] ];
+          c[0] = x; c[1] = y; c[2] = z;
+        }
+  }
+
+  static const MortonOrder table;
+};
+
+template<int X, int Y, int Z>
+const MortonOrder<X, Y, Z> MortonOrder<X, Y, Z>::table;
+
+template<int X, int Y, int Z>
+inline int ChunkT<X, Y, Z>::cell( int x, int y, int z )
+{
+  const MortonOrder<X, Y, Z> &m = MortonOrder<X, Y, Z>::table;
+  return m.spread[0][x] | m.spread[1][y] | m.spread[2][z];
+}
+
+template<int X, int Y, int Z>
+inline void ChunkT<X, Y, Z>::cellCoords( int i, int &x, int &y, int &z )
+{
+  const MortonOrder<X, Y, Z> &m = MortonOrder<X, Y, Z>::table;
+  x = m.coords[i][0];
+  y = m.coords[i][1];
+  z = m.coords[i][2];
+}
+
+template<int X, int Y, int Z>
+const char *ChunkT<X, Y, Z>::layoutName() { return "morton"; }
+#else
+template<int X, int Y, int Z>
+inline int ChunkT<X, Y, Z>::cell( int x, int y, int z )
+{
+  return ( z << (XSHIFT + YSHIFT) ) | ( y << XSHIFT ) | x;
+}
+
+template<int X, int Y, int Z>
+inline void ChunkT<X, Y, Z>::cellCoords( int i, int &x, int &y, int &z )
+{
+  x = i & XMASK;
+  y = ( i >> XSHIFT ) & YMASK;
+  z = i >> ( XSHIFT + YSHIFT );
+}
+
+template<int X, int Y, int Z>
+const char *ChunkT<X, Y, Z>::layoutName() { return "linear"; }
+#endif
+
+template<int X, int Y, int Z>
+inline bool ChunkT<X, Y, Z>::contains( int x, int y, int z )
+{
+  return ( (x & ~XMASK) | (y & ~YMASK) | (z & ~ZMASK) ) == 0;
+}
+
+template<int X, int Y, int Z>
+const char *ChunkT<X, Y, Z>::shapeName()
+{
+  static std::string name;
+  if ( name.empty() ) {
+    std::stringstream ss;
+    ss << X << "x" << Y << "x" << Z;
+    name = ss.str();
+  }
+  return name.c_str();
+}
+
+#endif
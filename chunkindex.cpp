@@ -0,0 +1,130 @@
+// made by inny
+
+#include "chunkindex.h"
+
+using namespace std;
+
+ChunkIndex::ChunkIndex()
+  : count(0)
+{
+  for ( int i = 0; i < BUCKETS; i++ ) buckets[i].store( 0 );
+}
+
+ChunkIndex::~ChunkIndex()
+{
+  clear();
+}
+
+int ChunkIndex::bucketOf( unsigned int key )
+{
+  // keys pack x, z and y into bit fields, so spread them before masking
+  key ^= key >> 16;
+  key *= 0x45d9f3bu;
+  key ^= key >> 16;
+  return key & (BUCKETS - 1);
+}
+
+Chunk *ChunkIndex::find( unsigned int key ) const
+{
+  Node *n = buckets[bucketOf(key)].load( memory_order_acquire );
+  while ( n ) {
+    if ( n->key == key ) return n->chunk;
+    n = n->next.load( memory_order_acquire );
+  }
+  return 0;
+}
+
+bool ChunkIndex::insert( unsigned int key, Chunk *c )
+{
+  const int b = bucketOf( key );
+  lock_guard<mutex> hold( shards[b % SHARDS] );
+
+  Node *head = buckets[b].load( memory_order_relaxed );
+  for ( Node *n = head; n; n = n->next.load( memory_order_relaxed ) )
+    if ( n->key == key ) return false;
+
+  Node *node = new Node;
+  node->key = key;
+  node->chunk = c;
+  node->next.store( head, memory_order_relaxed );
+  buckets[b].store( node, memory_order_release );
+  count++;
+  return true;
+}
+
+bool ChunkIndex::remove( unsigned int key )
+{
+  const int b = bucketOf( key );
+  Node *gone = 0;
+  {
+    lock_guard<mutex> hold( shards[b % SHARDS] );
+    atomic<Node*> *link = &buckets[b];
+    Node *n = link->load( memory_order_relaxed );
+    while ( n && n->key != key ) {
+      link = &n->next;
+      n = link->load( memory_order_relaxed );
+    }
+    if ( !n ) return false;
+
+    // readers already on n still see the rest of the chain through it
+    link->store( n->next.load( memory_order_relaxed ), memory_order_release );
+    gone = n;
+    count--;
+  }
+
+  Retired r;
+  r.node = gone;
+  r.stamp = Epoch::current();
+  lock_guard<mutex> hold( retireLock );
+  retired.push_back( r );
+  return true;
+}
+
+void ChunkIndex::reclaim( unsigned int moves )
+{
+  vector<Node*> dead;
+  {
+    lock_guard<mutex> hold( retireLock );
+    if ( retired.empty() ) return;
+    Epoch::advance();
+
+    int kept = 0;
+    for ( int i = 0; i < retired.size(); i++ ) {
+      if ( Epoch::expired( retired[i].stamp, moves ) ) dead.push_back( retired[i].node );
+      else retired[kept++] = retired[i];
+    }
+    retired.resize( kept );
+  }
+
+  for ( int i = 0; i < dead.size(); i++ ) {
+    delete dead[i]->chunk;
+    delete dead[i];
+  }
+}
+
+void ChunkIndex::clear()
+{
+  for ( int b = 0; b < BUCKETS; b++ ) {
+    Node *n = buckets[b].load();
+    while ( n ) {
+      Node *next = n->next.load();
+      delete n->chunk;
+      delete n;
+      n = next;
+    }
+    buckets[b].store( 0 );
+  }
+  count.store( 0 );
+
+  for ( int i = 0; i < retired.size(); i++ ) {
+    delete retired[i].node->chunk;
+    delete retired[i].node;
+  }
+  retired.clear();
+}
+
+int ChunkIndex::retiring()
+{
+  lock_guard<mutex> hold( retireLock );
+  return retired.size();
+}
@@ -0,0 +1,73 @@
+// made by inny
+
+#ifndef OPENMINE_CHUNKINDEX_H
+#define OPENMINE_CHUNKINDEX_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "chunk.h"
+#include "epoch.h"
+
+// Loaded chunks by key, for any number of threads at once. Lookups walk a
+// bucket's chain without taking a lock. Inserts and removes lock the shard
+// their bucket belongs to, and a removed chunk is only deleted once every
+// reader that could have found it has let go of its Epoch::Guard.
+//
+// Reading from a thread other than the one calling reclaim() needs a guard
+// held for as long as the chunk pointer is in use.
+class ChunkIndex
+{
+  public:
+    static const int BUCKETS = 4096;
+    static const int SHARDS = 64;
+
+  protected:
+    // key and chunk never change once a node is linked in
+    struct Node
+    {
+      unsigned int key;
+      Chunk *chunk;
+      std::atomic<Node*> next;
+    };
+
+    struct Retired
+    {
+      Node *node;
+      unsigned int stamp;
+    };
+
+    std::atomic<Node*> buckets[BUCKETS];
+    std::mutex shards[SHARDS];
+    std::atomic<int> count;
+
+    std::mutex retireLock;
+    std::vector<Retired> retired;
+
+    static int bucketOf( unsigned int key );
+
+  public:
+    ChunkIndex();
+    virtual ~ChunkIndex();
+
+    Chunk *find( unsigned int key ) const;
+
+    // false if the key is taken already
+    bool insert( unsigned int key, Chunk *c );
+
+    // the chunk is deleted by a later reclaim(), false if it wasn't there
+    bool remove( unsigned int key );
+
+    // deletes removed chunks nobody can see any more, once the epoch has
+    // moved on at least this often since. Chunks free GL objects, so this
+    // belongs on the GL thread
+    void reclaim( unsigned int moves = 2 );
+
+    // deletes everything at once, no other thread may be looking
+    void clear();
+
+    int size() const { return count.load(); };
+    int retiring();
+};
+
+#endif
@@ -0,0 +1,26 @@
+// made by inny
+
+#include <cmath>
+#include <cstdlib>
+#include "world.h"
+#include "column.h"
+
+using namespace std;
+
+Column::Column( int x, int z )
+  : xpos(x), zpos(z), refs(0), highest(-1)
+{
+  const float xc = 0.5 * float(World::XBLOCKS);
+  const float yc = 0.5 * float(World::GROUND);
+  const float zc = 0.5 * float(World::ZBLOCKS);
+
+  for ( int lz = 0; lz < Chunk::ZSIZE; lz++ ) {
+    for ( int lx = 0; lx < Chunk::XSIZE; lx++ ) {
+      const float xp = xpos + float(lx) + 0.5*Voxel::SIZE;
+      const float zp = zpos + float(lz) + 0.5*Voxel::SIZE;
+      heights[cell(lx, lz)] = sin((xp)/90.0*M_PI)*yc*2;
+      tunnels[cell(lx, lz)] = (abs(xp-xc) < 5.0) || (abs(zp-zc) < 5.0);
+      tops[cell(lx, lz)] = -1;
+    }
+  }
+}
@@ -0,0 +1,57 @@
+// made by inny
+
+#ifndef OPENMINE_COLUMN_H
+#define OPENMINE_COLUMN_H
+
+#include "chunk.h"
+
+// Everything about a vertical stack of chunks that only depends on x and z.
+// The terrain terms are worked out once when the first chunk of the stack
+// loads, every chunk above and below reads them, and the column goes away
+// with the last of them.
+class Column
+{
+  public:
+    static const int CELLS = Chunk::XSIZE * Chunk::ZSIZE;
+
+  protected:
+    int xpos;
+    int zpos;
+    int refs;
+    int highest;
+
+    double heights[CELLS];
+    bool tunnels[CELLS];
+
+    // highest solid block any loaded chunk has held, -1 for none yet
+    short tops[CELLS];
+
+    static int cell( int x, int z ) { return z * Chunk::XSIZE + x; };
+
+  public:
+    Column( int x, int z );
+
+    int x() const { return xpos; };
+    int z() const { return zpos; };
+    void acquire() { refs++; };
+    bool release() { return --refs == 0; };
+
+    // the hill line above the middle of the world, and whether the cross
+    // shaped tunnel runs through, local coordinates
+    double height( int x, int z ) const { return heights[cell(x, z)]; };
+    bool tunnel( int x, int z ) const { return tunnels[cell(x, z)]; };
+
+    // blocks only ever push this up, so it never sits below the real top
+    int top( int x, int z ) const { return tops[cell(x, z)]; };
+    void raise( int x, int y, int z )
+    {
+      short &t = tops[cell(x, z)];
+      if ( y > t ) t = y;
+      if ( y > highest ) highest = y;
+    };
+
+    // a chunk starting above this is all air and needs no culling or mesh
+    int highestTop() const { return highest; };
+};
+
+#endif
@@ -0,0 +1,225 @@
+// made by inny
+
+#include <algorithm>
+#include <cstring>
+#include "faceprogram.h"
+#include "world.h"
+#include "drawqueue.h"
+
+using namespace std;
+
+DrawState::DrawState()
+  : texture(0), fog(false), colorWrite(true), depthWrite(true), cull(true),
+    polygon(GL_FILL), arrays(false), program(0)
+{
+  /* */
+}
+
+bool DrawState::operator==( const DrawState &s ) const
+{
+  return texture == s.texture && fog == s.fog && colorWrite == s.colorWrite &&
+         depthWrite == s.depthWrite && cull == s.cull && polygon == s.polygon &&
+         arrays == s.arrays && program == s.program;
+}
+
+// -----------------------------------------------------------------------------
+
+GLState::GLState()
+  : known(false), fogStart(0), fogEnd(0), changes(0), skipped(0)
+{
+  /* */
+}
+
+// false when GL has it already
+bool GLState::differs( bool same )
+{
+  if ( known && same ) {
+    skipped++;
+    return false;
+  }
+  changes++;
+  return true;
+}
+
+void GLState::apply( const DrawState &s )
+{
+  if ( differs( current.texture == s.texture ) ) {
+    if ( s.texture ) {
+      glEnable( GL_TEXTURE_2D );
+      glBindTexture( GL_TEXTURE_2D, s.texture );
+
+      // untextured draws leave their last colour behind
+      glColor3f( 1.0, 1.0, 1.0 );
+    }
+    else glDisable( GL_TEXTURE_2D );
+  }
+
+  const bool fogged = differs( current.fog == s.fog );
+  if (fogged) {
+    if ( s.fog ) glEnable( GL_FOG );
+    else glDisable( GL_FOG );
+  }
+
+  if ( differs( current.colorWrite == s.colorWrite ) ) {
+    const GLboolean c = s.colorWrite ? GL_TRUE : GL_FALSE;
+    glColorMask( c, c, c, c );
+  }
+
+  if ( differs( current.depthWrite == s.depthWrite ) )
+    glDepthMask( s.depthWrite ? GL_TRUE : GL_FALSE );
+
+  if ( differs( current.cull == s.cull ) ) {
+    if ( s.cull ) glEnable( GL_CULL_FACE );
+    else glDisable( GL_CULL_FACE );
+  }
+
+  if ( differs( current.polygon == s.polygon ) )
+    glPolygonMode( GL_FRONT_AND_BACK, s.polygon );
+
+  if ( differs( current.arrays == s.arrays ) ) {
+    if ( s.arrays ) {
+      glEnableClientState( GL_VERTEX_ARRAY );
+      glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    }
+    else {
+      glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+      glDisableClientState( GL_VERTEX_ARRAY );
+      glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+  }
+
+  // the face program picks up fog as it begins
+  if ( differs( current.program == s.program && !(s.program && fogged) ) ) {
+    if ( known && current.program ) current.program->end();
+    if ( s.program ) s.program->begin();
+  }
+
+  current = s;
+  known = true;
+}
+
+void GLState::fogRange( float start, float end )
+{
+  if ( !differs( fogStart == start && fogEnd == end ) ) return;
+
+  GLfloat fogColor[4]= {0.75f, 0.75f, 0.75f, 1.0f};
+  glFogfv(GL_FOG_COLOR, fogColor);
+  glFogi(GL_FOG_MODE, GL_LINEAR);
+  glFogf(GL_FOG_START, start);
+  glFogf(GL_FOG_END, end);
+  glHint(GL_FOG_HINT, GL_DONT_CARE);
+  fogStart = start;
+  fogEnd = end;
+}
+
+// -----------------------------------------------------------------------------
+
+DrawQueue::DrawQueue()
+  : counting(false), frame(0), overdraw(0), pixels(0)
+{
+  samples[0] = samples[1] = 0;
+  pending[0] = pending[1] = false;
+}
+
+DrawQueue::~DrawQueue()
+{
+  if (samples[0]) glDeleteQueries( 2, samples );
+}
+
+int DrawQueue::state( const DrawState &s )
+{
+  for ( int i = 0; i < states.size(); i++ )
+    if ( states[i] == s ) return i;
+  states.push_back( s );
+  return states.size() - 1;
+}
+
+void DrawQueue::add( int pass, int state, float depth, Drawable *owner, int kind, int index )
+{
+  // positive floats sort the same as their bits
+  uint32_t bits = 0;
+  if ( pass == PREPASS || pass == OPAQUE || pass == EFFECTS ) {
+    depth = max( depth, 0.0f );
+    memcpy( &bits, &depth, sizeof(bits) );
+    if ( pass == EFFECTS ) bits = ~bits;
+  }
+
+  Item item;
+  item.key = (uint64_t(pass) << 60) | (uint64_t(min( state, STATES-1 )) << 52) |
+             (uint64_t(bits) << 20) | (items.size() & 0xFFFFF);
+  item.owner = owner;
+  item.kind = kind;
+  item.index = index;
+  item.state = state;
+  items.push_back( item );
+}
+
+// the count from two frames back is read before its query starts over; if
+// it isn't in yet this frame goes uncounted rather than wait on it
+void DrawQueue::countOverdraw( bool begin )
+{
+  if ( !begin ) {
+    if (counting) glEndQuery( GL_SAMPLES_PASSED );
+    counting = false;
+    return;
+  }
+
+  if (!samples[0]) glGenQueries( 2, samples );
+  const int slot = frame & 1;
+  if ( pending[slot] ) {
+    GLint available = 0;
+    glGetQueryObjectiv( samples[slot], GL_QUERY_RESULT_AVAILABLE, &available );
+    if (!available) return;
+
+    GLuint passed = 0;
+    glGetQueryObjectuiv( samples[slot], GL_QUERY_RESULT, &passed );
+    overdraw = float(passed) / float(pixels);
+    pending[slot] = false;
+  }
+
+  glBeginQuery( GL_SAMPLES_PASSED, samples[slot] );
+  pending[slot] = true;
+  counting = true;
+}
+
+void DrawQueue::flush( RenderStats &stats )
+{
+  // the window never changes size, and multisampling counts every sample
+  if ( !pixels ) {
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    GLint multisamples = 0;
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    glGetIntegerv( GL_SAMPLES, &multisamples );
+    pixels = max( 1L, long(viewport[2]) * viewport[3] * max( multisamples, 1 ) );
+  }
+
+  sort( items.begin(), items.end() );
+
+  int pass = -1;
+  for ( int i = 0; i < items.size(); i++ ) {
+    const Item &item = items[i];
+    const int p = int( item.key >> 60 );
+    if ( p != pass ) {
+      if ( pass == OPAQUE ) countOverdraw( false );
+      if ( p == OPAQUE ) countOverdraw( true );
+      pass = p;
+    }
+    gl.apply( states[item.state] );
+    item.owner->drawItem( item.kind, item.index, p, stats );
+  }
+  if ( pass == OPAQUE ) countOverdraw( false );
+
+  DrawState cleared = gl.state();
+  cleared.colorWrite = true;
+  cleared.depthWrite = true;
+  gl.apply( cleared );
+
+  stats.stateChanges += gl.changeCount();
+  stats.stateSkipped += gl.skippedCount();
+  stats.overdraw = overdraw;
+  gl.resetCounts();
+
+  items.clear();
+  states.clear();
+  frame++;
+}
@@ -0,0 +1,132 @@
+// made by inny
+
+#ifndef OPENMINE_DRAWQUEUE_H
+#define OPENMINE_DRAWQUEUE_H
+
+#include <stdint.h>
+#include <vector>
+#include "opengl.h"
+
+class FaceProgram;
+struct RenderStats;
+
+// The GL state a draw wants. Whatever isn't here stays as setupGL() left it.
+struct DrawState
+{
+  // 0 draws untextured
+  GLuint texture;
+  bool fog;
+  bool colorWrite;
+  bool depthWrite;
+  bool cull;
+  GLenum polygon;
+
+  // vertex and texture coordinate client arrays, for interleaved buffers
+  bool arrays;
+
+  // begun when a draw wants it and ended when one doesn't
+  FaceProgram *program;
+
+  DrawState();
+  bool operator==( const DrawState &s ) const;
+};
+
+// Remembers what it last sent GL and sends only what changed. Anything that
+// touches the same state behind its back has to forget() after.
+class GLState
+{
+  protected:
+    DrawState current;
+    bool known;
+    float fogStart, fogEnd;
+    int changes;
+    int skipped;
+
+    bool differs( bool same );
+
+  public:
+    GLState();
+
+    void apply( const DrawState &s );
+    const DrawState &state() const { return current; };
+    void fogRange( float start, float end );
+    void forget() { known = false; };
+
+    // GL calls sent and held back since the last reset
+    int changeCount() const { return changes; };
+    int skippedCount() const { return skipped; };
+    void resetCounts() { changes = 0; skipped = 0; };
+};
+
+// -----------------------------------------------------------------------------
+
+// Anything that queues draws gets them back through here, in key order.
+class Drawable
+{
+  public:
+    virtual ~Drawable() { /* */ };
+    virtual void drawItem( int kind, int index, int pass, RenderStats &stats ) = 0;
+};
+
+// A frame's draws, each with a sort key of pass, then state, then depth.
+// Opaque draws go front to back so the nearest fill the depth buffer first
+// and hide the rest early; effects go back to front; queries and the overlay
+// keep the order they came in. The optional prepass lays down depth alone
+// before the opaque pass draws colour over it.
+//
+// The samples the opaque pass lets through are counted with a query and
+// read a couple of frames later, over the viewport's pixels that's overdraw.
+class DrawQueue
+{
+  public:
+    enum Pass { PREPASS, OPAQUE, QUERIES, EFFECTS, OVERLAY, PASSES };
+
+    // the key has room to tell this many states apart; more still draw with
+    // the right state, they just stop batching
+    static const int STATES = 256;
+
+  protected:
+    struct Item
+    {
+      uint64_t key;
+      Drawable *owner;
+      int kind;
+      int index;
+      int state;
+
+      bool operator<( const Item &o ) const { return key < o.key; };
+    };
+
+    std::vector<Item> items;
+    std::vector<DrawState> states;
+    GLState gl;
+
+    // two frames' counts, each read back when its turn comes round again
+    GLuint samples[2];
+    bool pending[2];
+    bool counting;
+    int frame;
+    float overdraw;
+    long pixels;
+
+    void countOverdraw( bool begin );
+
+  public:
+    DrawQueue();
+    virtual ~DrawQueue();
+
+    // the index of a state for this frame's keys, the same one for equal states
+    int state( const DrawState &s );
+
+    // depth is how far from the eye, anything that sorts will do
+    void add( int pass, int state, float depth, Drawable *owner, int kind, int index );
+
+    // sorts and draws everything added, then starts over. Colour and depth
+    // writes are left on, glClear() goes by them
+    void flush( RenderStats &stats );
+
+    GLState &glState() { return gl; };
+    bool isEmpty() const { return items.empty(); };
+};
+
+#endif
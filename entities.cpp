@@ -0,0 +1,346 @@
+// made by inny
+
+#include <algorithm>
+#include <cmath>
+#include "util.h"
+#include "epoch.h"
+#include "workers.h"
+#include "world.h"
+#include "entities.h"
+
+using namespace std;
+
+int EntityStore::add( float px, float py, float pz, float ex, float ey, float ez )
+{
+  x.push_back( px ); y.push_back( py ); z.push_back( pz );
+  vx.push_back( 0 ); vy.push_back( 0 ); vz.push_back( 0 );
+  hx.push_back( ex ); hy.push_back( ey ); hz.push_back( ez );
+  grounded.push_back( 0 );
+  return x.size() - 1;
+}
+
+template<class T>
+static void swapOut( vector<T> &v, int i )
+{
+  v[i] = v.back();
+  v.pop_back();
+}
+
+// moves the last entity into the hole
+void EntityStore::remove( int i )
+{
+  swapOut( x, i ); swapOut( y, i ); swapOut( z, i );
+  swapOut( vx, i ); swapOut( vy, i ); swapOut( vz, i );
+  swapOut( hx, i ); swapOut( hy, i ); swapOut( hz, i );
+  swapOut( grounded, i );
+}
+
+void EntityStore::clear()
+{
+  x.clear(); y.clear(); z.clear();
+  vx.clear(); vy.clear(); vz.clear();
+  hx.clear(); hy.clear(); hz.clear();
+  grounded.clear();
+}
+
+template<class T>
+static void reorder( vector<T> &v, const vector<int> &order )
+{
+  vector<T> sorted( v.size() );
+  for ( int i = 0; i < order.size(); i++ ) sorted[i] = v[order[i]];
+  v.swap( sorted );
+}
+
+void EntityStore::permute( const vector<int> &order )
+{
+  reorder( x, order ); reorder( y, order ); reorder( z, order );
+  reorder( vx, order ); reorder( vy, order ); reorder( vz, order );
+  reorder( hx, order ); reorder( hy, order ); reorder( hz, order );
+  reorder( grounded, order );
+}
+
+// -----------------------------------------------------------------------------
+
+// Remembers the last chunk it looked in; chunk mates mostly probe the same one.
+struct VoxelProbe
+{
+  World &world;
+  Chunk *chunk;
+  int cx, cy, cz;
+  bool cached;
+
+  VoxelProbe( World &w ) : world(w), chunk(0), cx(0), cy(0), cz(0), cached(false) { /* */ };
+
+  bool solid( int x, int y, int z )
+  {
+    const int ox = x & ~Chunk::XMASK;
+    const int oy = y & ~Chunk::YMASK;
+    const int oz = z & ~Chunk::ZMASK;
+    if ( !cached || ox != cx || oy != cy || oz != cz ) {
+      chunk = world.chunkAt( ox, oy, oz );
+      cx = ox; cy = oy; cz = oz;
+      cached = true;
+    }
+    return chunk && chunk->typeAt( x - ox, y - oy, z - oz ) != 0;
+  };
+};
+
+static const float EPS = 0.001f;
+
+// Moves a box along one axis, stopping flush against the first solid cell its
+// leading face would enter. Returns true if it was stopped.
+static bool sweep( VoxelProbe &probe, float p[3], const float h[3], int axis, float d )
+{
+  if ( d == 0.0f ) return false;
+
+  const int a1 = (axis + 1) % 3;
+  const int a2 = (axis + 2) % 3;
+  const int lo1 = floor( p[a1] - h[a1] + EPS ), hi1 = floor( p[a1] + h[a1] - EPS );
+  const int lo2 = floor( p[a2] - h[a2] + EPS ), hi2 = floor( p[a2] + h[a2] - EPS );
+  int c[3];
+
+  if ( d > 0 ) {
+    const int first = ceil( p[axis] + h[axis] - EPS );
+    const int last = int( ceil( p[axis] + h[axis] + d - EPS ) ) - 1;
+    for ( int s = first; s <= last; s++ ) {
+      c[axis] = s;
+      for ( c[a1] = lo1; c[a1] <= hi1; c[a1]++ )
+        for ( c[a2] = lo2; c[a2] <= hi2; c[a2]++ )
+          if ( probe.solid( c[0], c[1], c[2] ) ) {
+            p[axis] = s - h[axis];
+            return true;
+          }
+    }
+  }
+  else {
+    const int first = int( floor( p[axis] - h[axis] + EPS ) ) - 1;
+    const int last = floor( p[axis] - h[axis] + d + EPS );
+    for ( int s = first; s >= last; s-- ) {
+      c[axis] = s;
+      for ( c[a1] = lo1; c[a1] <= hi1; c[a1]++ )
+        for ( c[a2] = lo2; c[a2] <= hi2; c[a2]++ )
+          if ( probe.solid( c[0], c[1], c[2] ) ) {
+            p[axis] = s + 1 + h[axis];
+            return true;
+          }
+    }
+  }
+
+  p[axis] += d;
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+
+EntityPhysics::EntityPhysics( World &w, WorkerPool &p )
+  : world(w), pool(p), reachX(0), reachY(0), reachZ(0)
+{
+  gridX = ceil( World::XSIZE * Chunk::XSIZE / CELL );
+  gridY = ceil( World::YSIZE * Chunk::YSIZE / CELL );
+  gridZ = ceil( World::ZSIZE * Chunk::ZSIZE / CELL );
+}
+
+// anything outside the world shares the border cells
+int EntityPhysics::gridCell( float v, int cells ) const
+{
+  const int c = floor( v / CELL );
+  return c < 0 ? 0 : c >= cells ? cells - 1 : c;
+}
+
+// one group per chunk of the world grid, plus one for anything outside it
+int EntityPhysics::chunkKey( float x, float y, float z ) const
+{
+  const int cx = int(floor(x)) >> Chunk::XSHIFT;
+  const int cy = int(floor(y)) >> Chunk::YSHIFT;
+  const int cz = int(floor(z)) >> Chunk::ZSHIFT;
+  if ( cx < 0 || cx >= World::XSIZE || cy < 0 || cy >= World::YSIZE ||
+       cz < 0 || cz >= World::ZSIZE )
+    return World::XSIZE * World::YSIZE * World::ZSIZE;
+  return (cz * World::YSIZE + cy) * World::XSIZE + cx;
+}
+
+void EntityPhysics::binByChunk( EntityStore &e )
+{
+  const int groups = World::XSIZE * World::YSIZE * World::ZSIZE + 1;
+  const int n = e.size();
+
+  keys.resize( n );
+  groupStart.assign( groups + 1, 0 );
+  for ( int i = 0; i < n; i++ ) {
+    keys[i] = chunkKey( e.x[i], e.y[i], e.z[i] );
+    groupStart[keys[i] + 1]++;
+  }
+  for ( int g = 0; g < groups; g++ ) groupStart[g+1] += groupStart[g];
+
+  // groupStart doubles as the fill cursor, then gets shifted back
+  order.resize( n );
+  for ( int i = 0; i < n; i++ ) order[ groupStart[keys[i]]++ ] = i;
+  for ( int g = groups; g > 0; g-- ) groupStart[g] = groupStart[g-1];
+  groupStart[0] = 0;
+
+  e.permute( order );
+}
+
+void EntityPhysics::buildGrid( EntityStore &e )
+{
+  const int n = e.size();
+  const int cells = gridX * gridY * gridZ;
+
+  keys.resize( n );
+  gridStart.assign( cells + 1, 0 );
+  reachX = reachY = reachZ = 0;
+  for ( int i = 0; i < n; i++ ) {
+    reachX = max( reachX, e.hx[i] );
+    reachY = max( reachY, e.hy[i] );
+    reachZ = max( reachZ, e.hz[i] );
+    keys[i] = ( gridCell( e.z[i], gridZ ) * gridY + gridCell( e.y[i], gridY ) ) * gridX +
+              gridCell( e.x[i], gridX );
+    gridStart[keys[i] + 1]++;
+  }
+  for ( int c = 0; c < cells; c++ ) gridStart[c+1] += gridStart[c];
+
+  gridEntries.resize( n );
+  for ( int i = 0; i < n; i++ ) {
+    GridEntry &g = gridEntries[ gridStart[keys[i]]++ ];
+    g.x = e.x[i]; g.y = e.y[i]; g.z = e.z[i];
+    g.hx = e.hx[i]; g.hy = e.hy[i]; g.hz = e.hz[i];
+    g.index = i;
+  }
+  for ( int c = cells; c > 0; c-- ) gridStart[c] = gridStart[c-1];
+  gridStart[0] = 0;
+}
+
+// each entity only writes its own push, so ranges run in parallel
+void EntityPhysics::solveContacts( EntityStore &e, int begin, int end )
+{
+  const float MAXPUSH = 0.25f;
+
+  for ( int i = begin; i < end; i++ ) {
+    const float x = e.x[i], y = e.y[i], z = e.z[i];
+    const float hx = e.hx[i], hy = e.hy[i], hz = e.hz[i];
+    float px = 0, pz = 0;
+
+    // only the cells a touching neighbour's centre could be in
+    const int x0 = gridCell( x - hx - reachX, gridX ), x1 = gridCell( x + hx + reachX, gridX );
+    const int y0 = gridCell( y - hy - reachY, gridY ), y1 = gridCell( y + hy + reachY, gridY );
+    const int z0 = gridCell( z - hz - reachZ, gridZ ), z1 = gridCell( z + hz + reachZ, gridZ );
+
+    for ( int cz = z0; cz <= z1; cz++ ) {
+      for ( int cy = y0; cy <= y1; cy++ ) {
+        const int row = ( cz * gridY + cy ) * gridX;
+        const int last = gridStart[row + x1 + 1];
+
+        for ( int k = gridStart[row + x0]; k < last; k++ ) {
+          const GridEntry &g = gridEntries[k];
+          const float ox = hx + g.hx - fabs( x - g.x );
+          const float oy = hy + g.hy - fabs( y - g.y );
+          const float oz = hz + g.hz - fabs( z - g.z );
+          if ( ox <= 0 || oy <= 0 || oz <= 0 || g.index == i ) continue;
+
+          // half the overlap each, along whichever flat axis is shallower
+          if ( ox < oz ) {
+            const float side = x != g.x ? x - g.x : float(i - g.index);
+            px += side < 0 ? -0.5f * ox : 0.5f * ox;
+          }
+          else {
+            const float side = z != g.z ? z - g.z : float(i - g.index);
+            pz += side < 0 ? -0.5f * oz : 0.5f * oz;
+          }
+        }
+      }
+    }
+
+    pushX[i] = bound( -MAXPUSH, px, MAXPUSH );
+    pushZ[i] = bound( -MAXPUSH, pz, MAXPUSH );
+  }
+}
+
+void EntityPhysics::integrate( EntityStore &e, int group, float dt )
+{
+  VoxelProbe probe( world );
+  const float drag = max( 0.0f, 1.0f - FRICTION * dt );
+
+  for ( int i = groupStart[group]; i < groupStart[group+1]; i++ ) {
+    float vx = e.vx[i], vy = e.vy[i], vz = e.vz[i];
+
+    vy = max( vy - GRAVITY * dt, -TERMINAL );
+    if ( e.grounded[i] ) {
+      vx *= drag;
+      vz *= drag;
+    }
+
+    float p[3] = { e.x[i], e.y[i], e.z[i] };
+    const float h[3] = { e.hx[i], e.hy[i], e.hz[i] };
+    const float dy = vy * dt;
+    bool grounded = false;
+
+    if ( sweep( probe, p, h, 1, dy ) ) {
+      grounded = dy < 0;
+      vy = 0;
+    }
+
+    // don't fall beneath the 0 layer, settled before moving sideways so
+    // nothing slides in under the world from outside it
+    if ( p[1] - h[1] < 0 ) {
+      p[1] = h[1];
+      vy = 0;
+      grounded = true;
+    }
+
+    if ( sweep( probe, p, h, 0, vx * dt + pushX[i] ) ) vx = 0;
+    if ( sweep( probe, p, h, 2, vz * dt + pushZ[i] ) ) vz = 0;
+
+    e.x[i] = p[0]; e.y[i] = p[1]; e.z[i] = p[2];
+    e.vx[i] = vx; e.vy[i] = vy; e.vz[i] = vz;
+    e.grounded[i] = grounded;
+  }
+}
+
+void EntityPhysics::step( EntityStore &e, float dt )
+{
+  const int n = e.size();
+  const int BLOCK = 512;
+
+  double start = seconds();
+  binByChunk( e );
+  double now = seconds();
+  stepTimes.bin = now - start;
+
+  start = now;
+  buildGrid( e );
+  pushX.resize( n );
+  pushZ.resize( n );
+  pool.run( (n + BLOCK - 1) / BLOCK, [&]( int b ) {
+    solveContacts( e, b * BLOCK, min( n, (b+1) * BLOCK ) );
+  });
+  now = seconds();
+  stepTimes.broadphase = now - start;
+
+  start = now;
+  pool.run( groupStart.size() - 1, [&]( int g ) {
+    Epoch::Guard guard;
+    integrate( e, g, dt );
+  });
+  stepTimes.integrate = seconds() - start;
+}
+
+int EntityPhysics::embedded( EntityStore &e )
+{
+  // sweeps let boxes sink up to EPS into a wall, so allow for that
+  const float SLACK = 2.0 * EPS;
+  VoxelProbe probe( world );
+  int count = 0;
+
+  for ( int i = 0; i < e.size(); i++ ) {
+    const int x0 = floor( e.x[i] - e.hx[i] + SLACK ), x1 = floor( e.x[i] + e.hx[i] - SLACK );
+    const int y0 = floor( e.y[i] - e.hy[i] + SLACK ), y1 = floor( e.y[i] + e.hy[i] - SLACK );
+    const int z0 = floor( e.z[i] - e.hz[i] + SLACK ), z1 = floor( e.z[i] + e.hz[i] - SLACK );
+    bool inside = false;
+    for ( int z = z0; z <= z1 && !inside; z++ )
+      for ( int y = y0; y <= y1 && !inside; y++ )
+        for ( int x = x0; x <= x1 && !inside; x++ )
+          inside = probe.solid( x, y, z );
+    if ( inside ) count++;
+  }
+  return count;
+}
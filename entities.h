@@ -0,0 +1,99 @@
+// made by inny
+
+#ifndef OPENMINE_ENTITIES_H
+#define OPENMINE_ENTITIES_H
+
+#include <vector>
+
+class World;
+class WorkerPool;
+
+// Mobs and dropped items as parallel arrays, one slot per entity. Slots get
+// reordered by the physics step, so don't hold on to an index across ticks.
+class EntityStore
+{
+  public:
+    // centre, velocity and half extents of each box
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> hx, hy, hz;
+    std::vector<unsigned char> grounded;
+
+    int size() const { return x.size(); };
+    int add( float px, float py, float pz, float ex, float ey, float ez );
+    void remove( int i );
+    void clear();
+
+    // slot i takes what was in slot order[i]
+    void permute( const std::vector<int> &order );
+};
+
+struct PhysicsTimes
+{
+  double bin;
+  double broadphase;
+  double integrate;
+
+  PhysicsTimes() { reset(); };
+  void reset() { bin = 0; broadphase = 0; integrate = 0; };
+};
+
+// -----------------------------------------------------------------------------
+
+// Steps every entity at once. Entities are sorted by the chunk they sit in,
+// so each group of chunk mates reads the same voxels and runs as one job on
+// the worker pool. Entity contacts come from a uniform grid and only push
+// horizontally, folded into the same swept move as gravity.
+class EntityPhysics
+{
+  public:
+    static constexpr float GRAVITY = 12.0;
+    static constexpr float TERMINAL = 30.0;
+    static constexpr float FRICTION = 8.0;
+
+    // broadphase cell edge
+    static constexpr float CELL = 2.0;
+
+  protected:
+    World &world;
+    WorkerPool &pool;
+    PhysicsTimes stepTimes;
+
+    // counting sort by chunk, groupStart[g] .. groupStart[g+1] per chunk
+    std::vector<int> keys;
+    std::vector<int> groupStart;
+    std::vector<int> order;
+
+    // uniform grid over the world, boxes copied in cell order so a row of
+    // neighbouring cells is one run of memory
+    struct GridEntry
+    {
+      float x, y, z;
+      float hx, hy, hz;
+      int index;
+    };
+    std::vector<int> gridStart;
+    std::vector<GridEntry> gridEntries;
+    int gridX, gridY, gridZ;
+    float reachX, reachY, reachZ;
+
+    std::vector<float> pushX, pushZ;
+
+    int chunkKey( float x, float y, float z ) const;
+    int gridCell( float v, int cells ) const;
+    void binByChunk( EntityStore &e );
+    void buildGrid( EntityStore &e );
+    void solveContacts( EntityStore &e, int begin, int end );
+    void integrate( EntityStore &e, int group, float dt );
+
+  public:
+    EntityPhysics( World &w, WorkerPool &p );
+
+    void step( EntityStore &e, float dt );
+    const PhysicsTimes &times() const { return stepTimes; };
+
+    // how many boxes ended up inside solid voxels, for the benchmark
+    int embedded( EntityStore &e );
+};
+
+#endif
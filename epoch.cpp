@@ -0,0 +1,62 @@
+// made by inny
+
+#include <cstdlib>
+#include <iostream>
+#include "epoch.h"
+
+using namespace std;
+
+Epoch::Slot Epoch::slots[SLOTS];
+atomic<unsigned int> Epoch::global( 1 );
+
+thread_local Epoch::Claim Epoch::claim;
+
+Epoch::Slot &Epoch::mine()
+{
+  if ( claim.index < 0 ) {
+    for ( int i = 0; i < SLOTS; i++ ) {
+      bool free = false;
+      if ( slots[i].used.compare_exchange_strong( free, true ) ) {
+        claim.index = i;
+        break;
+      }
+    }
+    if ( claim.index < 0 ) {
+      cerr << "out of epoch slots\n";
+      abort();
+    }
+  }
+  return slots[claim.index];
+}
+
+Epoch::Claim::~Claim()
+{
+  if ( index < 0 ) return;
+  slots[index].pinned.store( 0 );
+  slots[index].used.store( false );
+}
+
+void Epoch::enter()
+{
+  if ( claim.depth++ > 0 ) return;
+  // an exchange, not a store, so the pin is out before anything we read
+  // under it
+  mine().pinned.exchange( (global.load() << 1) | 1 );
+}
+
+void Epoch::leave()
+{
+  if ( --claim.depth > 0 ) return;
+  mine().pinned.store( 0, memory_order_release );
+}
+
+bool Epoch::advance()
+{
+  unsigned int e = global.load();
+  for ( int i = 0; i < SLOTS; i++ ) {
+    if ( !slots[i].used.load() ) continue;
+    const unsigned int p = slots[i].pinned.load();
+    if ( (p & 1) && (p >> 1) != e ) return false;
+  }
+  return global.compare_exchange_strong( e, e + 1 );
+}
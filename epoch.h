@@ -0,0 +1,67 @@
+// made by inny
+
+#ifndef OPENMINE_EPOCH_H
+#define OPENMINE_EPOCH_H
+
+#include <atomic>
+
+// Epoch based reclamation. A thread reading shared structures holds a Guard,
+// which pins it to the epoch that was current when it came in. Whatever is
+// unlinked gets stamped with the epoch of the day, and the epoch only moves
+// on once every pinned thread has caught up with it, so two moves later
+// nobody can still be looking at the thing and it can go.
+class Epoch
+{
+  public:
+    // threads that can hold a guard at once
+    static const int SLOTS = 128;
+
+    class Guard
+    {
+      public:
+        Guard() { enter(); };
+        ~Guard() { leave(); };
+    };
+
+  protected:
+    // the epoch a thread is pinned to, shifted up with the low bit set, or
+    // zero while it holds no guard
+    struct Slot
+    {
+      std::atomic<unsigned int> pinned;
+      std::atomic<bool> used;
+      char pad[64 - sizeof(std::atomic<unsigned int>) - sizeof(std::atomic<bool>)];
+    };
+
+    // a thread claims a slot with its first guard and hands it back on exit
+    struct Claim
+    {
+      int index;
+      int depth;
+      Claim() : index(-1), depth(0) { /* */ };
+      ~Claim();
+    };
+
+    static Slot slots[SLOTS];
+    static std::atomic<unsigned int> global;
+    static thread_local Claim claim;
+
+    static Slot &mine();
+    static void enter();
+    static void leave();
+
+  public:
+    static unsigned int current() { return global.load(); };
+
+    // moves the epoch on if every guard has seen the current one
+    static bool advance();
+
+    // stamped at or before this, nobody can still hold it. Owners that hand
+    // pointers on outside any guard can ask for more moves than that
+    static bool expired( unsigned int stamp, unsigned int moves = 2 )
+    {
+      return current() >= stamp + moves;
+    };
+};
+
+#endif
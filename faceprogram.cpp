@@ -0,0 +1,132 @@
+// made by inny
+
+#include <iostream>
+#include <sstream>
+#include "faceprogram.h"
+#include "voxel.h"
+
+using namespace std;
+
+static const char *faceVertexSource =
+  "#version 130\n"
+  "in uint face;\n"
+  "uniform vec3 origin;\n"
+  "uniform vec2 tiles[8];\n"
+  "out vec2 texcoord;\n"
+  "out float fogDepth;\n"
+  "const vec3 corners[24] = vec3[24](\n"
+  "  vec3(0,1,0), vec3(0,1,1), vec3(1,1,1), vec3(1,1,0),\n"
+  "  vec3(0,0,0), vec3(1,0,0), vec3(1,0,1), vec3(0,0,1),\n"
+  "  vec3(1,1,1), vec3(0,1,1), vec3(0,0,1), vec3(1,0,1),\n"
+  "  vec3(0,1,0), vec3(1,1,0), vec3(1,0,0), vec3(0,0,0),\n"
+  "  vec3(1,1,0), vec3(1,1,1), vec3(1,0,1), vec3(1,0,0),\n"
+  "  vec3(0,1,1), vec3(0,1,0), vec3(0,0,0), vec3(0,0,1) );\n"
+  "const vec2 spans[4] = vec2[4]( vec2(0,0), vec2(1,0), vec2(1,1), vec2(0,1) );\n"
+  "void main() {\n"
+  "  vec3 local = vec3( float(face & 255u), float((face >> 8) & 255u), float((face >> 16) & 255u) );\n"
+  "  int dir = int((face >> 24) & 7u);\n"
+  "  int tile = int(face >> 27);\n"
+  "  vec4 eye = gl_ModelViewMatrix * vec4( origin + local + corners[dir*4 + gl_VertexID], 1.0 );\n"
+  "  texcoord = ( tiles[tile] + spans[gl_VertexID] * 15.99 ) / 256.0;\n"
+  "  fogDepth = -eye.z;\n"
+  "  gl_Position = gl_ProjectionMatrix * eye;\n"
+  "}\n";
+
+static const char *faceFragmentSource =
+  "#version 130\n"
+  "uniform sampler2D tex;\n"
+  "uniform bool fogged;\n"
+  "in vec2 texcoord;\n"
+  "in float fogDepth;\n"
+  "void main() {\n"
+  "  vec4 color = texture( tex, texcoord );\n"
+  "  if (fogged) {\n"
+  "    float f = clamp( (gl_Fog.end - fogDepth) * gl_Fog.scale, 0.0, 1.0 );\n"
+  "    color.rgb = mix( gl_Fog.color.rgb, color.rgb, f );\n"
+  "  }\n"
+  "  gl_FragColor = color;\n"
+  "}\n";
+
+FaceProgram::FaceProgram()
+  : program(0), originLoc(-1), foggedLoc(-1), valid(false)
+{
+  GLuint vs = compile( GL_VERTEX_SHADER, faceVertexSource );
+  GLuint fs = compile( GL_FRAGMENT_SHADER, faceFragmentSource );
+  if ( !vs || !fs ) return;
+
+  program = glCreateProgram();
+  glAttachShader( program, vs );
+  glAttachShader( program, fs );
+  glBindAttribLocation( program, FACE, "face" );
+  glLinkProgram( program );
+  glDeleteShader( vs );
+  glDeleteShader( fs );
+
+  GLint linked = 0;
+  glGetProgramiv( program, GL_LINK_STATUS, &linked );
+  if (!linked) {
+    char log[1024];
+    glGetProgramInfoLog( program, sizeof(log), 0, log );
+    cout << "FaceProgram link: " << log << "\n";
+    return;
+  }
+
+  originLoc = glGetUniformLocation( program, "origin" );
+  foggedLoc = glGetUniformLocation( program, "fogged" );
+
+  glUseProgram( program );
+  glUniform1i( glGetUniformLocation( program, "tex" ), 0 );
+  for ( int i = 0; i < Voxel::TILES; i++ ) {
+    stringstream name;
+    name << "tiles[" << i << "]";
+    glUniform2f( glGetUniformLocation( program, name.str().c_str() ),
+                 Voxel::tiles[i].x, Voxel::tiles[i].y );
+  }
+  glUseProgram( 0 );
+
+  valid = true;
+}
+
+FaceProgram::~FaceProgram()
+{
+  if (program) glDeleteProgram( program );
+}
+
+GLuint FaceProgram::compile( GLenum type, const char *source )
+{
+  GLuint shader = glCreateShader( type );
+  glShaderSource( shader, 1, &source, 0 );
+  glCompileShader( shader );
+
+  GLint compiled = 0;
+  glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+  if (!compiled) {
+    char log[1024];
+    glGetShaderInfoLog( shader, sizeof(log), 0, log );
+    cout << "FaceProgram compile: " << log << "\n";
+    glDeleteShader( shader );
+    return 0;
+  }
+  return shader;
+}
+
+void FaceProgram::begin()
+{
+  glUseProgram( program );
+  glUniform1i( foggedLoc, glIsEnabled(GL_FOG) );
+  glEnableVertexAttribArray( FACE );
+  glVertexAttribDivisorARB( FACE, 1 );
+}
+
+void FaceProgram::setOrigin( float x, float y, float z )
+{
+  glUniform3f( originLoc, x, y, z );
+}
+
+void FaceProgram::end()
+{
+  glVertexAttribDivisorARB( FACE, 0 );
+  glDisableVertexAttribArray( FACE );
+  glBindBuffer( GL_ARRAY_BUFFER, 0 );
+  glUseProgram( 0 );
+}
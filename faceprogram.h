@@ -0,0 +1,33 @@
+// made by inny
+
+#ifndef OPENMINE_FACEPROGRAM_H
+#define OPENMINE_FACEPROGRAM_H
+
+#include "opengl.h"
+
+// Expands packed face records (see Voxel::pack) into quads on the GPU.
+// Each record is one instance, gl_VertexID picks the corner.
+class FaceProgram
+{
+  public:
+    static const GLuint FACE = 1;
+
+  protected:
+    GLuint program;
+    GLint originLoc;
+    GLint foggedLoc;
+    bool valid;
+
+    static GLuint compile( GLenum type, const char *source );
+
+  public:
+    FaceProgram();
+    virtual ~FaceProgram();
+    bool isValid() const { return valid; };
+
+    void begin();
+    void setOrigin( float x, float y, float z );
+    void end();
+};
+
+#endif
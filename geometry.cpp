@@ -0,0 +1,49 @@
+// made by inny
+
+#include "opengl.h"
+#include "geometry.h"
+
+using namespace std;
+
+void Face::glTexturedDraw()
+{
+  float xl = t.x / 256.0;
+  float xr = (t.x+15.99) / 256.0;
+  float yu = t.y / 256.0;
+  float yd = (t.y+15.99) / 256.0;
+
+  glTexCoord2f(xl, yu);
+  glVertex3fv(v[0].v);
+  glTexCoord2f(xr, yu);
+  glVertex3fv(v[1].v);
+  glTexCoord2f(xr, yd);
+  glVertex3fv(v[2].v);
+  glTexCoord2f(xl, yd);
+  glVertex3fv(v[3].v);
+}
+
+void Face::glUntexturedDraw()
+{
+  glVertex3fv(v[0].v);
+  glVertex3fv(v[1].v);
+  glVertex3fv(v[2].v);
+  glVertex3fv(v[3].v);
+}
+
+// same quad as glTexturedDraw, laid out as GL_T2F_V3F
+void Face::appendInterleaved( vector<float> &buffer ) const
+{
+  const float xl = t.x / 256.0;
+  const float xr = (t.x+15.99) / 256.0;
+  const float yu = t.y / 256.0;
+  const float yd = (t.y+15.99) / 256.0;
+  const float tc[4][2] = { {xl, yu}, {xr, yu}, {xr, yd}, {xl, yd} };
+
+  for ( int i = 0; i < 4; i++ ) {
+    buffer.push_back( tc[i][0] );
+    buffer.push_back( tc[i][1] );
+    buffer.push_back( v[i].x() );
+    buffer.push_back( v[i].y() );
+    buffer.push_back( v[i].z() );
+  }
+}
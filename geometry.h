@@ -0,0 +1,37 @@
+// made by inny
+
+#ifndef OPENMINE_GEOMETRY_H
+#define OPENMINE_GEOMETRY_H
+
+#include <vector>
+
+struct Point
+{
+  float x, y;
+  Point( float xx=0.0, float yy=0.0 ) : x(xx), y(yy) { /**/ };
+};
+
+struct Vertex
+{
+  float v[3];
+  Vertex( float x=0.0, float y=0.0, float z=0.0 ) { v[0]=x; v[1]=y; v[2]=z; };
+  float x() const { return v[0]; };
+  float y() const { return v[1]; };
+  float z() const { return v[2]; };
+};
+
+struct Face
+{
+  Vertex v[4];
+  Point t;
+
+  Face( const Vertex &va, const Vertex &vb, const Vertex &vc, const Vertex &vd,
+        const Point &tx = Point() )
+  { v[0]=va; v[1]=vb; v[2]=vc; v[3]=vd; t=tx; };
+
+  void glTexturedDraw();
+  void glUntexturedDraw();
+  void appendInterleaved( std::vector<float> &buffer ) const;
+};
+
+#endif
@@ -0,0 +1,202 @@
+// made by inny
+
+// openmine_loadgen: connects a crowd of fake players to openmine_server,
+// walks them around, makes the odd edit, and reports what it cost.
+
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include "util.h"
+#include "world.h"
+#include "net.h"
+
+using namespace std;
+
+struct Bot
+{
+  Connection *conn;
+  float x, y, z;
+  float heading;
+
+  int chunks;
+  int deltas;
+  int unloads;
+  int badChunks;
+
+  Bot( int socket )
+    : conn( new Connection(socket) ), heading(0), chunks(0), deltas(0),
+      unloads(0), badChunks(0)
+  {
+    x = rand() % World::XBLOCKS;
+    y = World::GROUND * 0.5f + rand() % (World::GROUND / 4);
+    z = rand() % World::ZBLOCKS;
+    heading = (rand() % 628) / 100.0f;
+  };
+
+  ~Bot() { delete conn; };
+
+  // wander at walking pace, turning back at the edge of the world
+  void move( float dt )
+  {
+    heading += ((rand() % 200) - 100) / 400.0f;
+    x += cos( heading ) * 4.3f * dt;
+    z += sin( heading ) * 4.3f * dt;
+    if ( x < 0 || x >= World::XBLOCKS || z < 0 || z >= World::ZBLOCKS ) {
+      heading += M_PI;
+      x = bound( 0, x, World::XBLOCKS - 1 );
+      z = bound( 0, z, World::ZBLOCKS - 1 );
+    }
+  };
+};
+
+struct ServerStats
+{
+  float avgTick;
+  float worstTick;
+  int clients;
+  int reports;
+
+  ServerStats() : avgTick(0), worstTick(0), clients(0), reports(0) { /* */ };
+};
+
+static void readBot( Bot &bot, ServerStats &stats )
+{
+  static unsigned short types[Chunk::VOLUME];
+
+  bot.conn->receive();
+
+  int type;
+  const unsigned char *data;
+  size_t length;
+  while ( bot.conn->nextMessage( type, data, length ) ) {
+    MessageReader in( data, length );
+    if ( type == MSG_CHUNK ) {
+      in.getI32(); in.getI32(); in.getI32();
+      if ( rleDecode( in, types, Chunk::VOLUME ) ) bot.chunks++;
+      else bot.badChunks++;
+    }
+    else if ( type == MSG_DELTA ) {
+      bot.deltas++;
+    }
+    else if ( type == MSG_UNLOAD ) {
+      bot.unloads++;
+    }
+    else if ( type == MSG_STATS ) {
+      float avg = in.getF32(), worst = in.getF32();
+      int clients = in.getU32();
+      if ( !in.ok() ) continue;
+      stats.avgTick += avg;
+      stats.worstTick = max( stats.worstTick, worst );
+      stats.clients = clients;
+      stats.reports++;
+    }
+  }
+}
+
+int main( int argc, char **argv )
+{
+  string host = "127.0.0.1";
+  int port = DEFAULT_PORT;
+  int count = 200;
+  double duration = 10.0;
+  float editRate = 0.2;
+
+  for ( int i = 1; i+1 < argc; i++ ) {
+    const string arg = argv[i];
+    if ( arg == "--host" ) host = argv[++i];
+    else if ( arg == "--port" ) port = atoi( argv[++i] );
+    else if ( arg == "--clients" ) count = atoi( argv[++i] );
+    else if ( arg == "--seconds" ) duration = atof( argv[++i] );
+    else if ( arg == "--edits" ) editRate = atof( argv[++i] );
+  }
+
+  signal( SIGPIPE, SIG_IGN );
+  srand( 1 );
+
+  vector<Bot*> bots;
+  for ( int i = 0; i < count; i++ ) {
+    int fd = connectTcp( host, port );
+    if ( fd < 0 ) {
+      cout << "connect failed after " << i << " clients\n";
+      break;
+    }
+    bots.push_back( new Bot(fd) );
+  }
+  if ( bots.empty() ) return 1;
+
+  const int TICKS = 20;
+  const float dt = 1.0f / TICKS;
+  const double begin = seconds();
+  double nextTick = begin;
+  ServerStats stats;
+  vector<pollfd> fds( bots.size() );
+
+  while ( seconds() - begin < duration ) {
+    const double now = seconds();
+    if ( now >= nextTick ) {
+      nextTick += dt;
+      for ( int i = 0; i < bots.size(); i++ ) {
+        Bot &bot = *bots[i];
+        bot.move( dt );
+
+        MessageWriter pos( bot.conn->output(), MSG_POSITION );
+        pos.putF32( bot.x );
+        pos.putF32( bot.y );
+        pos.putF32( bot.z );
+        pos.finish();
+
+        if ( (rand() % 10000) < int(editRate * dt * 10000) ) {
+          MessageWriter edit( bot.conn->output(), MSG_EDIT );
+          edit.putI32( int(bot.x) + rand() % 5 - 2 );
+          edit.putI32( int(bot.y) - 1 - rand() % 3 );
+          edit.putI32( int(bot.z) + rand() % 5 - 2 );
+          edit.putU16( rand() % 2 );
+          edit.finish();
+        }
+        bot.conn->flush();
+      }
+    }
+
+    for ( int i = 0; i < bots.size(); i++ ) {
+      fds[i].fd = bots[i]->conn->socket();
+      fds[i].events = POLLIN;
+    }
+    const int wait = max( 0, int( (nextTick - seconds()) * 1000.0 ) );
+    poll( &fds[0], fds.size(), wait );
+
+    for ( int i = 0; i < bots.size(); i++ )
+      if ( fds[i].revents ) readBot( *bots[i], stats );
+  }
+
+  const double elapsed = seconds() - begin;
+  uint64_t bytesIn = 0, bytesOut = 0;
+  int chunks = 0, deltas = 0, unloads = 0, bad = 0, dropped = 0;
+  for ( int i = 0; i < bots.size(); i++ ) {
+    bytesIn += bots[i]->conn->bytesIn;
+    bytesOut += bots[i]->conn->bytesOut;
+    chunks += bots[i]->chunks;
+    deltas += bots[i]->deltas;
+    unloads += bots[i]->unloads;
+    bad += bots[i]->badChunks;
+    if ( bots[i]->conn->isClosed() ) dropped++;
+  }
+
+  const double perClient = double(bytesIn) / bots.size() / elapsed;
+  cout << "clients: " << bots.size() << " dropped: " << dropped
+       << " seconds: " << elapsed << "\n"
+       << "server avg tick ms: " << (stats.reports ? stats.avgTick / stats.reports : 0.0)
+       << " worst tick ms: " << stats.worstTick << "\n"
+       << "down bytes/client/s: " << perClient
+       << " up bytes/client/s: " << double(bytesOut) / bots.size() / elapsed << "\n"
+       << "chunks/client: " << double(chunks) / bots.size()
+       << " deltas/client: " << double(deltas) / bots.size()
+       << " unloads/client: " << double(unloads) / bots.size()
+       << " bad chunks: " << bad << "\n";
+
+  for ( int i = 0; i < bots.size(); i++ ) delete bots[i];
+  return 0;
+}
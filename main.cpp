@@ -1,308 +1,44 @@
 // made by inny
 
+#include <atomic>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
-#include <list>
+#include <thread>
 #include <vector>
-#include <map>
+#include "opengl.h"
 #include "SDL.h"
-#include "SDL_opengl.h"
 #include "SDL_image.h"
 #include "SDL_ttf.h"
+#include "util.h"
+#include "camera.h"
+#include "geometry.h"
+#include "world.h"
+#include "entities.h"
+#include "blocksim.h"
+#include "bulkedit.h"
+#include "pathfind.h"
+#include "workers.h"
+#include "worldgen.h"
+#include "meshcache.h"
+#include "memstats.h"
+#include "viewcontrol.h"
+#include "renderqueue.h"
+#include "offscreen.h"
+#include "particles.h"
 
 using namespace std;
 
-float bound( float min, float val, float max )
-{
-  if ( min > val ) return min;
-  if ( max < val ) return max;
-  return val;
-}
-
-// -----------------------------------------------------------------------------
-
-class Camera
-{
-  protected:
-    float xpos;
-    float ypos;
-    float zpos;
-    float xrot;
-    float yrot;
-
-    float viewDist;
-    bool fogged;
-
-    float frustum[6][4];
-
-    bool updated;
-
-  public:
-    Camera( float x=0.0, float y=0.0, float z=0.0, float xr=0.0, float yr=0.0 );
-    void teleport( float x, float y, float z );
-
-    float x() const { return xpos; };
-    float y() const { return ypos; };
-    float z() const { return zpos; };
-
-    void walk( float amount );
-    void strafe( float amount );
-    void turn( float amount );
-    void look( float amount );
-    void ascend( float amount );
-
-    void set3DPerspective( float fovy, float aspect );
-    void adjustGL();
-
-    void readyFrustum();
-    bool frustumContainsPoint( float x, float y, float z );
-    bool frustumContainsSphere( float x, float y, float z, float radius );
-    bool frustumContainsCube( float x, float y, float z, float xs, float ys, float zs );
-
-    void setViewDistance( float d ) { viewDist = d; };
-    float viewDistance() const { return viewDist; };
-
-    void setFog( bool enabled );
-    bool fogEnabled() const { return fogged; };
-};
-
-Camera::Camera( float x, float y, float z, float xr, float yr )
-  : xpos(x), ypos(y), zpos(z), xrot(xr), yrot(yr), viewDist(80.0),
-    fogged(false), updated(true)
-{
-  /* */
-}
-
-void Camera::teleport( float x, float y, float z )
-{
-  updated = true;
-  xpos = x;
-  ypos = y;
-  zpos = z;
-}
-
-void Camera::walk( float amount )
-{
-  updated = true;
-  float yrotrad = yrot / 180.0 * M_PI;
-  xpos += amount * float(sin(yrotrad)) ;
-  zpos -= amount * float(cos(yrotrad)) ;
-}
-
-void Camera::ascend( float amount )
-{
-  updated = true;
-  ypos += amount;
-}
-
-void Camera::strafe( float amount )
-{
-  updated = true;
-  float rot = yrot + 90.0f;
-  while (rot > 360.0f) rot -= 360.0f;
-
-  float yrotrad = rot / 180.0 * M_PI;
-  xpos += amount * float(sin(yrotrad)) ;
-  zpos -= amount * float(cos(yrotrad)) ;
-}
-
-void Camera::turn( float amount )
-{
-  updated = true;
-  yrot += amount;
-  while ( yrot < -360.0f ) yrot += 360.0f;
-  while ( yrot >  360.0f ) yrot -= 360.0f;
-}
-
-void Camera::look( float amount )
-{
-  updated = true;
-  xrot += amount;
-
-  if ( xrot > 90.0f ) xrot = 90.0f;
-  if ( xrot < -90.0f ) xrot = -90.0f;
-}
-
-void Camera::set3DPerspective( float fovy, float aspect )
-{
-  const float zmin = 0.25;
-  const float zmax = viewDist;
-
-  GLfloat xmin, xmax, ymin, ymax;
-  ymax = zmin * tan(fovy * M_PI / 360.0);
-  ymin = -ymax;
-  xmin = ymin * aspect;
-  xmax = ymax * aspect;
-
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glFrustum(xmin, xmax, ymin, ymax, zmin, zmax);
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
-}
-
-void Camera::setFog( bool enabled )
-{
-  fogged = enabled;
-
-  if (!enabled) {
-    glDisable(GL_FOG);
-    return;
-  }
-
-  const float farFog = viewDistance() * ( 72.0 / 80.0 );
-  const float nearFog = farFog * ( 56.0 / 72.0 );
-
-  GLfloat fogColor[4]= {0.75f, 0.75f, 0.75f, 1.0f};
-  glEnable(GL_FOG);
-  glFogfv(GL_FOG_COLOR, fogColor);
-  glFogi(GL_FOG_MODE, GL_LINEAR);
-  glFogf(GL_FOG_START, nearFog);
-  glFogf(GL_FOG_END, farFog);
-  glHint(GL_FOG_HINT, GL_DONT_CARE);  
-}
-
-void Camera::adjustGL()
-{
-  // Should be on the MODELVIEW Matrix
-  glRotatef( xrot, 1.0, 0.0, 0.0 );
-  glRotatef( yrot, 0.0, 1.0, 0.0 );
-  glTranslated( -xpos, -ypos, -zpos );
-}
-
-void Camera::readyFrustum()
-{
-  if (!updated) return;
-  updated = false;
-
-  // thanks mark morley
-  // http://www.crownandcutlass.com/features/technicaldetails/frustum.html
-
-  float   proj[16];
-  float   modl[16];
-  float   clip[16];
-
-  /* Get the current PROJECTION matrix from OpenGL */
-  glGetFloatv( GL_PROJECTION_MATRIX, proj );
-
-  /* Get the current MODELVIEW matrix from OpenGL */
-  glGetFloatv( GL_MODELVIEW_MATRIX, modl );
-
-  // Combine the two matrices (multiply projection by modelview)
-  // Assumes no rotation on the Projection Matrix.
-  clip[ 0] = modl[ 0] * proj[ 0];
-  clip[ 1] = modl[ 1] * proj[ 5];
-  clip[ 2] = modl[ 2] * proj[10] + modl[ 3] * proj[14];
-  clip[ 3] = modl[ 2] * proj[11];
-
-  clip[ 4] = modl[ 4] * proj[ 0];
-  clip[ 5] = modl[ 5] * proj[ 5];
-  clip[ 6] = modl[ 6] * proj[10] + modl[ 7] * proj[14];
-  clip[ 7] = modl[ 6] * proj[11];
-
-  clip[ 8] = modl[ 8] * proj[ 0];
-  clip[ 9] = modl[ 9] * proj[ 5];
-  clip[10] = modl[10] * proj[10] + modl[11] * proj[14];
-  clip[11] = modl[10] * proj[11];
-
-  clip[12] = modl[12] * proj[ 0];
-  clip[13] = modl[13] * proj[ 5];
-  clip[14] = modl[14] * proj[10] + modl[15] * proj[14];
-  clip[15] = modl[14] * proj[11];
-
-  /* Extract the numbers for the RIGHT plane */
-  frustum[0][0] = clip[ 3] - clip[ 0];
-  frustum[0][1] = clip[ 7] - clip[ 4];
-  frustum[0][2] = clip[11] - clip[ 8];
-  frustum[0][3] = clip[15] - clip[12];
-
-  /* Extract the numbers for the LEFT plane */
-  frustum[1][0] = clip[ 3] + clip[ 0];
-  frustum[1][1] = clip[ 7] + clip[ 4];
-  frustum[1][2] = clip[11] + clip[ 8];
-  frustum[1][3] = clip[15] + clip[12];
-
-  /* Extract the BOTTOM plane */
-  frustum[2][0] = clip[ 3] + clip[ 1];
-  frustum[2][1] = clip[ 7] + clip[ 5];
-  frustum[2][2] = clip[11] + clip[ 9];
-  frustum[2][3] = clip[15] + clip[13];
-
-  /* Extract the TOP plane */
-  frustum[3][0] = clip[ 3] - clip[ 1];
-  frustum[3][1] = clip[ 7] - clip[ 5];
-  frustum[3][2] = clip[11] - clip[ 9];
-  frustum[3][3] = clip[15] - clip[13];
-
-  /* Extract the FAR plane */
-  frustum[4][0] = clip[ 3] - clip[ 2];
-  frustum[4][1] = clip[ 7] - clip[ 6];
-  frustum[4][2] = clip[11] - clip[10];
-  frustum[4][3] = clip[15] - clip[14];
-
-  /* Extract the NEAR plane */
-  frustum[5][0] = clip[ 3] + clip[ 2];
-  frustum[5][1] = clip[ 7] + clip[ 6];
-  frustum[5][2] = clip[11] + clip[10];
-  frustum[5][3] = clip[15] + clip[14];
-
-  /* Normalize the results */
-  for ( int i = 0; i<6; i++ ) {
-    float t = sqrt( frustum[i][0]*frustum[i][0] + frustum[i][1]*frustum[i][1] + frustum[i][2]*frustum[i][2] );
-    frustum[i][0] /= t;
-    frustum[i][1] /= t;
-    frustum[i][2] /= t;
-    frustum[i][3] /= t;
-  }
-}
-
-bool Camera::frustumContainsPoint( float x, float y, float z )
-{
-  for ( int p = 0; p < 6; p++ )
-    if( frustum[p][0]*x + frustum[p][1]*y + frustum[p][2]*z + frustum[p][3] <= 0 )
-      return false;
-
-  return true;
-}
-
-bool Camera::frustumContainsSphere( float x, float y, float z, float radius )
-{
-  for( int p = 0; p < 6; p++ )
-    if( (frustum[p][0]*x + frustum[p][1]*y + frustum[p][2]*z + frustum[p][3]) <= -radius )
-      return false;
-
-  return true;
-}
-
-bool Camera::frustumContainsCube( float x, float y, float z, float xs, float ys, float zs )
-{
-  for ( int p = 5; p < 6; p++ ) {
-    if ((frustum[p][0] *  x + frustum[p][1] *  y + frustum[p][2] *  z + frustum[p][3] > 0) ||
-        (frustum[p][0] * xs + frustum[p][1] *  y + frustum[p][2] *  z + frustum[p][3] > 0) ||
-        (frustum[p][0] *  x + frustum[p][1] * ys + frustum[p][2] *  z + frustum[p][3] > 0) ||
-        (frustum[p][0] * xs + frustum[p][1] * ys + frustum[p][2] *  z + frustum[p][3] > 0) ||
-        (frustum[p][0] *  x + frustum[p][1] *  y + frustum[p][2] * zs + frustum[p][3] > 0) ||
-        (frustum[p][0] * xs + frustum[p][1] *  y + frustum[p][2] * zs + frustum[p][3] > 0) ||
-        (frustum[p][0] *  x + frustum[p][1] * ys + frustum[p][2] * zs + frustum[p][3] > 0) ||
-        (frustum[p][0] * xs + frustum[p][1] * ys + frustum[p][2] * zs + frustum[p][3] > 0))
-      continue;
-    else
-      return false;
-  }
-
-  return true;
-}
-
-// -----------------------------------------------------------------------------
-
 struct Texture
 {
   GLuint t;
   bool valid;
   Texture( const string &filename );
-  void bind();
 };
 
 Texture::Texture( const string &filename )
@@ -311,7 +47,17 @@ Texture::Texture( const string &filename )
   SDL_Surface *image = IMG_Load( filename.c_str() ); 
   if (!image) return;
 
-  SDL_Surface* display = SDL_DisplayFormatAlpha(image);
+  SDL_Surface* display = 0;
+  if ( SDL_GetVideoSurface() ) {
+    display = SDL_DisplayFormatAlpha(image);
+  }
+  else {
+    // no video mode when rendering offscreen, so convert by hand
+    display = SDL_CreateRGBSurface( SDL_SWSURFACE, image->w, image->h, 32,
+                                    0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 );
+    SDL_SetAlpha( image, 0, 0 );
+    SDL_BlitSurface( image, 0, display, 0 );
+  }
 
   glGenTextures( 1, &t );
   glBindTexture( GL_TEXTURE_2D, t );
@@ -335,13 +81,6 @@ Texture::Texture( const string &filename )
   valid = true;
 }
 
-void Texture::bind()
-{
-  glEnable(GL_TEXTURE_2D);
-  glBindTexture( GL_TEXTURE_2D, t );
-  glColor3f(1.0, 1.0, 1.0);
-}
-
 // -----------------------------------------------------------------------------
 
 class TextPainter
@@ -410,575 +149,28 @@ void TextPainter::readyText( const GLubyte R, const GLubyte G, const GLubyte B,
     : GL_BGRA;
 
   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP );
-  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
- 
-  glTexImage2D(GL_TEXTURE_2D, 0, 4, display->w, display->h, 0, textureFormat, GL_UNSIGNED_BYTE, display->pixels);
-
-  SDL_FreeSurface(display);
-  SDL_FreeSurface(message);
-}
-
-void TextPainter::draw( const float x, const float y, const float z )
-{
-  glEnable(GL_TEXTURE_2D);
-  glColor3f(1.0, 1.0, 1.0);
-  glBindTexture(GL_TEXTURE_2D, t);
-  glBegin(GL_QUADS);
-    glTexCoord2d(0, 0); glVertex3d(x,   y,   z);
-    glTexCoord2d(1, 0); glVertex3d(x+w, y,   z);
-    glTexCoord2d(1, 1); glVertex3d(x+w, y+h, z);
-    glTexCoord2d(0, 1); glVertex3d(x,   y+h, z);
-  glEnd();
-}
-
-// -----------------------------------------------------------------------------
-
-struct Point
-{
-  float x, y;
-  Point( float xx=0.0, float yy=0.0 ) : x(xx), y(yy) { /**/ };
-};
-
-struct Vertex
-{
-  float v[3];
-  Vertex( float x=0.0, float y=0.0, float z=0.0 ) { v[0]=x; v[1]=y; v[2]=z; };
-  float x() const { return v[0]; };
-  float y() const { return v[1]; };
-  float z() const { return v[2]; };
-};
-
-struct Face
-{
-  Vertex v[4];
-  Point t;
-
-  Face( const Vertex &va, const Vertex &vb, const Vertex &vc, const Vertex &vd,
-        const Point &tx = Point() )
-  { v[0]=va; v[1]=vb; v[2]=vc; v[3]=vd; t=tx; };
-
-  void glTexturedDraw();
-  void glUntexturedDraw();
-};
-
-void Face::glTexturedDraw()
-{
-  float xl = t.x / 256.0;
-  float xr = (t.x+15.99) / 256.0;
-  float yu = t.y / 256.0;
-  float yd = (t.y+15.99) / 256.0;
-
-  glTexCoord2f(xl, yu);
-  glVertex3fv(v[0].v);
-  glTexCoord2f(xr, yu);
-  glVertex3fv(v[1].v);
-  glTexCoord2f(xr, yd);
-  glVertex3fv(v[2].v);
-  glTexCoord2f(xl, yd);
-  glVertex3fv(v[3].v);
-}
-
-void Face::glUntexturedDraw()
-{
-  glVertex3fv(v[0].v);
-  glVertex3fv(v[1].v);
-  glVertex3fv(v[2].v);
-  glVertex3fv(v[3].v);
-}
-
-// -----------------------------------------------------------------------------
-
-struct Voxel
-{
-  unsigned short type;
-  unsigned char visible;
-
-  public:
-    static const float SIZE = 1.0f;
-
-    Voxel(int t=0): type(t), visible(255) { /* */ }
-    void draw( vector<Face> &drawList, float x, float y, float z, float s );
-    void cull( Voxel *vox[6] );
-
-    static Voxel shared;
-    bool isShared() const { return this == &shared; };
-
-    bool isTransparent() const { return type==0; };
-    bool isVisible(int x) const { return (visible&(1<<x)); };
-
-  protected:
-    void tagVisible(int x) { visible |= (1<<x); };
-    void clearVisible(int x) { visible &= ~(1<<x); };
-    void setVisible(int x, bool t) { if (isShared()) return; if (t) tagVisible(x); else clearVisible(x); };
-}
-__attribute__((__packed__));
-
-Voxel Voxel::shared;
-
-void Voxel::draw( vector<Face> &drawList, float x, float y, float z, float s )
-{
-  if (visible == 0) return;
-
-  Vertex va( x,   y,   z );
-  Vertex vb( x,   y,   z+s );
-  Vertex vc( x,   y+s, z );
-  Vertex vd( x,   y+s, z+s );
-  Vertex ve( x+s, y,   z );
-  Vertex vf( x+s, y,   z+s );
-  Vertex vg( x+s, y+s, z );
-  Vertex vh( x+s, y+s, z+s );
-
-  Point top( 0.0, 0.0 );
-  Point side( 0.0, 16.0 );
-  Point bottom( 0.0, 24.0 );
-
-  if (isVisible(0)) drawList.push_back( Face( vc, vd, vh, vg, top ) );
-  if (isVisible(1)) drawList.push_back( Face( va, ve, vf, vb, bottom ) );
-  if (isVisible(2)) drawList.push_back( Face( vh, vd, vb, vf, side ) );
-  if (isVisible(3)) drawList.push_back( Face( vc, vg, ve, va, side ) );
-  if (isVisible(4)) drawList.push_back( Face( vg, vh, vf, ve, side ) );
-  if (isVisible(5)) drawList.push_back( Face( vd, vc, va, vb, side ) );
-}
-
-void Voxel::cull( Voxel *vox[6] )
-{
-  for ( int i=0; i<6; i++ ) {
-    setVisible( i, vox[i]->isTransparent() );
-  }
-
-#if 0
-  vox[0]->setVisible( 1, isTransparent() );
-  vox[1]->setVisible( 0, isTransparent() );
-  vox[2]->setVisible( 3, isTransparent() );
-  vox[3]->setVisible( 2, isTransparent() );
-  vox[4]->setVisible( 5, isTransparent() );
-  vox[5]->setVisible( 4, isTransparent() );
-#endif
-}
-
-// -----------------------------------------------------------------------------
-
-class World;
-
-class Chunk
-{
-  public:
-    static const int XSIZE = 16;
-    static const int YSIZE = 16;
-    static const int ZSIZE = 16;
-    static const float RADIUS = 16.0 * 0.866025404f;
-
-  protected:
-    World *world;
-    float xpos;
-    float ypos;
-    float zpos;
-
-    Voxel data[ZSIZE][YSIZE][XSIZE];
-
-    bool generated;
-    GLuint index;
-    int drawn;
-
-    void generateDisplayList();
-    void drawChunkCube();
-
-  public:
-    Chunk( World *w, float x=0.0, float y=0.0, float z=0.0 );
-    virtual ~Chunk();
-    void randomize();
-    void cullFaces();
-
-    void draw( Camera &camera, int drawCount );
-    Voxel &voxel( int x, int y, int z );
-    int lastDrawn() const { return drawn; };
-
-    static bool visibleToCamera( Camera &camera, float xpos, float ypos, float zpos );
-};
-
-// -----------------------------------------------------------------------------
-
-class World
-{
-  public:
-    static const int XSIZE = 5;
-    static const int YSIZE = 5;
-    static const int ZSIZE = 5;
-
-  protected:
-    typedef map<unsigned int, Chunk*> ChunkMap;
-    ChunkMap chunkMap;
-
-    list<Vertex> chunkLoadList;
-    int chunksLoaded;
-    bool messageDrop;
-    int drawCount;
-
-    static int hash( float x, float y, float z, bool &valid );
-    Chunk *getChunk( float x, float y, float z );
-    bool addChunk( Chunk *c, float x, float y, float z );
-    Chunk *removeChunk( float x, float y, float z );
-    void clearChunks();
-    static bool fitsBounds( float x, float y, float z );
-
-  public:
-    World();
-    virtual ~World();
-
-    void draw( Camera &camera, Texture &texture );
-    void update( float dt );
-
-    Voxel &voxel( int x, int y, int z );
-    void dropMessage() { messageDrop = true; };
-};
-
-// -----------------------------------------------------------------------------
-
-Chunk::Chunk( World *w, float x, float y, float z )
-  : world(w), xpos(x), ypos(y), zpos(z), generated( false ), drawn(0)
-{
-  /* */
-}
-
-Chunk::~Chunk()
-{
-  if (generated) glDeleteLists(index, 1);
-}
-
-void Chunk::randomize()
-{
-  float xc = 0.5 * float(World::XSIZE * Chunk::XSIZE);
-  float yc = 0.5 * float(World::YSIZE * Chunk::YSIZE);
-  float zc = 0.5 * float(World::ZSIZE * Chunk::ZSIZE);
-  for ( int z = 0; z < Chunk::ZSIZE; z ++ ) {
-    for ( int y = 0; y < Chunk::YSIZE; y ++ ) {
-      for ( int x = 0; x < Chunk::XSIZE; x ++ ) {
-        float xp = xpos + float(x) + 0.5*Voxel::SIZE;
-        float yp = ypos + float(y) + 0.5*Voxel::SIZE;
-        float zp = zpos + float(z) + 0.5*Voxel::SIZE;
-
-        float vect = sqrt( xc*xc + yc*yc + zc*zc );
-        float dist = sqrt( (xp-xc)*(xp-xc) + (yp-yc)*(yp-yc) + (zp-zc)*(zp-zc) );
-
-        float chance = 1.0;
-
-        if ( (abs(yp-(yc/2)) < 5.0) && ((abs(xp-xc) < 5.0) ||(abs(zp-zc) < 5.0)) )
-          chance = 0.001;
-
-        else if (yp > yc)
-          chance = (yp < (sin((xp)/90.0*M_PI)*yc*2)) ? 1.0 : 0.001;
-
-        data[z][y][x].type = ( rand() % 1000 < int(chance*1000.0) );
-      }
-    }
-  }
-
-#if 0
-  for ( int z = 0; z < 2; z++ )
-    for ( int y = 0; y < 2; y++ )
-      for ( int x = 0; x < 2; x++ )
-        data[z*(Chunk::ZSIZE-1)][y*(Chunk::YSIZE-1)][x*(Chunk::XSIZE-1)]=1;
-#endif
-}
-
-void Chunk::cullFaces()
-{
-  if (generated) {
-    glDeleteLists(index, 1);
-    generated = false;
-  }
-
-  for ( int z = 0; z < Chunk::ZSIZE; z++ ) {
-    for ( int y = 0; y < Chunk::YSIZE; y++ ) {
-      for ( int x = 0; x < Chunk::XSIZE; x++ ) {
-        Voxel &vox = voxel(x, y, z);
-        Voxel *voxes[6];
-        voxes[0] = &voxel(x,   y+1, z  );
-        voxes[1] = &voxel(x,   y-1, z  );
-        voxes[2] = &voxel(x,   y,   z+1);
-        voxes[3] = &voxel(x,   y,   z-1);
-        voxes[4] = &voxel(x+1, y,   z  );
-        voxes[5] = &voxel(x-1, y,   z  );
-        vox.cull( voxes );
-      }
-    }
-  }
-}
-
-Voxel &Chunk::voxel( int x, int y, int z )
-{
-  if ( x < 0 || x >= Chunk::XSIZE ||
-       y < 0 || y >= Chunk::YSIZE ||
-       z < 0 || z >= Chunk::ZSIZE ) {
-    return world->voxel( int(xpos)+x, int(ypos)+y, int(zpos)+z );
-  }
-
-  return data[z][y][x];
-}
-
-void Chunk::drawChunkCube()
-{
-  const float xs = Chunk::XSIZE;
-  const float ys = Chunk::YSIZE;
-  const float zs = Chunk::ZSIZE;
-
-  Vertex va( xpos,    ypos,    zpos );
-  Vertex vb( xpos,    ypos,    zpos+zs );
-  Vertex vc( xpos,    ypos+ys, zpos );
-  Vertex vd( xpos,    ypos+ys, zpos+zs );
-  Vertex ve( xpos+xs, ypos,    zpos );
-  Vertex vf( xpos+xs, ypos,    zpos+zs );
-  Vertex vg( xpos+xs, ypos+ys, zpos );
-  Vertex vh( xpos+xs, ypos+ys, zpos+zs );
-
-  Face tp( vc, vd, vh, vg );
-  Face bt( va, ve, vf, vb );
-  Face sd1( vh, vd, vb, vf );
-  Face sd2( vc, vg, ve, va );
-  Face sd3( vg, vh, vf, ve );
-  Face sd4( vd, vc, va, vb );
-
-  glBegin(GL_QUADS);
-  glColor3f(1.0, 1.0, 1.0);
-  tp.glUntexturedDraw();
-  bt.glUntexturedDraw();
-  sd1.glUntexturedDraw();
-  sd2.glUntexturedDraw();
-  sd3.glUntexturedDraw();
-  sd4.glUntexturedDraw();
-  glEnd();
-}
-
-bool Chunk::visibleToCamera( Camera &camera, float xpos, float ypos, float zpos )
-{
-  return camera.frustumContainsSphere(xpos+(Chunk::XSIZE/2),
-                                      ypos+(Chunk::YSIZE/2),
-                                      zpos+(Chunk::ZSIZE/2),
-                                      Chunk::RADIUS);
-}
-
-void Chunk::draw( Camera &camera, int drawCount )
-{
-  if (drawCount == drawn) return;
-  drawn = drawCount;
-
-  if (!generated) generateDisplayList();
-  glCallList(index);
-}
-
-void Chunk::generateDisplayList()
-{
-  generated = true;
-  index = glGenLists(1);
-
-  vector<Face> faceList;
-  for ( int z = 0; z < Chunk::ZSIZE; z ++ ) {
-    for ( int y = 0; y < Chunk::YSIZE; y ++ ) {
-      for ( int x = 0; x < Chunk::XSIZE; x ++ ) {
-        if ( data[z][y][x].type > 0 ) {
-          data[z][y][x].draw( faceList, float(xpos+x), float(ypos+y), float(zpos+z), Voxel::SIZE );
-        }
-      }
-    }
-  }
-
-  glNewList(index, GL_COMPILE);
-  glBegin(GL_QUADS);
-    for ( int i = 0; i < faceList.size(); i++ ) faceList[i].glTexturedDraw();
-  glEnd();
-  glEndList();
-}
-
-// -----------------------------------------------------------------------------
-
-World::World()
-  : chunksLoaded(0), messageDrop(false), drawCount(0)
-{
-  /* */
-}
-
-World::~World()
-{
-  clearChunks();
-}
-
-
-bool World::fitsBounds( float x, float y, float z )
-{
-  return ( x >= 0.0 && (x < World::XSIZE*Chunk::XSIZE) &&
-           y >= 0.0 && (y < World::YSIZE*Chunk::YSIZE) &&
-           z >= 0.0 && (z < World::ZSIZE*Chunk::ZSIZE) );
-}
-
-int World::hash( float x, float y, float z, bool &valid )
-{
-  x = floor(x/Chunk::XSIZE);
-  y = floor(y/Chunk::YSIZE);
-  z = floor(z/Chunk::ZSIZE);
-
-  if ( x < -8100.0 || x >= 8100.0 || z < -8100.0 || z >= 8100.0 ||
-       y < 0.0 || y >= 8.0 ) {
-    valid = false;
-    return 0;
-  }
-
-  const unsigned int xi = int(x)+8100;
-  const unsigned int yi = int(y);
-  const unsigned int zi = int(z)+8100;
-  const unsigned int id = (yi << 28) | (zi << 14) | xi;
-  valid = true;
-  return id;
-}
-
-Chunk *World::getChunk( float x, float y, float z )
-{
-  bool valid = false;
-  const unsigned int id = hash( x, y, z, valid );
-  if (!valid) return 0;
-
-  ChunkMap::iterator finder = chunkMap.find(id);
-  if ( finder == chunkMap.end() ) return 0;
-
-  return finder->second;
-}
-
-bool World::addChunk( Chunk *c, float x, float y, float z )
-{
-  bool valid = false;
-  const unsigned int id = hash( x, y, z, valid );
-  if (!valid) return false;
-  chunkMap[id] = c;
-  return true;
-}
-
-Chunk *World::removeChunk( float x, float y, float z )
-{
-  bool valid = false;
-  const unsigned int id = hash( x, y, z, valid );
-  if (!valid) return 0;
-
-  ChunkMap::iterator finder = chunkMap.find(id);
-  if ( finder == chunkMap.end() ) return 0;
-
-  Chunk *c = finder->second;
-  chunkMap.erase(finder);
-  return c;
-}
-
-void World::clearChunks()
-{
-  ChunkMap::iterator it;
-  for ( it=chunkMap.begin(); it != chunkMap.end(); it++ ) {
-    delete it->second;
-  }
-  chunkMap.clear();
-}
-
-void World::draw( Camera &camera, Texture &texture )
-{
-  drawCount += 1;
-
-  const int xp = floor(camera.x()/Chunk::XSIZE)*Chunk::XSIZE;
-  const int yp = floor(camera.y()/Chunk::YSIZE)*Chunk::YSIZE;
-  const int zp = floor(camera.z()/Chunk::ZSIZE)*Chunk::ZSIZE;
-
-  texture.bind();
-
-  list<Vertex> drawList;
-  drawList.push_back( Vertex(xp, yp, zp) );
-
-  while ( !drawList.empty() )
-  {
-    Vertex v = drawList.front();
-    drawList.pop_front();
-    const int xi=v.x(), yi=v.y(), zi=v.z();
-
-    if ( !Chunk::visibleToCamera(camera, xi, yi, zi) )
-      continue;
-
-    Chunk *chunk = getChunk( xi, yi, zi );
-    if ( chunk ) {
-      if ( chunk->lastDrawn() != drawCount ) {
-        chunk->draw(camera, drawCount);
-        drawList.push_back( Vertex(xi, yi-Chunk::YSIZE, zi) );
-        drawList.push_back( Vertex(xi, yi+Chunk::YSIZE, zi) );
-        drawList.push_back( Vertex(xi-Chunk::XSIZE, yi, zi) );
-        drawList.push_back( Vertex(xi+Chunk::XSIZE, yi, zi) );
-        drawList.push_back( Vertex(xi, yi, zi-Chunk::ZSIZE) );
-        drawList.push_back( Vertex(xi, yi, zi+Chunk::ZSIZE) );
-      }
-    }
-    else if (fitsBounds(xi, yi, zi)) {
-      chunkLoadList.push_back( Vertex(xi, yi, zi) );
-    }
-  }
-
-  messageDrop = false;
-}
-
-Voxel &World::voxel( int x, int y, int z )
-{
-  Chunk *chunk = getChunk( x, y, z );
-  if (!chunk) return Voxel::shared;
-
-  int vx = x % Chunk::XSIZE;
-  int vy = y % Chunk::YSIZE;
-  int vz = z % Chunk::ZSIZE;
-  return chunk->voxel(vx, vy, vz);
-}
-
-void World::update( float dt )
-{
-  if ( chunksLoaded > (XSIZE * YSIZE * ZSIZE) )
-    return;
-
-  list<Chunk *> cullChunks;
-
-  while (!chunkLoadList.empty()) {
-    Vertex v = chunkLoadList.front();
-    chunkLoadList.pop_front();
-
-    if ( messageDrop ) cout << "ChunkLoad: " << v.x() << " " << v.y() << " " << v.z() << "\n";
-
-    float xp = floor( v.x() / Chunk::XSIZE ) * Chunk::XSIZE;
-    float yp = floor( v.y() / Chunk::YSIZE ) * Chunk::YSIZE;
-    float zp = floor( v.z() / Chunk::ZSIZE ) * Chunk::ZSIZE;
-
-    if ( !fitsBounds(xp, yp, zp) ) continue;
-
-    Chunk *chunk = getChunk( xp, yp, zp );
-    if (chunk) continue;
-
-    chunk = new Chunk( this, xp, yp, zp );
-    addChunk( chunk, xp, yp, zp );
-    chunk->randomize();
-    cullChunks.push_back(chunk);
-    chunksLoaded++;
-
-    Chunk *upChunk = getChunk( xp, yp+Chunk::YSIZE, zp );
-    if (upChunk) cullChunks.push_back(upChunk);
-    Chunk *dnChunk = getChunk( xp, yp-Chunk::YSIZE, zp );
-    if (dnChunk) cullChunks.push_back(dnChunk);
-    Chunk *noChunk = getChunk( xp, yp, zp+Chunk::ZSIZE );
-    if (noChunk) cullChunks.push_back(noChunk);
-    Chunk *soChunk = getChunk( xp, yp, zp-Chunk::ZSIZE );
-    if (soChunk) cullChunks.push_back(soChunk);
-    Chunk *weChunk = getChunk( xp+Chunk::XSIZE, yp, zp );
-    if (weChunk) cullChunks.push_back(weChunk);
-    Chunk *eaChunk = getChunk( xp-Chunk::XSIZE, yp, zp );
-    if (eaChunk) cullChunks.push_back(eaChunk);
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP );
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+ 
+  glTexImage2D(GL_TEXTURE_2D, 0, 4, display->w, display->h, 0, textureFormat, GL_UNSIGNED_BYTE, display->pixels);
 
-    break;
-  }
+  SDL_FreeSurface(display);
+  SDL_FreeSurface(message);
+}
 
-  while (!cullChunks.empty()) {
-    Chunk *chunk = cullChunks.front();
-    cullChunks.pop_front();
-    chunk->cullFaces();
-  }
+void TextPainter::draw( const float x, const float y, const float z )
+{
+  glEnable(GL_TEXTURE_2D);
+  glColor3f(1.0, 1.0, 1.0);
+  glBindTexture(GL_TEXTURE_2D, t);
+  glBegin(GL_QUADS);
+    glTexCoord2d(0, 0); glVertex3d(x,   y,   z);
+    glTexCoord2d(1, 0); glVertex3d(x+w, y,   z);
+    glTexCoord2d(1, 1); glVertex3d(x+w, y+h, z);
+    glTexCoord2d(0, 1); glVertex3d(x,   y+h, z);
+  glEnd();
 }
 
 // -----------------------------------------------------------------------------
@@ -1020,6 +212,74 @@ void CollisionBlock::translate( float x, float y, float z )
 
 // -----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+
+// What the keyboard and mouse did since the game thread last looked
+struct InputFrame
+{
+  Uint8 keys[SDLK_LAST];
+  int mousex;
+  int mousey;
+  vector<SDLKey> pressed;
+  bool quit;
+};
+
+// SDL 1.2 wants its events pumped on the thread that set the video mode,
+// which is the render thread, so input is gathered there and handed over.
+class InputState
+{
+  protected:
+    mutex lock;
+    InputFrame gathered;
+
+  public:
+    InputState();
+    void pump();
+    void take( InputFrame &frame );
+};
+
+InputState::InputState()
+{
+  memset( gathered.keys, 0, sizeof(gathered.keys) );
+  gathered.mousex = 0;
+  gathered.mousey = 0;
+  gathered.quit = false;
+}
+
+void InputState::pump()
+{
+  SDL_Event event;
+  lock_guard<mutex> hold( lock );
+  while ( SDL_PollEvent( &event ) ) {
+    if ( event.type == SDL_QUIT ) gathered.quit = true;
+    if ( event.type == SDL_KEYDOWN ) gathered.pressed.push_back( event.key.keysym.sym );
+  }
+
+  int numkeys = 0;
+  Uint8 *keys = SDL_GetKeyState( &numkeys );
+  memcpy( gathered.keys, keys, min( numkeys, int(SDLK_LAST) ) );
+
+  int mousex, mousey;
+  SDL_GetRelativeMouseState( &mousex, &mousey );
+  gathered.mousex += mousex;
+  gathered.mousey += mousey;
+}
+
+void InputState::take( InputFrame &frame )
+{
+  lock_guard<mutex> hold( lock );
+  memcpy( frame.keys, gathered.keys, sizeof(frame.keys) );
+  frame.mousex = gathered.mousex;
+  frame.mousey = gathered.mousey;
+  frame.pressed.swap( gathered.pressed );
+  frame.quit = gathered.quit;
+  gathered.pressed.clear();
+  gathered.mousex = 0;
+  gathered.mousey = 0;
+}
+
+// -----------------------------------------------------------------------------
+
 class Player : public Camera
 {
   protected:
@@ -1033,13 +293,13 @@ class Player : public Camera
 
   public:
     Player( World *w, float x=0.0, float y=0.0, float z=0.0, float xr=0.0, float yr=0.0 );
-    void update( float dt );
+    void update( float dt, const InputFrame &input );
     void inspect();
     void jump( float dy );
 
-    static const float HEAD=0.25;
-    static const float FEET=1.5;
-    static const float WAIST=0.3;
+    static constexpr float HEAD=0.25;
+    static constexpr float FEET=1.5;
+    static constexpr float WAIST=0.3;
 };
 
 Player::Player( World *w, float x, float y, float z, float xr, float yr )
@@ -1050,14 +310,14 @@ Player::Player( World *w, float x, float y, float z, float xr, float yr )
   /* */
 }
 
-void Player::update( float dt )
+void Player::update( float dt, const InputFrame &input )
 {
   const float moveSpeed = 4.0 * dt;
   const float lookSpeed = 0.10;
 
-  Uint8 *keys = SDL_GetKeyState(0);
-  int mousex, mousey;  
-  Uint8 buttons = SDL_GetRelativeMouseState(&mousex, &mousey);
+  const Uint8 *keys = input.keys;
+  const int mousex = input.mousex;
+  const int mousey = input.mousey;
 
   float oldx = xpos;
   float oldy = ypos;
@@ -1083,7 +343,7 @@ void Player::jump( float dy )
 
 void Player::physics( float dt, float oldx, float oldy, float oldz )
 {
-  Voxel &underVox = world->voxel( xpos, ypos-FEET, zpos );
+  Voxel underVox = world->voxel( xpos, ypos-FEET, zpos );
 
   if ( underVox.isTransparent() ) {
     // add gravity
@@ -1125,7 +385,7 @@ void Player::solveY( float dt, float oldy )
     block[3].set( floor(me.x2), floor(me.y1), floor(me.z2),
                   floor(me.x2)+1.0, floor(me.y1)+1.0, floor(me.z2)+1.0 );
     for (int i=0; i<4; i++) {
-      Voxel &vox = world->voxel( block[i].x1, block[i].y1, block[i].z1 );
+      Voxel vox = world->voxel( block[i].x1, block[i].y1, block[i].z1 );
       if ( !vox.isTransparent() ) {
         me.translate( 0, (block[i].y2-me.y1), 0 );
         ypos = me.y1+FEET;
@@ -1147,7 +407,7 @@ void Player::solveY( float dt, float oldy )
     block[3].set( floor(me.x2), floor(me.y2), floor(me.z2),
                   floor(me.x2)+1.0, floor(me.y2)+1.0, floor(me.z2)+1.0 );
     for (int i=0; i<4; i++) {
-      Voxel &vox = world->voxel( block[i].x1, block[i].y1, block[i].z1 );
+      Voxel vox = world->voxel( block[i].x1, block[i].y1, block[i].z1 );
       if ( !vox.isTransparent() ) {
         me.translate( 0, -(me.y2-block[i].y1), 0 );
         ypos = me.y2-HEAD;
@@ -1174,8 +434,8 @@ void Player::solveX( float dt, float oldx )
     clip = x-WAIST;
   }
 
-  Voxel &upVox = world->voxel( x, ypos, zpos );
-  Voxel &dnVox = world->voxel( x, ypos-1.0, zpos );
+  Voxel upVox = world->voxel( x, ypos, zpos );
+  Voxel dnVox = world->voxel( x, ypos-1.0, zpos );
 
   if ( upVox.isTransparent() && dnVox.isTransparent() )
     return;
@@ -1205,12 +465,13 @@ class Clock
     int current;
     string fps;
 
-    static void hline( float x1, float x2, float y );
+    static void hline( RenderPacket &packet, float x1, float x2, float y,
+                       float r, float g, float b );
 
   public:
     Clock();
     void update();
-    void draw();
+    void hud( RenderPacket &packet ) const;
     float delta() const;
     const string &fpsStr() const { return fps; };
 };
@@ -1241,34 +502,22 @@ float Clock::delta() const
   return history[0];
 }
 
-void Clock::hline( float x1, float x2, float y )
+void Clock::hline( RenderPacket &packet, float x1, float x2, float y,
+                   float r, float g, float b )
 {
-  glVertex2f( x1, y );
-  glVertex2f( x2, y );
+  packet.line( x1, y, x2, y, r, g, b );
 }
 
-void Clock::draw()
+void Clock::hud( RenderPacket &packet ) const
 {
-  glDisable(GL_TEXTURE_2D);
-
-  glBegin(GL_LINES);
-
-  glColor3f(0.0, 1.0, 0.5);
-  hline( 0.0, 200.0, 480.0 - (200.0/30.0) );
-
-  glColor3f(1.0, 0.5, 0.0);
-  hline( 0.0, 200.0, 480.0 - (200.0/15.0) );
+  hline( packet, 0.0, 200.0, 480.0 - (200.0/30.0), 0.0, 1.0, 0.5 );
+  hline( packet, 0.0, 200.0, 480.0 - (200.0/15.0), 1.0, 0.5, 0.0 );
 
   for ( int i = 0; i < HISIZE; i++ ) {
     const float p = (float(i) / float(HISIZE)) * 200.0;
-    glColor3f(0.0, 1.0, 0.0);
-    glVertex2f( p, 480.0 );
-
-    glColor3f(1.0*history[i], 1.0, 0.0);
-    glVertex2f( p, 480.0 - (200.0*history[i]) );
+    packet.hudVertex( p, 480.0, 0.0, 1.0, 0.0 );
+    packet.hudVertex( p, 480.0 - (200.0*history[i]), 1.0*history[i], 1.0, 0.0 );
   }
-
-  glEnd();
 }
 
 // -----------------------------------------------------------------------------
@@ -1282,6 +531,18 @@ void set2DScreen( float width, float height )
   glLoadIdentity();
 }
 
+void setupGL( int width, int height )
+{
+  glClearColor(0.75, 0.75, 0.75, 0);
+  glViewport(0, 0, width, height);
+
+  glEnable(GL_TEXTURE_2D);
+
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glEnable(GL_CULL_FACE);
+}
+
 SDL_Surface *setupScreen()
 {
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER,        1);
@@ -1299,14 +560,7 @@ SDL_Surface *setupScreen()
 
   SDL_Surface *screen = SDL_SetVideoMode( 640, 480, 32, SDL_HWSURFACE | SDL_OPENGL);
 
-  glClearColor(0.75, 0.75, 0.75, 0);
-  glViewport(0, 0, 640, 480);
-
-  glEnable(GL_TEXTURE_2D);
-
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LEQUAL);
-  glEnable(GL_CULL_FACE);
+  setupGL( 640, 480 );
 
   SDL_WM_GrabInput( SDL_GRAB_ON );
   SDL_ShowCursor( SDL_DISABLE );
@@ -1314,23 +568,231 @@ SDL_Surface *setupScreen()
   return screen;
 }
 
-void render( Camera &camera, World &world, Clock &clock, Texture &texture )
+// fog and textures are the draw queue's, see DrawQueue
+void setupScene( Camera &camera )
 {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   camera.set3DPerspective( 45.0f, 640.0 / 480.0 );
   camera.adjustGL();
+}
+
+// records and submits in one go, for the benches
+void drawScene( Camera &camera, World &world )
+{
+  setupScene( camera );
   camera.readyFrustum();
-  world.draw( camera, texture );
+  world.draw( camera );
+}
+
+void drawHud( const vector<float> &hud )
+{
+  glBegin(GL_LINES);
+  for ( int i = 0; i < hud.size(); i += 5 ) {
+    glColor3f( hud[i+2], hud[i+3], hud[i+4] );
+    glVertex2f( hud[i], hud[i+1] );
+  }
+  glEnd();
+}
+
+// the overlay's lines, queued along with the world's draws
+struct HudLines : public Drawable
+{
+  const vector<float> *lines;
 
+  HudLines() : lines(0) { /* */ };
+  void drawItem( int kind, int index, int pass, RenderStats &stats );
+};
+
+void HudLines::drawItem( int kind, int index, int pass, RenderStats &stats )
+{
   set2DScreen( 640.0, 480.0 );
+  drawHud( *lines );
+  stats.drawCalls++;
+}
+
+// the render thread's whole frame, every GL call in the game goes through here
+void render( RenderPacket &packet, World &world, ViewControl &view,
+             RenderQueue &queue, HudLines &hud )
+{
+  const double start = seconds();
+  view.beginGPU();
+
+  Camera camera = packet.camera;
+  setupScene( camera );
+
+  // the overlay pass comes last, whenever it's queued
+  DrawQueue &draws = world.draws();
+  hud.lines = &packet.hud;
+  draws.add( DrawQueue::OVERLAY, draws.state( DrawState() ), 0.0, &hud, 0, 0 );
+  world.submit( packet );
+
+  view.endGPU( seconds() - start );
+
+  if ( packet.report ) {
+    const RenderStats &stats = world.stats();
+    cout << "chunks drawn: " << stats.chunks
+         << " occluded: " << stats.occluded
+         << " queries: " << stats.queries
+         << " particles: " << stats.particles << "\n";
+    cout << "state changes: " << stats.stateChanges
+         << " skipped: " << stats.stateSkipped
+         << " overdraw: " << stats.overdraw << "\n";
+    double average, worst;
+    queue.latency( average, worst );
+    cout << "render queue ms: " << 1000.0 * average
+         << " worst: " << 1000.0 * worst
+         << " queued: " << queue.queued() << "\n";
+  }
+}
+
+// the game thread: input, simulation and culling, a packet a frame
+void simulate( World &world, Player &player, ViewControl &view, InputState &input,
+               RenderQueue &queue, const string &memoryCsv )
+{
+  Clock clock;
+  InputFrame frame;
+  bool wireframe = false;
+
+  // an empty path leaves the log closed and update() does nothing
+  MemoryLog memoryLog( memoryCsv );
+  if ( !memoryCsv.empty() && !memoryLog.isOpen() )
+    cout << "couldn't write " << memoryCsv << "\n";
+
+  // dust hanging in the air wherever we go
+  int dust;
+  {
+    lock_guard<mutex> hold( world.editLock() );
+    dust = world.particles().emit( ParticleSystem::AMBIENT, player.x(), player.y(), player.z(),
+                                   12.0, -1, 100.0 );
+  }
 
-  clock.draw();
+  while (true)
+  {
+    RenderPacket *packet = queue.record();
+    if (!packet) return;
+
+    input.take( frame );
+    bool quit = frame.quit;
+
+    for ( int k = 0; k < frame.pressed.size(); k++ ) {
+      switch ( frame.pressed[k] ) {
+        case SDLK_f:
+          player.setFog( !player.fogEnabled() );
+          break;
+        case SDLK_d: {
+          int vd = int( player.viewDistance() );
+          vd = ( vd / 20 + 1 ) * 20;
+          if ( vd > 200 ) vd = 20;
+          view.setManual( float(vd) );
+          cout << "view distance: " << vd << " manual\n";
+          break;
+        }
+        case SDLK_a:
+          view.setAutomatic( !view.isAutomatic() );
+          cout << "view distance: " << (view.isAutomatic() ? "auto" : "manual") << "\n";
+          break;
+        case SDLK_F10: quit = true; break;
+        case SDLK_PAGEUP: player.teleport( player.x(), player.y() + 8.0, player.z() ); break;
+        case SDLK_PAGEDOWN: player.teleport( player.x(), player.y() - 8.0, player.z() ); break;
+        case SDLK_F3:
+          player.inspect();
+          cout << clock.fpsStr() << "\n";
+          MemoryStats::report( cout );
+          view.report( cout );
+          world.dropMessage();
+          packet->report = true;
+          break;
+        case SDLK_F4:
+          world.setOcclusion( !world.occlusionEnabled() );
+          cout << "occlusion culling: " << (world.occlusionEnabled() ? "on" : "off") << "\n";
+          break;
+        case SDLK_F5:
+          player.teleport( 1.0, World::GROUND, 1.0 );
+          break;
+        case SDLK_F6:
+          player.teleport( float(World::XBLOCKS) / 2.0,
+                           float(World::GROUND) / 2.0 + 1.5,
+                           float(World::ZBLOCKS) / 2.0 );
+          break;
+        case SDLK_F7:
+          wireframe = true;
+          break;
+        case SDLK_F8:
+          wireframe = false;
+          break;
+        case SDLK_z:
+        case SDLK_x: {
+          // drop sand or a water source a few blocks over our head
+          const unsigned short type = frame.pressed[k] == SDLK_z ?
+            Voxel::SAND : Voxel::WATER + Voxel::WATER_LEVELS - 1;
+          lock_guard<mutex> hold( world.editLock() );
+          world.blocks().place( floor(player.x()), floor(player.y()) + 3, floor(player.z()), type );
+          break;
+        }
+        case SDLK_c: {
+          // break the first block we're looking at within reach
+          float m[16];
+          player.modelview( m );
+          lock_guard<mutex> hold( world.editLock() );
+          for ( float d = 0.0; d < 5.0; d += 0.05 ) {
+            const int x = floor( player.x() - m[2] * d );
+            const int y = floor( player.y() - m[6] * d );
+            const int z = floor( player.z() - m[10] * d );
+            const unsigned short t = world.voxel( x, y, z ).type();
+            if ( t == Voxel::AIR || Voxel::isWater( t ) ) continue;
+            world.blocks().place( x, y, z, Voxel::AIR );
+            world.particles().burst( x, y, z );
+            break;
+          }
+          break;
+        }
+        case SDLK_F11:
+          world.setPrepass( !world.prepassEnabled() );
+          cout << "depth prepass: " << (world.prepassEnabled() ? "on" : "off") << "\n";
+          break;
+        case SDLK_F9:
+          world.setRenderer( (world.currentRenderer() + 1) % World::RENDERERS );
+          cout << "renderer: " << World::rendererName( world.currentRenderer() ) << "\n";
+          break;
+      }
+    }
+
+    if (quit) {
+      queue.close();
+      return;
+    }
+
+    clock.update();
+
+    // the swap happens on the render thread, so vsync stays out of this
+    const double frameStart = seconds();
+    world.update( clock.delta() );
+    player.update( clock.delta(), frame );
+    {
+      lock_guard<mutex> hold( world.editLock() );
+      world.particles().moveEmitter( dust, player.x(), player.y(), player.z() );
+    }
 
-  SDL_GL_SwapBuffers();
+    player.setLens( 45.0f, 640.0 / 480.0 );
+    player.readyFrustum();
+    world.record( player, *packet );
+    packet->wireframe = wireframe;
+    clock.hud( *packet );
+    view.hud( *packet );
+    view.endFrame( seconds() - frameStart );
+
+    queue.publish();
+    MemoryStats::endFrame();
+    memoryLog.update();
+    SDL_Delay( 10 );
+  }
 }
 
-void gameloop()
+// this thread set the video mode, so it keeps GL and the SDL events and
+// hands everything else to the game thread
+void gameloop( const string &memoryCsv, double frameBudget,
+               const string &meshCache, long meshBudget )
 {
   Texture texture("tiles.png");
   if ( !texture.valid ) {
@@ -1340,13 +802,10 @@ void gameloop()
 
   cout << "GL_VERSION: " << glGetString(GL_VERSION) << "\n";
 
-  SDL_Event event;
-
   cout << "Loading World" << "\n";
   World world;
-
-  cout << "Starting Clock" << "\n";
-  Clock clock;
+  world.useTexture( texture.t );
+  if ( !meshCache.empty() ) world.useMeshCache( meshCache, meshBudget );
 
   Player player( &world, -1.0, 1.5, -1.0, 0.0, -180.0 );
 
@@ -1355,60 +814,815 @@ void gameloop()
 
   player.setFog( true );
 
+  // picks the view distance from here on, until d takes over
+  ViewControl view( player, world, frameBudget );
+
+  InputState input;
+  RenderQueue queue;
+  HudLines hud;
+
+  cout << "Starting game thread" << "\n";
+  thread game( [&]() { simulate( world, player, view, input, queue, memoryCsv ); } );
+
   while (true)
   {
-    while ( SDL_PollEvent( &event ) )
-    {
-      switch ( event.type ) {
-        case SDL_QUIT: return;
-
-        case SDL_KEYDOWN:
-          switch ( event.key.keysym.sym ) {
-            case SDLK_f:
-              player.setFog( !player.fogEnabled() );
-              break;
-            case SDLK_d: {
-              int vd = int( player.viewDistance() );
-              vd += 20;
-              if ( vd > 200 ) vd = 20;
-              player.setViewDistance( float(vd) );
-              player.setFog( player.fogEnabled() );
-              cout << "view distance: " << vd << "\n";
-              break;
-            }
-            case SDLK_F10: return;
-            case SDLK_PAGEUP: player.teleport( player.x(), player.y() + 8.0, player.z() ); break;
-            case SDLK_PAGEDOWN: player.teleport( player.x(), player.y() - 8.0, player.z() ); break;
-            case SDLK_F3:
-              player.inspect();
-              cout << clock.fpsStr() << "\n";
-              world.dropMessage();
-              break;
-            case SDLK_F5:
-              player.teleport( 1.0, World::YSIZE*Chunk::YSIZE, 1.0 );
-              break;
-            case SDLK_F6:
-              player.teleport( float(World::XSIZE * Chunk::XSIZE) / 2.0,
-                               float(World::YSIZE * Chunk::YSIZE) / 2.0 + 1.5,
-                               float(World::ZSIZE * Chunk::ZSIZE) / 2.0 );
-              break;
-            case SDLK_F7:
-              glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-              break;
-            case SDLK_F8:
-              glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-              break;
-          }
-          break;
+    input.pump();
+    RenderPacket *packet = queue.acquire();
+    if (!packet) break;
+    render( *packet, world, view, queue, hud );
+    queue.release();
+    SDL_GL_SwapBuffers();
+  }
+
+  queue.close();
+  game.join();
+}
+
+// flies the camera around the world on a fixed path and reports frame costs,
+// letting the view controller pick the distance when adaptive. Threaded, the
+// path is recorded on a second thread while this one submits
+int benchRender( int frames, int renderer, bool occlusion, bool prepass, bool adaptive,
+                 double frameBudget, bool threaded,
+                 const string &meshCache, long meshBudget )
+{
+  OffscreenContext context( 640, 480 );
+  if ( !context.isValid() ) {
+    cout << "couldn't create an offscreen GL context\n";
+    return 1;
+  }
+
+  cout << "GL_VERSION: " << glGetString(GL_VERSION) << "\n";
+  cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << "\n";
+
+  Framebuffer framebuffer( 640, 480 );
+  if ( !framebuffer.isValid() ) return 1;
+  framebuffer.bind();
+  setupGL( 640, 480 );
+
+  Texture texture("tiles.png");
+  if ( !texture.valid ) {
+    cout << "where's tiles.png?\n";
+    return 1;
+  }
+
+  World world;
+  world.useTexture( texture.t );
+  world.setRenderer( renderer );
+  world.setOcclusion( occlusion );
+  world.setPrepass( prepass );
+  if ( !meshCache.empty() ) world.useMeshCache( meshCache, meshBudget );
+  Camera camera;
+  camera.setViewDistance( 200.0 );
+  camera.setFog( true );
+
+  const float xc = 0.5 * float(World::XBLOCKS);
+  const float yc = 0.75 * float(World::GROUND);
+  const float zc = 0.5 * float(World::ZBLOCKS);
+
+  // the path circles the world centre looking across it and down
+  vector<Vertex> path;
+  vector<Point> angles;
+  for ( int i = 0; i < frames; i++ ) {
+    const float a = float(i) / float(frames) * 360.0;
+    const float r = a / 180.0 * M_PI;
+    path.push_back( Vertex( xc + sin(r) * xc * 0.6, yc, zc - cos(r) * zc * 0.6 ) );
+    angles.push_back( Point( 20.0, a + 180.0 ) );
+  }
+
+  // walk the path until no more chunks show up so the timed pass is stable
+  int loaded = -1;
+  while ( loaded != world.loadedChunks() ) {
+    loaded = world.loadedChunks();
+    for ( int i = 0; i < frames; i++ ) {
+      camera.teleport( path[i].x(), path[i].y(), path[i].z() );
+      camera.orient( angles[i].x, angles[i].y );
+      drawScene( camera, world );
+      world.update( 0.0 );
+    }
+  }
+  glFinish();
+
+  cout << "context: " << context.name()
+       << " chunk: " << Chunk::shapeName()
+       << " renderer: " << World::rendererName( renderer )
+       << " occlusion: " << (occlusion ? "on" : "off")
+       << " prepass: " << (prepass ? "on" : "off")
+       << " render thread: " << (threaded ? "on" : "off")
+       << " chunks: " << loaded << "\n";
+  cout << "per chunk loading, whole culls: " << double(Chunk::fullCullCount()) / loaded
+       << " side culls: " << double(Chunk::sideCullCount()) / loaded
+       << " mesh builds: " << double(Chunk::meshBuildCount()) / loaded << "\n";
+  if ( world.meshes() )
+    cout << "mesh cache hits: " << world.meshes()->hits()
+         << " misses: " << world.meshes()->misses() << "\n";
+  cout << "frame,submit_ms,finish_ms,draw_calls,vertices,chunks,occluded,queries,view_distance,"
+       << "state_changes,overdraw\n";
+
+  ViewControl view( camera, world, frameBudget );
+  view.setAutomatic( adaptive );
+
+  double submitTotal = 0.0, finishTotal = 0.0, recordTotal = 0.0;
+  double worstFrame = 0.0;
+  long drawTotal = 0, vertexTotal = 0, bytesTotal = 0, chunkTotal = 0;
+  long stateTotal = 0, skippedTotal = 0;
+  double overdrawTotal = 0.0;
+
+  RenderQueue queue;
+  auto recordFrame = [&]( int i ) {
+    RenderPacket *packet = queue.record();
+    const double start = seconds();
+    camera.teleport( path[i].x(), path[i].y(), path[i].z() );
+    camera.orient( angles[i].x, angles[i].y );
+    camera.setLens( 45.0f, 640.0 / 480.0 );
+    camera.readyFrustum();
+    world.record( camera, *packet );
+    const double recorded = seconds() - start;
+    recordTotal += recorded;
+    if (threaded) view.endFrame( recorded );
+    queue.publish();
+  };
+
+  thread recorder;
+  if (threaded) {
+    recorder = thread( [&]() {
+      for ( int i = 0; i < frames; i++ ) recordFrame( i );
+    });
+  }
+
+  for ( int i = 0; i < frames; i++ ) {
+    const double start = seconds();
+    if (!threaded) recordFrame( i );
+    const double submitStart = threaded ? seconds() : start;
+
+    RenderPacket *packet = queue.acquire();
+    view.beginGPU();
+    Camera shown = packet->camera;
+    setupScene( shown );
+    world.submit( *packet );
+    const double submitted = seconds();
+    glFinish();
+    const double finished = seconds();
+    view.endGPU( finished - submitStart );
+    if (!threaded) view.endFrame( finished - start );
+    queue.release();
+    MemoryStats::endFrame();
+
+    const double submitMs = ( submitted - submitStart ) * 1000.0;
+    const double finishMs = ( finished - submitted ) * 1000.0;
+    const RenderStats &stats = world.stats();
+
+    cout << i << "," << submitMs << "," << finishMs << ","
+         << stats.drawCalls << "," << stats.vertices << ","
+         << stats.chunks << "," << stats.occluded << "," << stats.queries << ","
+         << shown.viewDistance() << "," << stats.stateChanges << ","
+         << stats.overdraw << "\n";
+
+    submitTotal += submitMs;
+    finishTotal += finishMs;
+    if ( submitMs + finishMs > worstFrame ) worstFrame = submitMs + finishMs;
+    drawTotal += stats.drawCalls;
+    vertexTotal += stats.vertices;
+    bytesTotal += stats.meshBytes;
+    chunkTotal += stats.chunks;
+    stateTotal += stats.stateChanges;
+    skippedTotal += stats.stateSkipped;
+    overdrawTotal += stats.overdraw;
+  }
+
+  if (threaded) recorder.join();
+  framebuffer.unbind();
+
+  double queueAverage, queueWorst;
+  queue.latency( queueAverage, queueWorst );
+
+  cout << "frames: " << frames
+       << " avg submit ms: " << submitTotal / frames
+       << " avg finish ms: " << finishTotal / frames
+       << " worst frame ms: " << worstFrame
+       << " avg draw calls: " << double(drawTotal) / frames
+       << " avg vertices: " << double(vertexTotal) / frames
+       << " avg mesh KB: " << double(bytesTotal) / frames / 1024.0
+       << " avg chunks: " << double(chunkTotal) / frames << "\n";
+  cout << "avg record ms: " << 1000.0 * recordTotal / frames
+       << " avg queue ms: " << 1000.0 * queueAverage
+       << " worst queue ms: " << 1000.0 * queueWorst << "\n";
+  cout << "avg state changes: " << double(stateTotal) / frames
+       << " avg skipped: " << double(skippedTotal) / frames
+       << " avg overdraw: " << overdrawTotal / frames << "\n";
+  MemoryStats::report( cout );
+  view.report( cout );
+  cout << "view distance changes: " << view.distanceChanges() << "\n";
+  return 0;
+}
+
+// times working out the visible chunks alone, no GL needed, over a world
+// of blank chunks wider than any view distance tried. A camera strolls and
+// turns the way a player would; the walk is kept between frames or redone
+// every frame
+int benchVisibility( int frames )
+{
+  const int size = 512, height = 96;
+  World world;
+  for ( int z = 0; z < size; z += Chunk::ZSIZE )
+    for ( int y = 0; y < height; y += Chunk::YSIZE )
+      for ( int x = 0; x < size; x += Chunk::XSIZE )
+        world.blankChunk( x, y, z );
+  BulkEdit edit( world );
+  edit.fill( 0, 0, 0, size, 8, size, Voxel::STONE );
+  cout << "chunks: " << world.loadedChunks() << " frames: " << frames << "\n";
+
+  const float distances[] = { 64.0, 128.0, 256.0 };
+  RenderPacket packet;
+  for ( int d = 0; d < 3; d++ ) {
+    for ( int cached = 1; cached >= 0; cached-- ) {
+      world.setVisibilityCache( cached );
+      Camera camera;
+      camera.setViewDistance( distances[d] );
+      camera.setLens( 45.0f, 640.0 / 480.0 );
+
+      const int walked = world.visibilityWalks();
+      long drawn = 0;
+      double total = 0.0, worst = 0.0;
+      for ( int i = 0; i < frames; i++ ) {
+        const float a = float(i) / float(frames) * 2.0 * M_PI;
+        camera.teleport( 0.5 * size + sin(a) * 0.25 * size, 20.0, 0.5 * size - cos(a) * 0.25 * size );
+        camera.orient( 15.0 + 10.0 * sin(3.0 * a), float(i) * 0.5 );
+        camera.readyFrustum();
+
+        packet.clear();
+        const double start = seconds();
+        world.record( camera, packet );
+        const double took = seconds() - start;
+        total += took;
+        worst = max( worst, took );
+        drawn += packet.chunks.size();
       }
+      cout << "view distance: " << distances[d]
+           << " kept: " << (cached ? "yes" : "no")
+           << " walks: " << world.visibilityWalks() - walked
+           << " avg us: " << 1000000.0 * total / frames
+           << " worst us: " << 1000000.0 * worst
+           << " avg chunks: " << double(drawn) / frames << "\n";
     }
+  }
+  return 0;
+}
 
-    clock.update();
-    world.update( clock.delta() );
-    player.update( clock.delta() );
-    render( player, world, clock, texture );
-    SDL_Delay( 10 );
+// times the CPU side of chunk generation, culling and meshing, no GL needed
+int benchChunks( int rounds )
+{
+  World world;
+  vector<Chunk*> chunks;
+  const double loadStart = seconds();
+  world.loadAll( chunks );
+  const double loadTime = seconds() - loadStart;
+
+  // the whole world through the staged generator, once
+  WorldGen &gen = world.generation();
+  int holding = 0;
+  for ( int i = 0; i < chunks.size(); i++ ) holding += !chunks[i]->isEmpty();
+  cout << "pipeline ms: " << 1000.0 * loadTime
+       << " threads: " << world.workers().size()
+       << " cached: " << gen.cached() << "\n";
+  cout << "world: " << World::XBLOCKS << "x" << World::YBLOCKS << "x" << World::ZBLOCKS
+       << " chunks: " << chunks.size() << " holding blocks: " << holding
+       << " voxel KB: " << MemoryStats::get( MemoryStats::CHUNK_VOXELS ) / 1024 << "\n";
+  for ( int s = 0; s < WorldGen::STAGES; s++ )
+    cout << WorldGen::stageName( s ) << " runs: " << gen.stageCount( s )
+         << " ms: " << 1000.0 * gen.stageSeconds( s ) << "\n";
+
+  double generate = 0.0, cull = 0.0, mesh = 0.0;
+  long faces = 0;
+  vector<Face> faceList;
+
+  for ( int r = 0; r < rounds; r++ ) {
+    double start = seconds();
+    for ( int i = 0; i < chunks.size(); i++ ) chunks[i]->randomize();
+    generate += seconds() - start;
+
+    start = seconds();
+    for ( int i = 0; i < chunks.size(); i++ ) chunks[i]->cullFaces();
+    cull += seconds() - start;
+
+    start = seconds();
+    for ( int i = 0; i < chunks.size(); i++ ) {
+      faceList.clear();
+      chunks[i]->buildMesh( faceList );
+      faces += faceList.size();
+    }
+    mesh += seconds() - start;
+  }
+
+  const double perChunk = 1000000.0 / double( rounds * chunks.size() );
+  cout << "chunk: " << Chunk::shapeName()
+       << " layout: " << Chunk::layoutName()
+       << " chunks: " << chunks.size() << " rounds: " << rounds << "\n";
+  cout << "generate us/chunk: " << generate * perChunk
+       << " cull us/chunk: " << cull * perChunk
+       << " mesh us/chunk: " << mesh * perChunk
+       << " faces/chunk: " << double(faces) / double( rounds * chunks.size() ) << "\n";
+  return 0;
+}
+
+// loads the whole world once with no cache, then again in sessions sharing
+// one cache file, the first starting with none. Every session should end
+// up with the faces the uncached one had
+int benchMeshCache( int sessions, const string &path, long budget )
+{
+  remove( path.c_str() );
+  cout << "chunk: " << Chunk::shapeName() << " layout: " << Chunk::layoutName()
+       << " cache: " << path << " budget KB: " << budget / 1024 << "\n";
+
+  long expected = -1;
+  bool same = true;
+  for ( int s = -1; s < sessions; s++ ) {
+    const long builds = Chunk::meshBuildCount();
+    World world;
+    if ( s >= 0 ) world.useMeshCache( path, budget );
+
+    vector<Chunk*> chunks;
+    const double start = seconds();
+    world.loadAll( chunks );
+    const double loadTime = seconds() - start;
+    const double cullTime = world.generation().stageSeconds( WorldGen::CULL );
+
+    long faces = 0;
+    vector<Face> faceList;
+    for ( int i = 0; i < chunks.size(); i++ ) {
+      faceList.clear();
+      chunks[i]->buildMesh( faceList );
+      faces += faceList.size();
+    }
+    if ( expected < 0 ) expected = faces;
+    if ( faces != expected ) same = false;
+
+    cout << "session: " << (s < 0 ? string("none") : to_string( s+1 ))
+         << " chunks: " << chunks.size()
+         << " load ms: " << 1000.0 * loadTime
+         << " cull stage ms: " << 1000.0 * cullTime
+         << " mesh builds: " << Chunk::meshBuildCount() - builds
+         << " faces: " << faces;
+    if ( s >= 0 ) {
+      MeshCache *cache = world.meshes();
+      cache->save();
+      cout << " hits: " << cache->hits() << " misses: " << cache->misses()
+           << " kept: " << cache->size() << " evicted: " << cache->evicted()
+           << " file KB: " << cache->fileBytes() / 1024;
+    }
+    cout << "\n";
+  }
+  cout << "faces match: " << (same ? "yes" : "no") << "\n";
+  return same ? 0 : 1;
+}
+
+// drops a crowd of mobs and items on the terrain and times the batched step
+int benchEntities( int count, int threads )
+{
+  World world;
+  vector<Chunk*> chunks;
+  world.loadAll( chunks );
+
+  WorkerPool pool( threads );
+  EntityPhysics physics( world, pool );
+  EntityStore entities;
+
+  srand( 1 );
+  for ( int i = 0; i < count; i++ ) {
+    const float x = 1.0 + rand() % (World::XBLOCKS - 2) + (rand() % 100) / 100.0;
+    const float z = 1.0 + rand() % (World::ZBLOCKS - 2) + (rand() % 100) / 100.0;
+    // above the highest block of the neighbouring columns too
+    int top = 0;
+    for ( int dz = -1; dz <= 1; dz++ )
+      for ( int dx = -1; dx <= 1; dx++ )
+        top = max( top, world.topSolid( x+dx, z+dz ) );
+    const float y = top + 3.0 + rand() % 8;
+
+    // mostly player sized mobs, the rest dropped items
+    if ( rand() % 10 < 7 )
+      entities.add( x, y, z, Player::WAIST, 0.5 * (Player::HEAD + Player::FEET), Player::WAIST );
+    else
+      entities.add( x, y, z, 0.125, 0.125, 0.125 );
+  }
+
+  const float dt = 1.0 / 20.0;
+  const int warmup = 40;
+  const int ticks = 200;
+  double bin = 0, broadphase = 0, integrate = 0, worst = 0;
+
+  for ( int t = 0; t < warmup + ticks; t++ ) {
+    // keep a tenth of the crowd wandering so it never settles
+    for ( int k = 0; k < count / 10; k++ ) {
+      const int i = rand() % entities.size();
+      entities.vx[i] = ((rand() % 200) - 100) / 25.0;
+      entities.vz[i] = ((rand() % 200) - 100) / 25.0;
+      if ( entities.grounded[i] && rand() % 4 == 0 ) entities.vy[i] = 5.0;
+    }
+
+    const double start = seconds();
+    physics.step( entities, dt );
+    const double elapsed = seconds() - start;
+    if ( t < warmup ) continue;
+
+    const PhysicsTimes &times = physics.times();
+    bin += times.bin;
+    broadphase += times.broadphase;
+    integrate += times.integrate;
+    worst = max( worst, elapsed );
+  }
+
+  int grounded = 0;
+  for ( int i = 0; i < entities.size(); i++ ) grounded += entities.grounded[i];
+
+  const double ms = 1000.0 / ticks;
+  cout << "entities: " << entities.size() << " threads: " << pool.size()
+       << " ticks: " << ticks << "\n";
+  cout << "avg tick ms: " << (bin + broadphase + integrate) * ms
+       << " worst tick ms: " << worst * 1000.0
+       << " bin ms: " << bin * ms
+       << " broadphase ms: " << broadphase * ms
+       << " integrate ms: " << integrate * ms << "\n";
+  cout << "grounded: " << grounded << " embedded: " << physics.embedded( entities ) << "\n";
+  return 0;
+}
+
+// pours sand and water onto the terrain and times the block updates
+int benchBlocks( int ticks )
+{
+  World world;
+  vector<Chunk*> chunks;
+  world.loadAll( chunks );
+  BlockSim &blocks = world.blocks();
+
+  const int top = World::GROUND - 2;
+  const int xc = World::XBLOCKS / 2;
+  const int zc = World::ZBLOCKS / 2;
+  for ( int z = -8; z < 8; z++ )
+    for ( int x = -8; x < 8; x++ )
+      blocks.place( xc+x, top, zc+z, Voxel::SAND );
+  for ( int i = 0; i < 8; i++ )
+    blocks.place( 4 + i * (World::XBLOCKS - 8) / 8, top, 6 + (i % 2) * (World::ZBLOCKS - 12),
+                  Voxel::WATER + Voxel::WATER_LEVELS - 1 );
+
+  double total = 0, worst = 0;
+  long run = 0, changed = 0;
+  int peak = 0, settled = -1;
+  for ( int t = 0; t < ticks; t++ ) {
+    const double start = seconds();
+    blocks.tick();
+    const double elapsed = seconds() - start;
+
+    total += elapsed;
+    worst = max( worst, elapsed );
+    run += blocks.lastRun();
+    changed += blocks.lastChanged();
+    peak = max( peak, blocks.lastRun() );
+    if ( blocks.lastRun() == 0 && settled < 0 ) settled = t;
+  }
+
+  const double start = seconds();
+  blocks.tick();
+  const double idle = seconds() - start;
+
+  cout << "threads: " << world.workers().size() << " ticks: " << ticks
+       << " world cells: " << long(chunks.size()) * Chunk::VOLUME << "\n";
+  cout << "avg tick ms: " << 1000.0 * total / ticks
+       << " worst tick ms: " << 1000.0 * worst
+       << " us per cell run: " << (run ? 1000000.0 * total / run : 0.0)
+       << " idle tick ms: " << 1000.0 * idle << "\n";
+  cout << "cells run: " << run << " changed: " << changed
+       << " peak active: " << peak << " settled at tick: " << settled << "\n";
+  return 0;
+}
+
+// keeps about count particles alive over the generated world, dust drifting
+// from emitters spread over the surface and blocks bursting under the camera,
+// and times stepping, recording and drawing them with and without the vector
+// loop. Drawing needs an offscreen context and is skipped without one
+int benchParticles( int count )
+{
+  OffscreenContext context( 640, 480 );
+  Framebuffer *framebuffer = 0;
+  Texture *texture = 0;
+  if ( context.isValid() ) {
+    framebuffer = new Framebuffer( 640, 480 );
+    framebuffer->bind();
+    setupGL( 640, 480 );
+    texture = new Texture( "tiles.png" );
+    if ( !texture->valid ) {
+      cout << "where's tiles.png?\n";
+      return 1;
+    }
+  }
+
+  World world;
+  vector<Chunk*> chunks;
+  world.loadAll( chunks );
+  ParticleSystem &particles = world.particles();
+  ParticleBatch batch;
+  GLState gl;
+  DrawState dust;
+  dust.texture = texture ? texture->t : 0;
+  dust.arrays = true;
+
+  const float dt = 1.0 / 60.0;
+  const int bursts = 8;
+  const int crumbs = 32;
+  const int emitters = 64;
+  const float xc = 0.5 * float(World::XBLOCKS);
+  const float zc = 0.5 * float(World::ZBLOCKS);
+
+  // crumbs last 0.8s and dust 4s on average, the dust makes up the rest
+  const float crumbsLive = bursts * crumbs * 0.8 / dt;
+  const float rate = max( 0.0f, float(count) - crumbsLive ) / 4.0 / emitters;
+  srand( 1 );
+  for ( int i = 0; i < emitters; i++ )
+    particles.emit( ParticleSystem::AMBIENT, rand() % World::XBLOCKS, World::GROUND + 4,
+                    rand() % World::ZBLOCKS, 12.0, -1, rate );
+
+  Camera camera;
+  camera.setViewDistance( 200.0 );
+  camera.teleport( xc, World::GROUND + 6.0, zc );
+  camera.orient( 20.0, 0.0 );
+  camera.readyFrustum();
+
+  // till the dust's had time to fill in
+  for ( int f = 0; f < 600; f++ ) {
+    for ( int b = 0; b < bursts; b++ )
+      particles.burst( xc - 16 + rand() % 32, World::GROUND - 1, zc - 16 + rand() % 32, crumbs );
+    particles.step( dt );
+  }
+
+  cout << "particles: " << count << " live: " << particles.live()
+       << " emitters: " << particles.activeEmitters()
+       << " draw: " << (context.isValid() ? context.name() : "skipped") << "\n";
+
+  // a quarter of a 60Hz frame for the game thread's share; the draw is
+  // reported apart, it's down to the driver
+  const int frames = 200;
+  const double budget = 4.0;
+  double best = 0.0;
+  vector<float> quads;
+  for ( int pass = 0; pass < 2; pass++ ) {
+    particles.setSimd( pass == 0 );
+    double stepTotal = 0, integrateTotal = 0, collideTotal = 0, recordTotal = 0, drawTotal = 0;
+    long live = 0, drawn = 0, lookups = 0, collided = 0;
+    for ( int f = 0; f < frames; f++ ) {
+      for ( int b = 0; b < bursts; b++ )
+        particles.burst( xc - 16 + rand() % 32, World::GROUND - 1, zc - 16 + rand() % 32, crumbs );
+
+      double start = seconds();
+      particles.step( dt );
+      stepTotal += seconds() - start;
+      integrateTotal += particles.lastStep().integrate;
+      collideTotal += particles.lastStep().collide;
+      lookups += particles.lastStep().lookups;
+      collided += particles.lastStep().collided;
+      live += particles.live();
+
+      start = seconds();
+      quads.clear();
+      particles.record( camera, quads );
+      recordTotal += seconds() - start;
+      drawn += quads.size() / 20;
+
+      if ( context.isValid() ) {
+        start = seconds();
+        setupScene( camera );
+        gl.apply( dust );
+        RenderStats stats;
+        batch.draw( quads, stats );
+        glFinish();
+        drawTotal += seconds() - start;
+      }
+    }
+
+    const double total = 1000.0 * (stepTotal + recordTotal) / frames;
+    if ( pass == 0 ) best = total;
+    cout << "simd width: " << particles.simdWidth()
+         << " avg live: " << live / frames
+         << " avg drawn: " << drawn / frames << "\n";
+    cout << "  avg step ms: " << 1000.0 * stepTotal / frames
+         << " integrate ms: " << 1000.0 * integrateTotal / frames
+         << " collide ms: " << 1000.0 * collideTotal / frames
+         << " record ms: " << 1000.0 * recordTotal / frames << "\n";
+    cout << "  step and record ms: " << total
+         << " draw ms: " << 1000.0 * drawTotal / frames << "\n";
+    cout << "  chunk lookups per frame: " << lookups / frames
+         << " collisions per frame: " << collided / frames << "\n";
+  }
+  cout << "step and record budget " << budget << " ms: "
+       << (best <= budget ? "within" : "over") << "\n";
+
+  if (framebuffer) framebuffer->unbind();
+  delete texture;
+  delete framebuffer;
+  return 0;
+}
+
+// fills a size^3 box of blank chunks a block at a time, then times the bulk
+// edits over the same box
+int benchEdits( int size )
+{
+  size = min( size, int(World::MAXHEIGHT) );
+  World world;
+  vector<Chunk*> chunks;
+  for ( int z = 0; z < size; z += Chunk::ZSIZE )
+    for ( int y = 0; y < size; y += Chunk::YSIZE )
+      for ( int x = 0; x < size; x += Chunk::XSIZE )
+        chunks.push_back( world.blankChunk( x, y, z ) );
+
+  // a solid box shows six faces per block of its surface
+  auto faces = [&]() {
+    long n = 0;
+    for ( int i = 0; i < chunks.size(); i++ )
+      for ( int z = 0; z < Chunk::ZSIZE; z++ )
+        for ( int y = 0; y < Chunk::YSIZE; y++ )
+          for ( int x = 0; x < Chunk::XSIZE; x++ )
+            n += __builtin_popcount( chunks[i]->voxel( x, y, z ).visibility() );
+    return n;
+  };
+
+  const long volume = long(size) * size * size;
+  cout << "box: " << size << " blocks: " << volume << " chunks: " << chunks.size()
+       << " threads: " << world.workers().size() << "\n";
+
+  // what it takes today: a lookup and a write per block, then every chunk
+  // culled whole, borders through the world
+  double start = seconds();
+  for ( int z = 0; z < size; z++ )
+    for ( int y = 0; y < size; y++ )
+      for ( int x = 0; x < size; x++ )
+        world.chunkAt( x, y, z )->setTypeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK, Voxel::STONE );
+  const double perBlockWrite = seconds() - start;
+  for ( int i = 0; i < chunks.size(); i++ ) chunks[i]->cullFaces();
+  const double perBlock = seconds() - start;
+  cout << "per block ms: " << 1000.0 * perBlock
+       << " write ms: " << 1000.0 * perBlockWrite
+       << " Mblocks/s: " << volume / perBlock / 1000000.0
+       << " faces: " << faces() << "\n";
+
+  BulkEdit edit( world );
+  auto timed = [&]( const char *name, const function<long()> &op ) {
+    const double start = seconds();
+    const long blocks = op();
+    const double elapsed = seconds() - start;
+    cout << name << " ms: " << 1000.0 * elapsed
+         << " cull ms: " << 1000.0 * edit.lastCullSeconds()
+         << " chunks: " << edit.lastChunks()
+         << " blocks: " << blocks
+         << " Mblocks/s: " << blocks / elapsed / 1000000.0 << "\n";
+  };
+
+  timed( "fill air", [&]() { return edit.fill( 0, 0, 0, size, size, size, Voxel::AIR ); } );
+  timed( "fill stone", [&]() { return edit.fill( 0, 0, 0, size, size, size, Voxel::STONE ); } );
+  cout << "faces: " << faces() << "\n";
+  timed( "replace", [&]() { return edit.replace( 0, 0, 0, size, size, size, Voxel::STONE, Voxel::WOOD ); } );
+
+  const float c = 0.5 * size;
+  timed( "carve", [&]() { return edit.carve( c, c, c, 0.4 * size ); } );
+
+  Schematic corner;
+  const int half = size / 2;
+  start = seconds();
+  edit.copy( 0, 0, 0, half, half, half, corner );
+  cout << "copy ms: " << 1000.0 * (seconds() - start) << " blocks: " << corner.volume() << "\n";
+  timed( "paste", [&]() { return edit.paste( corner, half, half, half ); } );
+  return 0;
+}
+
+// times long walks over the generated terrain and over a bigger built one,
+// portal search against plain cell by cell A*, and what an edit costs
+int benchPaths( int queries )
+{
+  typedef Pathfinder::Cell Cell;
+  typedef vector< pair<Cell, Cell> > Pairs;
+
+  // somewhere to stand in x0..x1, z0..z1, looking down from top
+  auto standing = [&]( Pathfinder &paths, int x0, int x1, int z0, int z1, int top, Cell &c ) {
+    for ( int tries = 0; tries < 1000; tries++ ) {
+      const int x = x0 + rand() % (x1 - x0);
+      const int z = z0 + rand() % (z1 - z0);
+      for ( int y = top; y > 0; y-- ) {
+        if ( !paths.walkable( x, y, z ) ) continue;
+        c = Cell( x, y, z );
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto run = [&]( Pathfinder &paths, const char *name, const Pairs &pairs, bool flat ) {
+    vector<Cell> path;
+    long length = 0, expanded = 0, rebuilt = 0;
+    int found = 0;
+    const double start = seconds();
+    for ( int i = 0; i < pairs.size(); i++ ) {
+      const bool ok = flat ? paths.findFlat( pairs[i].first, pairs[i].second, path )
+                           : paths.find( pairs[i].first, pairs[i].second, path );
+      if (ok) {
+        found++;
+        length += path.size() - 1;
+      }
+      expanded += paths.lastSearch().expanded;
+      rebuilt += paths.lastSearch().rebuilt;
+    }
+    const double elapsed = seconds() - start;
+    const int n = max( int(pairs.size()), 1 );
+    cout << name << " queries: " << pairs.size() << " found: " << found
+         << " per second: " << pairs.size() / elapsed
+         << " avg ms: " << 1000.0 * elapsed / n
+         << " avg steps: " << (found ? double(length) / found : 0.0)
+         << " avg expanded: " << double(expanded) / n
+         << " chunks read: " << rebuilt << "\n";
+    return length;
+  };
+
+  // at least half the world apart, and only ones with a way through, since
+  // the terrain's cliffs are far too tall to step up
+  auto pick = [&]( Pathfinder &paths, int size, int top, int count, Pairs &pairs ) {
+    vector<Cell> path;
+    pairs.clear();
+    for ( int tries = 0; tries < count * 50 && pairs.size() < count; tries++ ) {
+      Cell a, b;
+      if ( !standing( paths, 0, size, 0, size, top, a ) ) continue;
+      if ( !standing( paths, 0, size, 0, size, top, b ) ) continue;
+      if ( abs(a.x - b.x) + abs(a.z - b.z) < size / 2 ) continue;
+      if ( paths.find( a, b, path ) ) pairs.push_back( make_pair( a, b ) );
+    }
+  };
+
+  // picking warms a pathfinder of its own, so the first pass here is cold
+  const int flatCount = max( 1, min( queries / 10, 50 ) );
+  auto measure = [&]( World &world, int size, int top, Pathfinder &paths, Pairs &pairs ) {
+    {
+      Pathfinder picker( world );
+      pick( picker, size, top, queries, pairs );
+    }
+    run( paths, "cold", pairs, false );
+    const Pairs few( pairs.begin(), pairs.begin() + min( flatCount, int(pairs.size()) ) );
+    const long portalSteps = run( paths, "portals", few, false );
+    const long flatSteps = run( paths, "flat", few, true );
+    run( paths, "portals", pairs, false );
+    cout << "nav chunks: " << paths.chunks() << " portals: " << paths.portals()
+         << " steps over shortest: " << (flatSteps ? double(portalSteps) / flatSteps : 0.0) << "\n";
+  };
+
+  {
+    World world;
+    vector<Chunk*> chunks;
+    world.loadAll( chunks );
+    cout << "terrain: " << World::XBLOCKS << "x" << World::GROUND << "x" << World::ZBLOCKS
+         << " chunks: " << chunks.size() << "\n";
+    Pathfinder paths( world );
+    Pairs pairs;
+    measure( world, World::XBLOCKS, World::GROUND, paths, pairs );
+  }
+
+  // a floor with stepped hills, and walls with gaps in them that the hills
+  // keep clear of
+  const int size = 384, height = 48, walls = size / 6;
+  World world;
+  for ( int z = 0; z < size; z += Chunk::ZSIZE )
+    for ( int y = 0; y < height; y += Chunk::YSIZE )
+      for ( int x = 0; x < size; x += Chunk::XSIZE )
+        world.blankChunk( x, y, z );
+
+  BulkEdit edit( world );
+  edit.fill( 0, 0, 0, size, 8, size, Voxel::STONE );
+  for ( int i = 0; i < size * size / 200; i++ ) {
+    const int x = rand() % size, z = rand() % size;
+    const int w = 8 + rand() % 24, d = 8 + rand() % 24;
+    if ( (x + w + 2) / walls != (x - 4) / walls || (z + d + 2) / walls != (z - 4) / walls ) continue;
+    for ( int h = 0; h < 3; h++ )
+      edit.fill( x + 2*h, 8 + h, z + 2*h, x + w - 2*h, 9 + h, z + d - 2*h, Voxel::STONE );
+  }
+  for ( int at = walls; at < size; at += walls ) {
+    edit.fill( at, 8, 0, at + 2, 16, size, Voxel::STONE );
+    edit.fill( 0, 8, at, size, 16, at + 2, Voxel::STONE );
+    for ( int g = 0; g < 3; g++ ) {
+      const int gap = rand() % (size - 8);
+      edit.fill( at, 8, gap, at + 2, 16, gap + 6, Voxel::AIR );
+      edit.fill( gap, 8, at, gap + 6, 16, at + 2, Voxel::AIR );
+    }
   }
+
+  cout << "built: " << size << "x" << height << "x" << size
+       << " chunks: " << world.loadedChunks() << "\n";
+  Pathfinder paths( world );
+  Pairs pairs;
+  measure( world, size, height - 1, paths, pairs );
+
+  // a wall all the way across, then put back the way it was
+  const int across = walls * 3 + walls / 2;
+  const Pairs few( pairs.begin(), pairs.begin() + min( flatCount, int(pairs.size()) ) );
+  Schematic before;
+  edit.copy( across, 8, 0, across + 1, height, size, before );
+  edit.fill( across, 8, 0, across + 1, height, size, Voxel::STONE );
+  run( paths, "walled", few, false );
+  edit.paste( before, across, 8, 0 );
+  run( paths, "opened", few, false );
+  run( paths, "opened", few, false );
+  return 0;
 }
 
 class App
@@ -1426,13 +1640,14 @@ class App
       if (valid) SDL_Quit();
     };
 
-    void run()
+    void run( const string &memoryCsv, double frameBudget,
+              const string &meshCache, long meshBudget )
     {
       if (!valid) return;
       SDL_Surface *screen = setupScreen();
       if (screen) {
         cout << "begin\n";
-        gameloop();
+        gameloop( memoryCsv, frameBudget, meshCache, meshBudget );
         cout << "end\n";
       }
     }
@@ -1441,8 +1656,123 @@ class App
 int main( int argc, char **argv )
 {
   cout << "chunk size: " << sizeof(Chunk) << "\n";
+
+  int bench = 0;
+  int frames = 360;
+  int rounds = 0;
+  int renderer = World::DISPLAY_LISTS;
+  int entities = 0;
+  int threads = 0;
+  int blockTicks = 0;
+  int editSize = 0;
+  int pathQueries = 0;
+  int visibilityFrames = 0;
+  int meshSessions = 0;
+  int particleCount = 0;
+  string memoryCsv;
+  bool occlusion = false;
+  bool prepass = false;
+  bool adaptive = false;
+  bool threaded = false;
+  double frameBudget = 1.0 / 60.0;
+
+  // the game keeps one by default, benches only when asked
+  string meshCache;
+  bool meshCacheGiven = false;
+  long meshBudget = 64L << 20;
+
+  for ( int i = 1; i < argc; i++ ) {
+    const string arg = argv[i];
+    if ( arg == "--bench-render" ) {
+      bench = 1;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) frames = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-chunks" ) {
+      rounds = 20;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) rounds = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-entities" ) {
+      entities = 10000;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) entities = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-blocks" ) {
+      blockTicks = 400;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) blockTicks = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-edits" ) {
+      editSize = 256;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) editSize = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-paths" ) {
+      pathQueries = 200;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) pathQueries = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-visibility" ) {
+      visibilityFrames = 2000;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) visibilityFrames = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-mesh-cache" ) {
+      meshSessions = 2;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) meshSessions = atoi(argv[++i]);
+    }
+    else if ( arg == "--bench-particles" ) {
+      particleCount = 100000;
+      if ( i+1 < argc && atoi(argv[i+1]) > 0 ) particleCount = atoi(argv[++i]);
+    }
+    else if ( arg == "--occlusion" ) {
+      occlusion = true;
+    }
+    else if ( arg == "--prepass" ) {
+      prepass = true;
+    }
+    else if ( arg == "--adaptive" ) {
+      adaptive = true;
+    }
+    else if ( arg == "--render-thread" ) {
+      threaded = true;
+    }
+    else if ( arg == "--frame-budget" && i+1 < argc ) {
+      frameBudget = atof( argv[++i] ) / 1000.0;
+    }
+    else if ( arg == "--memory-csv" && i+1 < argc ) {
+      memoryCsv = argv[++i];
+    }
+    else if ( arg == "--mesh-cache" && i+1 < argc ) {
+      meshCache = argv[++i];
+      meshCacheGiven = true;
+      if ( meshCache == "none" ) meshCache.clear();
+    }
+    else if ( arg == "--mesh-cache-mb" && i+1 < argc ) {
+      meshBudget = long( atof( argv[++i] ) * 1024.0 * 1024.0 );
+    }
+    else if ( arg == "--threads" && i+1 < argc ) {
+      threads = atoi( argv[++i] );
+    }
+    else if ( arg == "--renderer" && i+1 < argc ) {
+      renderer = World::rendererByName( argv[++i] );
+      if ( renderer < 0 ) {
+        cout << "unknown renderer: " << argv[i] << "\n";
+        return 1;
+      }
+    }
+  }
+
+  if ( rounds ) return benchChunks( rounds );
+  if ( entities ) return benchEntities( entities, threads );
+  if ( blockTicks ) return benchBlocks( blockTicks );
+  if ( editSize ) return benchEdits( editSize );
+  if ( pathQueries ) return benchPaths( pathQueries );
+  if ( particleCount ) return benchParticles( particleCount );
+  if ( visibilityFrames ) return benchVisibility( visibilityFrames );
+  if ( meshSessions )
+    return benchMeshCache( meshSessions, meshCacheGiven && !meshCache.empty() ?
+                           meshCache : string("openmine-bench-meshes.pack"), meshBudget );
+  if ( bench ) return benchRender( frames, renderer, occlusion, prepass, adaptive, frameBudget,
+                                   threaded, meshCache, meshBudget );
+
+  if ( !meshCacheGiven ) meshCache = MeshCache::defaultPath();
   App app;
-  app.run();
+  app.run( memoryCsv, frameBudget, meshCache, meshBudget );
   return (app.valid) ? 0 : 1;
 }
 
@@ -0,0 +1,70 @@
+// made by inny
+
+#include "util.h"
+#include "memstats.h"
+
+using namespace std;
+
+atomic<long long> MemoryStats::counters[COUNTERS];
+atomic<long long> MemoryStats::allocations( 0 );
+long long MemoryStats::frameStart = 0;
+long long MemoryStats::frameAllocations = 0;
+
+const char *MemoryStats::name( Counter c )
+{
+  switch (c) {
+    case CHUNK_VOXELS: return "chunk_voxels";
+    case MESH_SCRATCH: return "mesh_scratch";
+    case GL_LISTS: return "gl_lists";
+    case GL_BUFFERS: return "gl_buffers";
+    case LOAD_QUEUE: return "load_queue";
+    default: break;
+  }
+  return "unknown";
+}
+
+void MemoryStats::endFrame()
+{
+  const long long now = allocations;
+  frameAllocations = now - frameStart;
+  frameStart = now;
+}
+
+void MemoryStats::report( ostream &out )
+{
+  out << "MEMORY";
+  for ( int c = 0; c < COUNTERS; c++ ) {
+    out << " " << name( Counter(c) ) << ": ";
+    if ( c == LOAD_QUEUE )
+      out << get( Counter(c) );
+    else
+      out << get( Counter(c) ) / 1024 << "K";
+  }
+  out << " allocs/frame: " << frameAllocations << "\n";
+}
+
+// -----------------------------------------------------------------------------
+
+MemoryLog::MemoryLog( const string &path, double seconds )
+  : out( path.c_str() ), interval(seconds), started(::seconds()), next(started)
+{
+  if ( !out.is_open() ) return;
+
+  out << "seconds";
+  for ( int c = 0; c < MemoryStats::COUNTERS; c++ )
+    out << "," << MemoryStats::name( MemoryStats::Counter(c) );
+  out << ",allocs_per_frame\n";
+}
+
+void MemoryLog::update()
+{
+  const double now = ::seconds();
+  if ( !out.is_open() || now < next ) return;
+  next = now + interval;
+
+  out << now - started;
+  for ( int c = 0; c < MemoryStats::COUNTERS; c++ )
+    out << "," << MemoryStats::get( MemoryStats::Counter(c) );
+  out << "," << MemoryStats::lastFrameAllocations() << "\n";
+  out.flush();
+}
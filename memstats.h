@@ -0,0 +1,64 @@
+// made by inny
+
+#ifndef OPENMINE_MEMSTATS_H
+#define OPENMINE_MEMSTATS_H
+
+#include <atomic>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+// Live memory counters per subsystem. Owners add and subtract as they
+// allocate and free, so reading them is free. GL sizes are what we asked the
+// driver for (display lists are estimated from their face counts), not what
+// it really spent.
+class MemoryStats
+{
+  public:
+    enum Counter {
+      CHUNK_VOXELS,   // type and visibility arrays
+      MESH_SCRATCH,   // vertex data kept on the CPU for region uploads
+      GL_LISTS,       // display lists, 20 bytes per vertex
+      GL_BUFFERS,     // packed face and region vertex buffers
+      LOAD_QUEUE,     // chunks waiting to load, an entry count
+      COUNTERS
+    };
+
+  protected:
+    static std::atomic<long long> counters[COUNTERS];
+    static std::atomic<long long> allocations;
+    static long long frameStart;
+    static long long frameAllocations;
+
+  public:
+    static void add( Counter c, long long delta ) { counters[c] += delta; };
+    static void set( Counter c, long long value ) { counters[c] = value; };
+    static long long get( Counter c ) { return counters[c]; };
+    static const char *name( Counter c );
+
+    // every operator new bumps this, endFrame() turns it into a rate
+    static void countAllocation() { allocations++; };
+    static void endFrame();
+    static long long lastFrameAllocations() { return frameAllocations; };
+
+    static void report( std::ostream &out );
+};
+
+// -----------------------------------------------------------------------------
+
+// Appends a row of every counter to a CSV file every so often.
+class MemoryLog
+{
+  protected:
+    std::ofstream out;
+    double interval;
+    double started;
+    double next;
+
+  public:
+    MemoryLog( const std::string &path, double seconds = 1.0 );
+    bool isOpen() const { return out.is_open(); };
+    void update();
+};
+
+#endif
@@ -0,0 +1,260 @@
+// made by inny
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "meshcache.h"
+
+using namespace std;
+
+// the pack file: a header, an index entry per mesh, most recently used
+// first, then every mesh's records back to back. Written and read on the same machine,
+// so everything goes out in native byte order
+namespace {
+  const char MAGIC[4] = { 'O', 'M', 'M', 'C' };
+  const unsigned int FORMAT = 1;
+
+  struct Header
+  {
+    char magic[4];
+    unsigned int format;
+    unsigned int mesher;
+    unsigned int count;
+    unsigned long long clock;
+  };
+
+  struct Stored
+  {
+    unsigned long long key;
+    unsigned long long used;
+
+    // in records from the start of the data
+    unsigned int offset;
+    unsigned int total;
+    int counts[Voxel::DIRECTIONS];
+  };
+
+  bool writeAll( int fd, const void *data, size_t bytes )
+  {
+    const char *p = (const char*)data;
+    while ( bytes ) {
+      const ssize_t n = write( fd, p, bytes );
+      if ( n <= 0 ) return false;
+      p += n;
+      bytes -= n;
+    }
+    return true;
+  }
+}
+
+MeshCache::MeshCache( const string &file, long budgetBytes )
+  : path(file), budget(budgetBytes), held(sizeof(Header)), clock(0), map(0), mapSize(0),
+    hitCount(0), missCount(0), evictedCount(0), savedBytes(0)
+{
+  open();
+}
+
+MeshCache::~MeshCache()
+{
+  save();
+  close();
+}
+
+// a missing, short or foreign file is the same as an empty one
+void MeshCache::open()
+{
+  const int fd = ::open( path.c_str(), O_RDONLY );
+  if ( fd < 0 ) return;
+
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 || st.st_size < long(sizeof(Header)) ) {
+    ::close( fd );
+    return;
+  }
+  map = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  ::close( fd );
+  if ( map == MAP_FAILED ) {
+    map = 0;
+    return;
+  }
+  mapSize = st.st_size;
+  savedBytes = mapSize;
+
+  const Header *h = (const Header*)map;
+  const long indexBytes = long(sizeof(Header)) + long(h->count) * sizeof(Stored);
+  if ( memcmp( h->magic, MAGIC, 4 ) != 0 || h->format != FORMAT ||
+       h->mesher != MESHER_VERSION || indexBytes > mapSize ) {
+    close();
+    return;
+  }
+
+  const Stored *index = (const Stored*)( h + 1 );
+  const GLuint *data = (const GLuint*)( index + h->count );
+  const unsigned long records = ( mapSize - indexBytes ) / sizeof(GLuint);
+  clock = h->clock;
+  for ( unsigned int i = 0; i < h->count; i++ ) {
+    const Stored &s = index[i];
+    if ( (unsigned long)s.offset + s.total > records ) continue;
+
+    Entry &e = entries[s.key];
+    e.mesh.records = data + s.offset;
+    e.mesh.total = s.total;
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) e.mesh.counts[d] = s.counts[d];
+    e.used = s.used;
+    held += entryBytes( e.mesh );
+  }
+  trim();
+}
+
+void MeshCache::close()
+{
+  if (map) munmap( map, mapSize );
+  map = 0;
+  mapSize = 0;
+  entries.clear();
+  held = sizeof(Header);
+}
+
+long MeshCache::entryBytes( const Mesh &m )
+{
+  return sizeof(Stored) + long(m.total) * sizeof(GLuint);
+}
+
+// sorting for every store would cost more than it saves, so this goes down
+// to seven eighths of the budget and leaves the rest for a while
+void MeshCache::trim()
+{
+  if ( held <= budget ) return;
+
+  vector< pair<unsigned long long, unsigned long long> > order;
+  for ( EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it )
+    order.push_back( make_pair( it->second.used, it->first ) );
+  sort( order.begin(), order.end() );
+
+  const long target = budget - budget / 8;
+  for ( int i = 0; i < order.size() && held > target; i++ ) {
+    EntryMap::iterator gone = entries.find( order[i].second );
+    held -= entryBytes( gone->second.mesh );
+    entries.erase( gone );
+    evictedCount++;
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+bool MeshCache::find( unsigned long long key, Mesh &out )
+{
+  lock_guard<mutex> hold( lock );
+  EntryMap::iterator finder = entries.find( key );
+  if ( finder == entries.end() ) {
+    missCount++;
+    return false;
+  }
+  hitCount++;
+  finder->second.used = ++clock;
+  out = finder->second.mesh;
+  return true;
+}
+
+// two threads meshing the same thing both get the first one's copy
+void MeshCache::store( unsigned long long key, const vector<GLuint> &records,
+                       const int *counts, Mesh &out )
+{
+  lock_guard<mutex> hold( lock );
+  EntryMap::iterator finder = entries.find( key );
+  if ( finder == entries.end() ) {
+    Entry &e = entries[key];
+    e.mesh.fresh = make_shared< const vector<GLuint> >( records );
+    e.mesh.records = records.empty() ? 0 : &(*e.mesh.fresh)[0];
+    e.mesh.total = records.size();
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) e.mesh.counts[d] = counts[d];
+    e.used = ++clock;
+    held += entryBytes( e.mesh );
+    out = e.mesh;
+    trim();
+    return;
+  }
+  finder->second.used = ++clock;
+  out = finder->second.mesh;
+}
+
+// keeps the most recently used meshes that fit the budget, which after
+// trim() is all of them. The new file is written beside the old one and
+// renamed over it; the old one stays mapped, so meshes handed out already
+// stay good
+bool MeshCache::save()
+{
+  lock_guard<mutex> hold( lock );
+
+  vector< pair<unsigned long long, EntryMap::const_iterator> > order;
+  for ( EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it )
+    order.push_back( make_pair( it->second.used, it ) );
+  sort( order.begin(), order.end(),
+        []( const pair<unsigned long long, EntryMap::const_iterator> &a,
+            const pair<unsigned long long, EntryMap::const_iterator> &b ) { return a.first > b.first; } );
+
+  vector<Stored> index;
+  long bytes = sizeof(Header);
+  unsigned int offset = 0;
+  for ( int i = 0; i < order.size(); i++ ) {
+    const Mesh &m = order[i].second->second.mesh;
+    const long more = entryBytes( m );
+    if ( bytes + more > budget ) break;
+    bytes += more;
+
+    Stored s;
+    s.key = order[i].second->first;
+    s.used = order[i].first;
+    s.offset = offset;
+    s.total = m.total;
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) s.counts[d] = m.counts[d];
+    index.push_back( s );
+    offset += m.total;
+  }
+
+  Header h;
+  memcpy( h.magic, MAGIC, 4 );
+  h.format = FORMAT;
+  h.mesher = MESHER_VERSION;
+  h.count = index.size();
+  h.clock = clock;
+
+  const string temp = path + ".tmp";
+  const int fd = ::open( temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+  if ( fd < 0 ) return false;
+
+  bool ok = writeAll( fd, &h, sizeof(h) );
+  if ( ok && !index.empty() ) ok = writeAll( fd, &index[0], index.size() * sizeof(Stored) );
+  for ( int i = 0; ok && i < index.size(); i++ ) {
+    const Mesh &m = order[i].second->second.mesh;
+    if ( m.total ) ok = writeAll( fd, m.records, m.total * sizeof(GLuint) );
+  }
+  if ( ::close( fd ) != 0 ) ok = false;
+
+  if ( !ok || rename( temp.c_str(), path.c_str() ) != 0 ) {
+    unlink( temp.c_str() );
+    return false;
+  }
+  savedBytes = bytes;
+  return true;
+}
+
+string MeshCache::defaultPath()
+{
+  string dir;
+  const char *cache = getenv( "XDG_CACHE_HOME" );
+  const char *home = getenv( "HOME" );
+  if ( cache && *cache ) dir = cache;
+  else if ( home && *home ) dir = string(home) + "/.cache";
+  else return "openmine-meshes.pack";
+
+  mkdir( dir.c_str(), 0700 );
+  dir += "/openmine";
+  mkdir( dir.c_str(), 0755 );
+  return dir + "/meshes.pack";
+}
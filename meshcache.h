@@ -0,0 +1,94 @@
+// made by inny
+
+#ifndef OPENMINE_MESHCACHE_H
+#define OPENMINE_MESHCACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "opengl.h"
+#include "voxel.h"
+
+// Chunk meshes kept on disk between sessions, as packed face records (see
+// Voxel::pack) grouped by direction, keyed by Chunk::meshKey(). The pack
+// file is mapped read only when the cache opens, so a hit hands out a
+// pointer straight into the file that can go to glBufferData as it is.
+// Meshes made this session are held in memory until save(), which writes
+// them to a new file and swaps it in. Past the byte budget the least
+// recently used entries are dropped, in memory as well as on disk. Any
+// thread may find() and store().
+class MeshCache
+{
+  public:
+    // bump whenever culling or Voxel::pack changes what comes out
+    static const unsigned int MESHER_VERSION = 1;
+
+    struct Mesh
+    {
+      const GLuint *records;
+      int counts[Voxel::DIRECTIONS];
+      int total;
+
+      // records made this session, kept alive for whoever holds a copy after
+      // the cache drops them; empty when they live in the mapped file
+      std::shared_ptr< const std::vector<GLuint> > fresh;
+    };
+
+  protected:
+    struct Entry
+    {
+      Mesh mesh;
+      unsigned long long used;
+    };
+
+    std::string path;
+    long budget;
+
+    // what the entries would take in the file, header included
+    long held;
+    std::mutex lock;
+    typedef std::unordered_map<unsigned long long, Entry> EntryMap;
+    EntryMap entries;
+    unsigned long long clock;
+
+    void *map;
+    long mapSize;
+
+    int hitCount;
+    int missCount;
+    int evictedCount;
+    long savedBytes;
+
+    void open();
+    void close();
+    static long entryBytes( const Mesh &m );
+
+    // drops least recently used entries until well under the budget
+    void trim();
+
+  public:
+    MeshCache( const std::string &file, long budgetBytes );
+    virtual ~MeshCache();
+
+    // false on a miss; the records stay good until the cache goes, or for
+    // as long as out.fresh is held
+    bool find( unsigned long long key, Mesh &out );
+    void store( unsigned long long key, const std::vector<GLuint> &records,
+                const int *counts, Mesh &out );
+
+    // false if the file couldn't be written; called by the destructor too
+    bool save();
+
+    // the game's pack file, under $XDG_CACHE_HOME or ~/.cache
+    static std::string defaultPath();
+
+    int hits() const { return hitCount; };
+    int misses() const { return missCount; };
+    int evicted() const { return evictedCount; };
+    int size() const { return entries.size(); };
+    long fileBytes() const { return savedBytes; };
+};
+
+#endif
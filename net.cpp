@@ -0,0 +1,255 @@
+// made by inny
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "net.h"
+
+using namespace std;
+
+MessageWriter::MessageWriter( vector<unsigned char> &buffer, int type )
+  : out(buffer), start(buffer.size())
+{
+  putU32( 0 );
+  putU8( type );
+}
+
+void MessageWriter::finish()
+{
+  const uint32_t length = out.size() - start - 4;
+  for ( int i = 0; i < 4; i++ )
+    out[start+i] = (length >> (i*8)) & 0xFF;
+}
+
+void MessageWriter::putU16( uint16_t v )
+{
+  out.push_back( v & 0xFF );
+  out.push_back( v >> 8 );
+}
+
+void MessageWriter::putU32( uint32_t v )
+{
+  for ( int i = 0; i < 4; i++ )
+    out.push_back( (v >> (i*8)) & 0xFF );
+}
+
+void MessageWriter::putF32( float v )
+{
+  uint32_t bits;
+  memcpy( &bits, &v, sizeof(bits) );
+  putU32( bits );
+}
+
+// -----------------------------------------------------------------------------
+
+bool MessageReader::need( size_t n )
+{
+  if ( good && size_t(end - p) < n ) good = false;
+  return good;
+}
+
+uint8_t MessageReader::getU8()
+{
+  if (!need(1)) return 0;
+  return *p++;
+}
+
+uint16_t MessageReader::getU16()
+{
+  if (!need(2)) return 0;
+  uint16_t v = p[0] | (p[1] << 8);
+  p += 2;
+  return v;
+}
+
+uint32_t MessageReader::getU32()
+{
+  if (!need(4)) return 0;
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+  p += 4;
+  return v;
+}
+
+float MessageReader::getF32()
+{
+  uint32_t bits = getU32();
+  float v;
+  memcpy( &v, &bits, sizeof(v) );
+  return v;
+}
+
+// -----------------------------------------------------------------------------
+
+void rleEncode( const unsigned short *types, int count, MessageWriter &out )
+{
+  int i = 0;
+  while ( i < count ) {
+    int run = 1;
+    while ( i+run < count && run < 0xFFFF && types[i+run] == types[i] ) run++;
+    out.putU16( run );
+    out.putU16( types[i] );
+    i += run;
+  }
+}
+
+bool rleDecode( MessageReader &in, unsigned short *types, int count )
+{
+  int i = 0;
+  while ( i < count && in.ok() ) {
+    const int run = in.getU16();
+    const unsigned short type = in.getU16();
+    if ( run == 0 || i+run > count ) return false;
+    for ( int j = 0; j < run; j++ ) types[i++] = type;
+  }
+  return in.ok() && i == count;
+}
+
+// -----------------------------------------------------------------------------
+
+Connection::Connection( int socket )
+  : fd(socket), readPos(0), writePos(0), closed(false), bytesIn(0), bytesOut(0)
+{
+  fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+  int one = 1;
+  setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+}
+
+Connection::~Connection()
+{
+  close();
+}
+
+void Connection::close()
+{
+  if ( fd >= 0 ) ::close( fd );
+  fd = -1;
+  closed = true;
+}
+
+bool Connection::receive()
+{
+  if (closed) return false;
+
+  // drop whatever nextMessage() has already handed out
+  if ( readPos > 0 ) {
+    inbox.erase( inbox.begin(), inbox.begin() + readPos );
+    readPos = 0;
+  }
+
+  unsigned char chunk[16384];
+  while (true) {
+    ssize_t n = recv( fd, chunk, sizeof(chunk), 0 );
+    if ( n > 0 ) {
+      inbox.insert( inbox.end(), chunk, chunk+n );
+      bytesIn += n;
+      continue;
+    }
+    if ( n == 0 ) { close(); return false; }
+    if ( errno == EINTR ) continue;
+    if ( errno == EAGAIN || errno == EWOULDBLOCK ) return true;
+    close();
+    return false;
+  }
+}
+
+bool Connection::flush()
+{
+  if (closed) return false;
+
+  while ( writePos < outbox.size() ) {
+    ssize_t n = send( fd, &outbox[writePos], outbox.size() - writePos, MSG_NOSIGNAL );
+    if ( n > 0 ) {
+      writePos += n;
+      bytesOut += n;
+      continue;
+    }
+    if ( n < 0 && errno == EINTR ) continue;
+    if ( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ) break;
+    close();
+    return false;
+  }
+
+  if ( writePos == outbox.size() ) {
+    outbox.clear();
+    writePos = 0;
+  }
+  else if ( writePos > 65536 ) {
+    outbox.erase( outbox.begin(), outbox.begin() + writePos );
+    writePos = 0;
+  }
+  return true;
+}
+
+bool Connection::nextMessage( int &type, const unsigned char *&payload, size_t &length )
+{
+  if ( inbox.size() - readPos < 5 ) return false;
+
+  const unsigned char *p = &inbox[readPos];
+  const uint32_t size = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+  if ( size < 1 || size > MAX_MESSAGE ) {
+    close();
+    return false;
+  }
+  if ( inbox.size() - readPos < 4 + size ) return false;
+
+  type = p[4];
+  payload = p + 5;
+  length = size - 1;
+  readPos += 4 + size;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+
+int listenTcp( int port )
+{
+  int fd = ::socket( AF_INET, SOCK_STREAM, 0 );
+  if ( fd < 0 ) return -1;
+
+  int one = 1;
+  setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one) );
+
+  sockaddr_in addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( port );
+  addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+  if ( bind( fd, (sockaddr*)&addr, sizeof(addr) ) < 0 || listen( fd, SOMAXCONN ) < 0 ) {
+    ::close( fd );
+    return -1;
+  }
+  fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+  return fd;
+}
+
+int acceptTcp( int listener )
+{
+  return accept( listener, 0, 0 );
+}
+
+int connectTcp( const string &host, int port )
+{
+  addrinfo hints, *found = 0;
+  memset( &hints, 0, sizeof(hints) );
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  char service[16];
+  snprintf( service, sizeof(service), "%d", port );
+  if ( getaddrinfo( host.c_str(), service, &hints, &found ) != 0 ) return -1;
+
+  int fd = ::socket( found->ai_family, found->ai_socktype, found->ai_protocol );
+  if ( fd >= 0 && connect( fd, found->ai_addr, found->ai_addrlen ) < 0 ) {
+    ::close( fd );
+    fd = -1;
+  }
+  freeaddrinfo( found );
+  return fd;
+}
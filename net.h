@@ -0,0 +1,111 @@
+// made by inny
+
+#ifndef OPENMINE_NET_H
+#define OPENMINE_NET_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Wire format shared by openmine_server and its clients. Every message is
+// a little endian u32 length (covering type and payload), a u8 type, then
+// the payload.
+enum MessageType
+{
+  MSG_POSITION = 1,   // client: f32 x, y, z
+  MSG_EDIT,           // client: i32 x, y, z, u16 type
+  MSG_CHUNK,          // server: i32 x, y, z, rle types
+  MSG_DELTA,          // server: u16 chunks, per chunk i32 x, y, z, u16 n, n * (u16 cell, u16 type)
+  MSG_UNLOAD,         // server: i32 x, y, z
+  MSG_STATS           // server: f32 avg tick ms, f32 worst tick ms, u32 clients
+};
+
+static const int DEFAULT_PORT = 7373;
+static const int MAX_MESSAGE = 1 << 20;
+
+// -----------------------------------------------------------------------------
+
+class MessageWriter
+{
+  protected:
+    std::vector<unsigned char> &out;
+    size_t start;
+
+  public:
+    // starts a message at the end of out, finish() patches its length
+    MessageWriter( std::vector<unsigned char> &buffer, int type );
+    void finish();
+
+    void putU8( uint8_t v ) { out.push_back(v); };
+    void putU16( uint16_t v );
+    void putU32( uint32_t v );
+    void putI32( int32_t v ) { putU32( uint32_t(v) ); };
+    void putF32( float v );
+    size_t size() const { return out.size() - start; };
+};
+
+class MessageReader
+{
+  protected:
+    const unsigned char *p;
+    const unsigned char *end;
+    bool good;
+
+    bool need( size_t n );
+
+  public:
+    MessageReader( const unsigned char *data, size_t length )
+      : p(data), end(data+length), good(true) { /* */ };
+
+    uint8_t getU8();
+    uint16_t getU16();
+    uint32_t getU32();
+    int32_t getI32() { return int32_t( getU32() ); };
+    float getF32();
+    bool ok() const { return good; };
+    size_t left() const { return end - p; };
+};
+
+// run length coding for chunk type arrays, runs of (u16 count, u16 type)
+void rleEncode( const unsigned short *types, int count, MessageWriter &out );
+bool rleDecode( MessageReader &in, unsigned short *types, int count );
+
+// -----------------------------------------------------------------------------
+
+// A non-blocking TCP stream with buffered input and output.
+class Connection
+{
+  protected:
+    int fd;
+    std::vector<unsigned char> inbox;
+    size_t readPos;
+    std::vector<unsigned char> outbox;
+    size_t writePos;
+    bool closed;
+
+  public:
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+
+    Connection( int socket );
+    virtual ~Connection();
+
+    int socket() const { return fd; };
+    bool isClosed() const { return closed; };
+    void close();
+
+    // outgoing messages are built straight into this buffer
+    std::vector<unsigned char> &output() { return outbox; };
+    size_t pending() const { return outbox.size() - writePos; };
+
+    bool receive();
+    bool flush();
+    // the payload stays valid until the next receive()
+    bool nextMessage( int &type, const unsigned char *&payload, size_t &length );
+};
+
+int listenTcp( int port );
+int acceptTcp( int listener );
+int connectTcp( const std::string &host, int port );
+
+#endif
@@ -0,0 +1,42 @@
+// made by inny
+
+#include <cstdlib>
+#include <new>
+#include "memstats.h"
+
+using namespace std;
+
+// counting every heap allocation is the only way to see per-frame churn;
+// only the game links this, the server and tools keep the plain allocator
+void *operator new( size_t size )
+{
+  MemoryStats::countAllocation();
+  void *p = malloc( size ? size : 1 );
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void *operator new[]( size_t size )
+{
+  return operator new( size );
+}
+
+void operator delete( void *p ) noexcept
+{
+  free( p );
+}
+
+void operator delete[]( void *p ) noexcept
+{
+  free( p );
+}
+
+void operator delete( void *p, size_t ) noexcept
+{
+  free( p );
+}
+
+void operator delete[]( void *p, size_t ) noexcept
+{
+  free( p );
+}
@@ -0,0 +1,131 @@
+// made by inny
+
+#include <iostream>
+#include "SDL.h"
+#include "offscreen.h"
+
+using namespace std;
+
+OffscreenContext::OffscreenContext( int width, int height )
+  : valid(false)
+{
+#if defined(HAVE_EGL)
+  // surfaceless mesa lets llvmpipe run without any display server
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay)
+    display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0 );
+  if (display == EGL_NO_DISPLAY)
+    display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+  EGLint major, minor;
+  if ( display == EGL_NO_DISPLAY || !eglInitialize( display, &major, &minor ) ) {
+    cout << "eglInitialize: " << eglGetError() << "\n";
+    return;
+  }
+  eglBindAPI( EGL_OPENGL_API );
+
+  const EGLint attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config = 0;
+  EGLint configs = 0;
+  eglChooseConfig( display, attribs, &config, 1, &configs );
+
+  context = eglCreateContext( display, configs ? config : 0, EGL_NO_CONTEXT, 0 );
+  if ( context == EGL_NO_CONTEXT ) {
+    cout << "eglCreateContext: " << eglGetError() << "\n";
+    return;
+  }
+  valid = eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context );
+#elif defined(HAVE_OSMESA)
+  context = OSMesaCreateContextExt( OSMESA_RGBA, 16, 0, 0, 0 );
+  if (!context) {
+    cout << "OSMesaCreateContext failed\n";
+    return;
+  }
+  buffer.resize( width * height * 4 );
+  valid = OSMesaMakeCurrent( context, &buffer[0], GL_UNSIGNED_BYTE, width, height );
+#else
+  // no headless GL available, fall back on a plain window that isn't grabbed
+  sdlStarted = (SDL_Init(SDL_INIT_VIDEO) >= 0);
+  if (!sdlStarted) return;
+  SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
+  valid = (SDL_SetVideoMode( width, height, 32, SDL_OPENGL ) != 0);
+#endif
+}
+
+OffscreenContext::~OffscreenContext()
+{
+#if defined(HAVE_EGL)
+  if ( context != EGL_NO_CONTEXT ) {
+    eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+    eglDestroyContext( display, context );
+  }
+  if ( display != EGL_NO_DISPLAY ) eglTerminate( display );
+#elif defined(HAVE_OSMESA)
+  if (context) OSMesaDestroyContext( context );
+#else
+  if (sdlStarted) SDL_Quit();
+#endif
+}
+
+const char *OffscreenContext::name() const
+{
+#if defined(HAVE_EGL)
+  return "egl";
+#elif defined(HAVE_OSMESA)
+  return "osmesa";
+#else
+  return "sdl";
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+Framebuffer::Framebuffer( int width, int height )
+  : fbo(0), color(0), depth(0), valid(false)
+{
+  glGenFramebuffersEXT( 1, &fbo );
+  glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, fbo );
+
+  glGenRenderbuffersEXT( 1, &color );
+  glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, color );
+  glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_RGBA8, width, height );
+  glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                                GL_RENDERBUFFER_EXT, color );
+
+  glGenRenderbuffersEXT( 1, &depth );
+  glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, depth );
+  glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT16, width, height );
+  glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+                                GL_RENDERBUFFER_EXT, depth );
+
+  GLenum status = glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT );
+  valid = ( status == GL_FRAMEBUFFER_COMPLETE_EXT );
+  if (!valid) cout << "glCheckFramebufferStatus: " << status << "\n";
+
+  glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0 );
+}
+
+Framebuffer::~Framebuffer()
+{
+  glDeleteRenderbuffersEXT( 1, &depth );
+  glDeleteRenderbuffersEXT( 1, &color );
+  glDeleteFramebuffersEXT( 1, &fbo );
+}
+
+void Framebuffer::bind()
+{
+  glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, fbo );
+}
+
+void Framebuffer::unbind()
+{
+  glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0 );
+}
@@ -0,0 +1,55 @@
+// made by inny
+
+#ifndef OPENMINE_OFFSCREEN_H
+#define OPENMINE_OFFSCREEN_H
+
+#include <vector>
+#include "opengl.h"
+
+#if defined(HAVE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HAVE_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+class OffscreenContext
+{
+  protected:
+    bool valid;
+#if defined(HAVE_EGL)
+    EGLDisplay display;
+    EGLContext context;
+#elif defined(HAVE_OSMESA)
+    OSMesaContext context;
+    std::vector<GLubyte> buffer;
+#else
+    bool sdlStarted;
+#endif
+
+  public:
+    OffscreenContext( int width, int height );
+    ~OffscreenContext();
+    bool isValid() const { return valid; };
+    const char *name() const;
+};
+
+// -----------------------------------------------------------------------------
+
+class Framebuffer
+{
+  protected:
+    GLuint fbo;
+    GLuint color;
+    GLuint depth;
+    bool valid;
+
+  public:
+    Framebuffer( int width, int height );
+    ~Framebuffer();
+    bool isValid() const { return valid; };
+    void bind();
+    void unbind();
+};
+
+#endif
@@ -0,0 +1,12 @@
+// made by inny
+
+#ifndef OPENMINE_OPENGL_H
+#define OPENMINE_OPENGL_H
+
+// everything past GL 1.1 comes from glext prototypes, which the Linux
+// libGL exports directly
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#endif
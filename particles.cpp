@@ -0,0 +1,416 @@
+// made by inny
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "util.h"
+#include "camera.h"
+#include "memstats.h"
+#include "voxel.h"
+#include "world.h"
+#include "particles.h"
+
+using namespace std;
+
+namespace {
+  struct KindInfo
+  {
+    // seconds, give or take the spread
+    float life;
+    float lifeSpread;
+
+    // thrown out this fast in any direction, and this much more upwards
+    float speed;
+    float lift;
+
+    // how hard gravity pulls, and half the quad's edge
+    float weight;
+    float size;
+
+    int tile;
+  };
+
+  const KindInfo kinds[ParticleSystem::KINDS] = {
+    { 0.8, 0.6, 2.5, 3.0, 1.0, 0.06, Voxel::SIDE },   // BREAK
+    { 4.0, 2.0, 0.3, 0.0, 0.02, 0.03, Voxel::TOP }     // AMBIENT
+  };
+
+  // particles show a 4x4 corner of their block's 16x16 tile
+  const float SPECK = 4.0;
+}
+
+ParticleSystem::ParticleSystem( World &w )
+  : world(w), count(0), seed(2463534242u), simd(true),
+    px(CAPACITY), py(CAPACITY), pz(CAPACITY),
+    vx(CAPACITY), vy(CAPACITY), vz(CAPACITY),
+    life(CAPACITY), weight(CAPACITY), size(CAPACITY),
+    tu(CAPACITY), tv(CAPACITY),
+    cx(CAPACITY), cy(CAPACITY), cz(CAPACITY), moved(CAPACITY),
+    freeEmitter(0)
+{
+  for ( int i = 0; i < EMITTERS; i++ ) {
+    emitters[i].live = false;
+    emitters[i].next = i+1 < EMITTERS ? i+1 : -1;
+  }
+}
+
+// xorshift, -1 to 1
+float ParticleSystem::random()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return float(seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+int ParticleSystem::emit( int kind, float x, float y, float z, float spread, int particles, float rate )
+{
+  if ( freeEmitter < 0 || kind < 0 || kind >= KINDS ) return -1;
+  if ( particles < 0 && rate <= 0.0 ) return -1;
+
+  const int i = freeEmitter;
+  Emitter &e = emitters[i];
+  freeEmitter = e.next;
+  e.kind = kind;
+  e.x = x; e.y = y; e.z = z;
+  e.spread = spread;
+  e.rate = rate;
+  e.owed = 0.0;
+  e.left = particles;
+  e.live = true;
+  return i;
+}
+
+void ParticleSystem::moveEmitter( int e, float x, float y, float z )
+{
+  if ( e < 0 || e >= EMITTERS || !emitters[e].live ) return;
+  emitters[e].x = x;
+  emitters[e].y = y;
+  emitters[e].z = z;
+}
+
+void ParticleSystem::stopEmitter( int e )
+{
+  if ( e < 0 || e >= EMITTERS || !emitters[e].live ) return;
+  emitters[e].live = false;
+  emitters[e].next = freeEmitter;
+  freeEmitter = e;
+}
+
+int ParticleSystem::burst( int x, int y, int z, int particles )
+{
+  return emit( BREAK, x + 0.5, y + 0.5, z + 0.5, 0.4, particles, 0.0 );
+}
+
+int ParticleSystem::activeEmitters() const
+{
+  int n = 0;
+  for ( int i = 0; i < EMITTERS; i++ ) n += emitters[i].live;
+  return n;
+}
+
+// -----------------------------------------------------------------------------
+
+int ParticleSystem::spawn( const Emitter &e, int n )
+{
+  const KindInfo &k = kinds[e.kind];
+  const Point &t = Voxel::tiles[k.tile];
+  n = min( n, CAPACITY - count );
+
+  for ( int j = 0; j < n; j++ ) {
+    const int i = count++;
+    px[i] = e.x + e.spread * random();
+    py[i] = e.y + e.spread * random();
+    pz[i] = e.z + e.spread * random();
+    vx[i] = k.speed * random();
+    vy[i] = k.speed * random() + k.lift;
+    vz[i] = k.speed * random();
+    life[i] = k.life + k.lifeSpread * random();
+    weight[i] = k.weight;
+    size[i] = k.size;
+
+    // no cell yet, so the first step always checks
+    cx[i] = cy[i] = cz[i] = INT_MIN;
+
+    const int corner = (seed >> 4) & 15;
+    tu[i] = ( t.x + (corner & 3) * SPECK ) / 256.0;
+    tv[i] = ( t.y + (corner >> 2) * SPECK ) / 256.0;
+  }
+  return n;
+}
+
+void ParticleSystem::step( float dt )
+{
+  stats = Stats();
+
+  for ( int i = 0; i < EMITTERS; i++ ) {
+    Emitter &e = emitters[i];
+    if ( !e.live ) continue;
+
+    int n;
+    if ( e.rate > 0.0 ) {
+      e.owed += e.rate * dt;
+      n = int( e.owed );
+      e.owed -= n;
+    }
+    else n = e.left;
+    if ( e.left >= 0 ) n = min( n, e.left );
+
+    // a full pool drops what didn't fit rather than holding the emitter up
+    stats.emitted += spawn( e, n );
+    if ( e.left >= 0 ) {
+      e.left -= n;
+      if ( e.left == 0 ) stopEmitter( i );
+    }
+  }
+
+  double start = seconds();
+  integrate( dt );
+  stats.integrate = seconds() - start;
+
+  start = seconds();
+  collide( dt );
+  compact();
+  stats.collide = seconds() - start;
+}
+
+#if defined(__SSE2__) && !defined(__AVX__)
+// truncating rounds negatives up, take one off where it did
+static inline __m128i floorInt( __m128 v )
+{
+  const __m128i t = _mm_cvttps_epi32( v );
+  return _mm_add_epi32( t, _mm_castps_si128( _mm_cmpgt_ps( _mm_cvtepi32_ps( t ), v ) ) );
+}
+#endif
+
+// falls, moves and ages everything, and notes the cell each particle ends
+// up in and whether that's a new one. The vector loop runs past count to
+// the next whole group; the arrays are CAPACITY long and nothing reads
+// those slots
+void ParticleSystem::integrate( float dt )
+{
+  int i = 0;
+#if defined(__AVX__)
+  if (simd) {
+    const __m256 step = _mm256_set1_ps( dt );
+    const __m256 fall = _mm256_set1_ps( -GRAVITY * dt );
+    for ( ; i < count; i += 8 ) {
+      const __m256 v = _mm256_add_ps( _mm256_loadu_ps( &vy[i] ),
+                                      _mm256_mul_ps( fall, _mm256_loadu_ps( &weight[i] ) ) );
+      _mm256_storeu_ps( &vy[i], v );
+
+      const __m256 x = _mm256_add_ps( _mm256_loadu_ps( &px[i] ), _mm256_mul_ps( _mm256_loadu_ps( &vx[i] ), step ) );
+      const __m256 y = _mm256_add_ps( _mm256_loadu_ps( &py[i] ), _mm256_mul_ps( v, step ) );
+      const __m256 z = _mm256_add_ps( _mm256_loadu_ps( &pz[i] ), _mm256_mul_ps( _mm256_loadu_ps( &vz[i] ), step ) );
+      _mm256_storeu_ps( &px[i], x );
+      _mm256_storeu_ps( &py[i], y );
+      _mm256_storeu_ps( &pz[i], z );
+      _mm256_storeu_ps( &life[i], _mm256_sub_ps( _mm256_loadu_ps( &life[i] ), step ) );
+
+      // compared as floats, AVX has no wide integer ops
+      const __m256 fx = _mm256_floor_ps( x ), fy = _mm256_floor_ps( y ), fz = _mm256_floor_ps( z );
+      __m256 m = _mm256_cmp_ps( fx, _mm256_cvtepi32_ps( _mm256_loadu_si256( (__m256i*)&cx[i] ) ), _CMP_NEQ_UQ );
+      m = _mm256_or_ps( m, _mm256_cmp_ps( fy, _mm256_cvtepi32_ps( _mm256_loadu_si256( (__m256i*)&cy[i] ) ), _CMP_NEQ_UQ ) );
+      m = _mm256_or_ps( m, _mm256_cmp_ps( fz, _mm256_cvtepi32_ps( _mm256_loadu_si256( (__m256i*)&cz[i] ) ), _CMP_NEQ_UQ ) );
+      _mm256_storeu_si256( (__m256i*)&moved[i], _mm256_castps_si256( m ) );
+      _mm256_storeu_si256( (__m256i*)&cx[i], _mm256_cvttps_epi32( fx ) );
+      _mm256_storeu_si256( (__m256i*)&cy[i], _mm256_cvttps_epi32( fy ) );
+      _mm256_storeu_si256( (__m256i*)&cz[i], _mm256_cvttps_epi32( fz ) );
+    }
+    return;
+  }
+#elif defined(__SSE2__)
+  if (simd) {
+    const __m128 step = _mm_set1_ps( dt );
+    const __m128 fall = _mm_set1_ps( -GRAVITY * dt );
+    for ( ; i < count; i += 4 ) {
+      const __m128 v = _mm_add_ps( _mm_loadu_ps( &vy[i] ), _mm_mul_ps( fall, _mm_loadu_ps( &weight[i] ) ) );
+      _mm_storeu_ps( &vy[i], v );
+
+      const __m128 x = _mm_add_ps( _mm_loadu_ps( &px[i] ), _mm_mul_ps( _mm_loadu_ps( &vx[i] ), step ) );
+      const __m128 y = _mm_add_ps( _mm_loadu_ps( &py[i] ), _mm_mul_ps( v, step ) );
+      const __m128 z = _mm_add_ps( _mm_loadu_ps( &pz[i] ), _mm_mul_ps( _mm_loadu_ps( &vz[i] ), step ) );
+      _mm_storeu_ps( &px[i], x );
+      _mm_storeu_ps( &py[i], y );
+      _mm_storeu_ps( &pz[i], z );
+      _mm_storeu_ps( &life[i], _mm_sub_ps( _mm_loadu_ps( &life[i] ), step ) );
+
+      const __m128i nx = floorInt( x ), ny = floorInt( y ), nz = floorInt( z );
+      __m128i m = _mm_xor_si128( nx, _mm_loadu_si128( (__m128i*)&cx[i] ) );
+      m = _mm_or_si128( m, _mm_xor_si128( ny, _mm_loadu_si128( (__m128i*)&cy[i] ) ) );
+      m = _mm_or_si128( m, _mm_xor_si128( nz, _mm_loadu_si128( (__m128i*)&cz[i] ) ) );
+      _mm_storeu_si128( (__m128i*)&moved[i], m );
+      _mm_storeu_si128( (__m128i*)&cx[i], nx );
+      _mm_storeu_si128( (__m128i*)&cy[i], ny );
+      _mm_storeu_si128( (__m128i*)&cz[i], nz );
+    }
+    return;
+  }
+#endif
+  integrateScalar( i, dt );
+}
+
+void ParticleSystem::integrateScalar( int begin, float dt )
+{
+  for ( int i = begin; i < count; i++ ) {
+    vy[i] -= GRAVITY * dt * weight[i];
+    px[i] += vx[i] * dt;
+    py[i] += vy[i] * dt;
+    pz[i] += vz[i] * dt;
+    life[i] -= dt;
+    const int x = int( floor( px[i] ) ), y = int( floor( py[i] ) ), z = int( floor( pz[i] ) );
+    moved[i] = (x != cx[i]) | (y != cy[i]) | (z != cz[i]);
+    cx[i] = x;
+    cy[i] = y;
+    cz[i] = z;
+  }
+}
+
+// anything that moved into a solid cell goes back where it was, bouncing off
+// a little and losing most of its slide. Ones still in the cell they were
+// in last step were let stay there then and aren't looked at again, so a
+// block put down over a particle only stops it once it moves
+void ParticleSystem::collide( float dt )
+{
+  // the chunks found this step, by where they are; a slot holds whichever
+  // chunk last hashed to it, and chunks the world hasn't got are kept too
+  struct Seen { int x, y, z; Chunk *chunk; };
+  Seen seen[LOOKUPS];
+  for ( int j = 0; j < LOOKUPS; j++ ) seen[j].x = 1;
+
+  for ( int i = 0; i < count; i++ ) {
+    if ( !moved[i] ) continue;
+    const int x = cx[i], y = cy[i], z = cz[i];
+    const int cellX = x & ~Chunk::XMASK, cellY = y & ~Chunk::YMASK, cellZ = z & ~Chunk::ZMASK;
+    const unsigned int h = ( unsigned(cellX) * 73856093u ^ unsigned(cellY) * 19349663u ^
+                             unsigned(cellZ) * 83492791u ) >> 5;
+    Seen &s = seen[ h & (LOOKUPS-1) ];
+    if ( s.x != cellX || s.y != cellY || s.z != cellZ ) {
+      s.x = cellX; s.y = cellY; s.z = cellZ;
+      s.chunk = world.chunkAt( cellX, cellY, cellZ );
+      stats.lookups++;
+    }
+    Chunk *chunk = s.chunk;
+    if (!chunk) continue;
+
+    const unsigned short t = chunk->typeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK );
+    if ( t == Voxel::AIR || Voxel::isWater( t ) ) continue;
+
+    px[i] -= vx[i] * dt;
+    py[i] -= vy[i] * dt;
+    pz[i] -= vz[i] * dt;
+    cx[i] = int( floor( px[i] ) );
+    cy[i] = int( floor( py[i] ) );
+    cz[i] = int( floor( pz[i] ) );
+    vx[i] *= 0.5;
+    vy[i] *= -0.3;
+    vz[i] *= 0.5;
+    stats.collided++;
+  }
+}
+
+void ParticleSystem::moveSlot( int to, int from )
+{
+  px[to] = px[from]; py[to] = py[from]; pz[to] = pz[from];
+  vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+  life[to] = life[from];
+  weight[to] = weight[from];
+  size[to] = size[from];
+  tu[to] = tu[from];
+  tv[to] = tv[from];
+  cx[to] = cx[from]; cy[to] = cy[from]; cz[to] = cz[from];
+}
+
+// the last live particle fills each dead one's slot
+void ParticleSystem::compact()
+{
+  int i = 0;
+  while ( i < count ) {
+    if ( life[i] > 0.0 ) {
+      i++;
+      continue;
+    }
+    count--;
+    if ( i < count ) moveSlot( i, count );
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void ParticleSystem::record( const Camera &camera, vector<float> &quads ) const
+{
+  if ( count == 0 ) return;
+
+  // the rows of the eye's rotation are its right, up and back in the world
+  float m[16];
+  camera.modelview( m );
+  const float rx = m[0], ry = m[4], rz = m[8];
+  const float ux = m[1], uy = m[5], uz = m[9];
+  const float fx = -m[2], fy = -m[6], fz = -m[10];
+  const float ex = camera.x(), ey = camera.y(), ez = camera.z();
+  const float far = camera.viewDistance();
+  const float span = (SPECK - 0.01) / 256.0;
+
+  // appended a quad at a time, so a packet's buffer that's big enough from
+  // last frame isn't cleared first
+  quads.reserve( quads.size() + size_t(count) * 20 );
+  float v[20];
+  for ( int i = 0; i < count; i++ ) {
+    const float depth = (px[i] - ex) * fx + (py[i] - ey) * fy + (pz[i] - ez) * fz;
+    if ( depth <= 0.0 || depth > far ) continue;
+
+    // corners at -r-u, +r-u, +r+u, -r+u
+    const float s = size[i];
+    const float ax = (rx - ux) * s, ay = (ry - uy) * s, az = (rz - uz) * s;
+    const float bx = (rx + ux) * s, by = (ry + uy) * s, bz = (rz + uz) * s;
+    const float u0 = tu[i], u1 = tu[i] + span;
+    const float v0 = tv[i], v1 = tv[i] + span;
+    v[ 0] = u0; v[ 1] = v1; v[ 2] = px[i] - bx; v[ 3] = py[i] - by; v[ 4] = pz[i] - bz;
+    v[ 5] = u1; v[ 6] = v1; v[ 7] = px[i] + ax; v[ 8] = py[i] + ay; v[ 9] = pz[i] + az;
+    v[10] = u1; v[11] = v0; v[12] = px[i] + bx; v[13] = py[i] + by; v[14] = pz[i] + bz;
+    v[15] = u0; v[16] = v0; v[17] = px[i] - ax; v[18] = py[i] - ay; v[19] = pz[i] - az;
+    quads.insert( quads.end(), v, v + 20 );
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+ParticleBatch::ParticleBatch()
+  : buffer(0), capacity(0)
+{
+  /* */
+}
+
+ParticleBatch::~ParticleBatch()
+{
+  if (buffer) glDeleteBuffers( 1, &buffer );
+  MemoryStats::add( MemoryStats::GL_BUFFERS, -capacity );
+}
+
+void ParticleBatch::draw( const vector<float> &quads, RenderStats &stats )
+{
+  if ( quads.empty() ) return;
+
+  if (!buffer) glGenBuffers( 1, &buffer );
+  glBindBuffer( GL_ARRAY_BUFFER, buffer );
+
+  // a new store every frame, so the driver needn't wait for last frame's
+  // draw to finish with the old one
+  const long bytes = quads.size() * sizeof(float);
+  if ( bytes > capacity ) {
+    MemoryStats::add( MemoryStats::GL_BUFFERS, bytes - capacity );
+    capacity = bytes;
+  }
+  glBufferData( GL_ARRAY_BUFFER, capacity, 0, GL_STREAM_DRAW );
+  glBufferSubData( GL_ARRAY_BUFFER, 0, bytes, &quads[0] );
+
+  glInterleavedArrays( GL_T2F_V3F, 0, 0 );
+  glDrawArrays( GL_QUADS, 0, quads.size() / 5 );
+
+  stats.drawCalls++;
+  stats.vertices += quads.size() / 5;
+  stats.particles += quads.size() / 20;
+}
@@ -0,0 +1,143 @@
+// made by inny
+
+#ifndef OPENMINE_PARTICLES_H
+#define OPENMINE_PARTICLES_H
+
+#include <vector>
+#include "opengl.h"
+
+class World;
+class Camera;
+struct RenderStats;
+
+// Crumbs off broken blocks and dust drifting in the air, kept as parallel
+// arrays with one slot per particle. Emitters come out of a fixed pool and
+// feed particles in, all at once or at a rate, until they run dry; past
+// CAPACITY live particles new ones are dropped.
+//
+// step() moves SIMD_WIDTH particles at a time with AVX or SSE, whichever the
+// build targets, and works out the cell each one lands in on the way. Those
+// that changed cell are then checked one by one against their chunk, found
+// through a small table of the LOOKUPS chunks seen last that step, since
+// swapping out dead slots leaves the arrays in no useful order. Chunk types
+// are read as they are, so step from the thread that edits them.
+class ParticleSystem
+{
+  public:
+#if defined(__AVX__)
+    static const int SIMD_WIDTH = 8;
+#elif defined(__SSE2__)
+    static const int SIMD_WIDTH = 4;
+#else
+    static const int SIMD_WIDTH = 1;
+#endif
+
+    static const int CAPACITY = 131072;
+    static const int EMITTERS = 256;
+    static const int LOOKUPS = 256;
+    static constexpr float GRAVITY = 12.0;
+
+    enum Kind { BREAK, AMBIENT, KINDS };
+
+    // about the last step
+    struct Stats
+    {
+      int emitted;
+      int collided;
+      int lookups;
+      double integrate;
+      double collide;
+
+      Stats() : emitted(0), collided(0), lookups(0), integrate(0), collide(0) { /* */ };
+    };
+
+  protected:
+    struct Emitter
+    {
+      int kind;
+      float x, y, z;
+      float spread;
+
+      // per second, 0 for everything on the next step
+      float rate;
+      float owed;
+
+      // still to come, -1 for no end
+      int left;
+      int next;
+      bool live;
+    };
+
+    World &world;
+    int count;
+    unsigned int seed;
+    bool simd;
+    Stats stats;
+
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> life, weight, size;
+
+    // the corner of the texture each one shows
+    std::vector<float> tu, tv;
+
+    // the cell step() left each one in, and whether it was new that step
+    std::vector<int> cx, cy, cz;
+    std::vector<int> moved;
+
+    Emitter emitters[EMITTERS];
+    int freeEmitter;
+
+    float random();
+    int spawn( const Emitter &e, int n );
+    void integrate( float dt );
+    void integrateScalar( int begin, float dt );
+    void collide( float dt );
+    void compact();
+    void moveSlot( int to, int from );
+
+  public:
+    ParticleSystem( World &w );
+
+    // an emitter index, or -1 when the pool's used up or it would never stop
+    // (no rate and no end)
+    int emit( int kind, float x, float y, float z, float spread, int particles, float rate );
+    void moveEmitter( int e, float x, float y, float z );
+    void stopEmitter( int e );
+
+    // a block at x, y, z coming apart
+    int burst( int x, int y, int z, int particles = 32 );
+
+    void step( float dt );
+
+    // camera facing quads as GL_T2F_V3F, four corners each, for the ones
+    // in front of the camera
+    void record( const Camera &camera, std::vector<float> &quads ) const;
+
+    // off runs the plain loop the vector one falls back on, for comparing
+    void setSimd( bool s ) { simd = s; };
+    int simdWidth() const { return simd ? SIMD_WIDTH : 1; };
+
+    int live() const { return count; };
+    int activeEmitters() const;
+    const Stats &lastStep() const { return stats; };
+};
+
+// -----------------------------------------------------------------------------
+
+// Draws recorded particle quads in one call out of one buffer, orphaned and
+// filled again every frame. Wants a DrawState with arrays on.
+class ParticleBatch
+{
+  protected:
+    GLuint buffer;
+    long capacity;
+
+  public:
+    ParticleBatch();
+    virtual ~ParticleBatch();
+
+    void draw( const std::vector<float> &quads, RenderStats &stats );
+};
+
+#endif
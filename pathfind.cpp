@@ -0,0 +1,600 @@
+// made by inny
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <queue>
+#include "world.h"
+#include "pathfind.h"
+
+using namespace std;
+
+// the four ways along the ground, each level, a step up or a step down
+static const int sides[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+int Pathfinder::NavChunk::nodeAt( int cell ) const
+{
+  int lo = 0, hi = nodes.size();
+  while ( lo < hi ) {
+    const int mid = (lo + hi) / 2;
+    if ( nodes[mid].cell < cell ) lo = mid + 1;
+    else hi = mid;
+  }
+  return ( lo < nodes.size() && nodes[lo].cell == cell ) ? lo : -1;
+}
+
+void Pathfinder::Flood::begin()
+{
+  if ( mark.size() < Chunk::VOLUME ) {
+    mark.assign( Chunk::VOLUME, 0 );
+    value.resize( Chunk::VOLUME );
+  }
+  stamp++;
+  queue.clear();
+}
+
+Pathfinder::Pathfinder( World &w )
+  : world(w), seenRevision(0), seenLayout(0), search(0)
+{
+  /* */
+}
+
+Pathfinder::~Pathfinder()
+{
+  for ( auto it = navs.begin(); it != navs.end(); ++it ) delete it->second;
+}
+
+// -----------------------------------------------------------------------------
+
+long long Pathfinder::keyOf( int x, int y, int z )
+{
+  const long long cx = (x >> Chunk::XSHIFT) + (1 << 20);
+  const long long cy = (y >> Chunk::YSHIFT) + (1 << 20);
+  const long long cz = (z >> Chunk::ZSHIFT) + (1 << 20);
+  return (cx << 42) | (cy << 21) | cz;
+}
+
+// every step changes x or z by one and y by at most one
+int Pathfinder::heuristic( const Cell &a, const Cell &b )
+{
+  return max( abs(a.x - b.x) + abs(a.z - b.z), abs(a.y - b.y) );
+}
+
+Pathfinder::Cell Pathfinder::cellOf( const NavChunk &n, int cell )
+{
+  int x, y, z;
+  Chunk::cellCoords( cell, x, y, z );
+  return Cell( n.x + x, n.y + y, n.z + z );
+}
+
+// the cells one step from cell that stay inside the chunk
+int Pathfinder::steps( const NavChunk &n, int cell, int *out )
+{
+  int x, y, z;
+  Chunk::cellCoords( cell, x, y, z );
+  const bool tall = n.flags[cell] & TALL;
+
+  int count = 0;
+  for ( int s = 0; s < 4; s++ ) {
+    for ( int dy = -1; dy <= 1; dy++ ) {
+      const int tx = x + sides[s][0], ty = y + dy, tz = z + sides[s][1];
+      if ( !Chunk::contains( tx, ty, tz ) ) continue;
+      const int t = Chunk::cell( tx, ty, tz );
+      const unsigned char f = n.flags[t];
+      if ( !(f & WALK) ) continue;
+
+      // the head goes over the lower of the two floors
+      if ( dy > 0 && !tall ) continue;
+      if ( dy < 0 && !(f & TALL) ) continue;
+      out[count++] = t;
+    }
+  }
+  return count;
+}
+
+// drops what changed since the last search. Cells read a block into the
+// chunks around, so a change there counts too; portals pair up with their
+// neighbours', so those go stale along with any chunk next to them. An
+// unload changes no revision, only the world's layout
+void Pathfinder::sweep()
+{
+  const unsigned int latest = Chunk::latestRevision();
+  const unsigned int layout = world.layoutStamp();
+  if ( latest == seenRevision && layout == seenLayout ) return;
+  seenRevision = latest;
+  seenLayout = layout;
+
+  vector<NavChunk*> changed;
+  for ( auto it = navs.begin(); it != navs.end(); ) {
+    NavChunk *n = it->second;
+    Chunk *c = world.chunkAt( n->x, n->y, n->z );
+    if (!c) {
+      delete n;
+      it = navs.erase( it );
+      continue;
+    }
+    ++it;
+
+    if ( n->cellsStale ) continue;
+    for ( int k = 0; k < 27; k++ ) {
+      Chunk *near = world.chunkAt( n->x + (k % 3 - 1) * Chunk::XSIZE,
+                                   n->y + (k / 3 % 3 - 1) * Chunk::YSIZE,
+                                   n->z + (k / 9 - 1) * Chunk::ZSIZE );
+      if ( n->revisions[k] != (near ? near->revision() : 0) ) {
+        n->cellsStale = true;
+        changed.push_back( n );
+        break;
+      }
+    }
+  }
+
+  for ( int i = 0; i < changed.size(); i++ ) {
+    for ( int k = 0; k < 27; k++ ) {
+      auto finder = navs.find( keyOf( changed[i]->x + (k % 3 - 1) * Chunk::XSIZE,
+                                      changed[i]->y + (k / 3 % 3 - 1) * Chunk::YSIZE,
+                                      changed[i]->z + (k / 9 - 1) * Chunk::ZSIZE ) );
+      if ( finder != navs.end() ) finder->second->portalsStale = true;
+    }
+  }
+}
+
+Pathfinder::NavChunk *Pathfinder::cellsAt( int x, int y, int z )
+{
+  const long long key = keyOf( x, y, z );
+  NavChunk *n;
+  auto finder = navs.find( key );
+  if ( finder != navs.end() ) {
+    n = finder->second;
+  }
+  else {
+    Chunk *c = world.chunkAt( x, y, z );
+    if (!c) return 0;
+    n = new NavChunk;
+    n->x = x & ~Chunk::XMASK;
+    n->y = y & ~Chunk::YMASK;
+    n->z = z & ~Chunk::ZMASK;
+    n->cellsStale = true;
+    n->portalsStale = true;
+    navs[key] = n;
+  }
+
+  if ( n->cellsStale ) readCells( *n );
+  return n;
+}
+
+Pathfinder::NavChunk *Pathfinder::portalsAt( int x, int y, int z )
+{
+  NavChunk *n = cellsAt( x, y, z );
+  if ( n && n->portalsStale ) findPortals( *n );
+  return n;
+}
+
+unsigned char Pathfinder::flagsAt( int x, int y, int z )
+{
+  NavChunk *n = cellsAt( x, y, z );
+  if (!n) return 0;
+  return n->flags[ Chunk::cell( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK ) ];
+}
+
+// -----------------------------------------------------------------------------
+
+// where you can stand, and which pieces those cells fall into
+void Pathfinder::readCells( NavChunk &n )
+{
+  stats.rebuilt++;
+
+  Chunk *near[27];
+  for ( int k = 0; k < 27; k++ ) {
+    near[k] = world.chunkAt( n.x + (k % 3 - 1) * Chunk::XSIZE,
+                             n.y + (k / 3 % 3 - 1) * Chunk::YSIZE,
+                             n.z + (k / 9 - 1) * Chunk::ZSIZE );
+    n.revisions[k] = near[k] ? near[k]->revision() : 0;
+  }
+
+  // a missing chunk is air, nothing to stand on
+  auto type = [&]( int x, int y, int z ) -> unsigned short {
+    const int dx = x < 0 ? -1 : x >= Chunk::XSIZE ? 1 : 0;
+    const int dy = y < 0 ? -1 : y >= Chunk::YSIZE ? 1 : 0;
+    const int dz = z < 0 ? -1 : z >= Chunk::ZSIZE ? 1 : 0;
+    const Chunk *c = near[ (dx+1) + (dy+1)*3 + (dz+1)*9 ];
+    return c ? c->typeAt( x & Chunk::XMASK, y & Chunk::YMASK, z & Chunk::ZMASK ) : 0;
+  };
+
+  n.flags.assign( Chunk::VOLUME, 0 );
+  for ( int z = 0; z < Chunk::ZSIZE; z++ ) {
+    for ( int y = 0; y < Chunk::YSIZE; y++ ) {
+      for ( int x = 0; x < Chunk::XSIZE; x++ ) {
+        if ( type(x, y, z) || type(x, y+1, z) ) continue;
+        const unsigned short floor = type( x, y-1, z );
+        if ( floor == Voxel::AIR || Voxel::isWater(floor) ) continue;
+        n.flags[ Chunk::cell(x, y, z) ] = WALK | ( type(x, y+2, z) ? 0 : TALL );
+      }
+    }
+  }
+
+  // anything past 254 pieces in one chunk can't be walked on
+  n.pieces.assign( Chunk::VOLUME, NONE );
+  n.pieceCount = 0;
+  vector<int> &queue = walkFlood.queue;
+  int out[12];
+  for ( int i = 0; i < Chunk::VOLUME && n.pieceCount < NONE; i++ ) {
+    if ( !(n.flags[i] & WALK) || n.pieces[i] != NONE ) continue;
+
+    queue.clear();
+    queue.push_back( i );
+    n.pieces[i] = n.pieceCount;
+    for ( int q = 0; q < queue.size(); q++ ) {
+      const int k = steps( n, queue[q], out );
+      for ( int j = 0; j < k; j++ ) {
+        if ( n.pieces[out[j]] != NONE ) continue;
+        n.pieces[out[j]] = n.pieceCount;
+        queue.push_back( out[j] );
+      }
+    }
+    n.pieceCount++;
+  }
+
+  n.cellsStale = false;
+  n.portalsStale = true;
+}
+
+// Every step over the chunk's walls joins a piece here to a piece over
+// there. Of all the steps joining the same two pieces the middle one, by
+// the sum of both ends, is the portal; the neighbour sorts the same steps
+// the same way, so it picks the other end of the same step
+void Pathfinder::findPortals( NavChunk &n )
+{
+  struct Crossing
+  {
+    int group;
+    int sx, sy, sz;
+    int cell;
+    Cell to;
+
+    bool operator<( const Crossing &c ) const
+    {
+      if ( group != c.group ) return group < c.group;
+      if ( sx != c.sx ) return sx < c.sx;
+      if ( sy != c.sy ) return sy < c.sy;
+      return sz < c.sz;
+    };
+  };
+
+  NavChunk *around[27];
+  for ( int k = 0; k < 27; k++ ) {
+    around[k] = ( k == 13 ) ? &n : cellsAt( n.x + (k % 3 - 1) * Chunk::XSIZE,
+                                            n.y + (k / 3 % 3 - 1) * Chunk::YSIZE,
+                                            n.z + (k / 9 - 1) * Chunk::ZSIZE );
+  }
+
+  vector<Crossing> crossings;
+  for ( int i = 0; i < Chunk::VOLUME; i++ ) {
+    if ( n.pieces[i] == NONE ) continue;
+    int x, y, z;
+    Chunk::cellCoords( i, x, y, z );
+    if ( x > 0 && x < Chunk::XSIZE-1 && y > 0 && y < Chunk::YSIZE-1 &&
+         z > 0 && z < Chunk::ZSIZE-1 ) continue;
+
+    const bool tall = n.flags[i] & TALL;
+    for ( int s = 0; s < 4; s++ ) {
+      for ( int dy = -1; dy <= 1; dy++ ) {
+        const int tx = x + sides[s][0], ty = y + dy, tz = z + sides[s][1];
+        if ( Chunk::contains( tx, ty, tz ) ) continue;
+
+        const int ox = tx < 0 ? -1 : tx >= Chunk::XSIZE ? 1 : 0;
+        const int oy = ty < 0 ? -1 : ty >= Chunk::YSIZE ? 1 : 0;
+        const int oz = tz < 0 ? -1 : tz >= Chunk::ZSIZE ? 1 : 0;
+        const int k = (ox+1) + (oy+1)*3 + (oz+1)*9;
+        const NavChunk *m = around[k];
+        if (!m) continue;
+
+        const int t = Chunk::cell( tx & Chunk::XMASK, ty & Chunk::YMASK, tz & Chunk::ZMASK );
+        const unsigned char f = m->flags[t];
+        if ( m->pieces[t] == NONE ) continue;
+        if ( dy > 0 && !tall ) continue;
+        if ( dy < 0 && !(f & TALL) ) continue;
+
+        Crossing c;
+        c.group = (k << 16) | (n.pieces[i] << 8) | m->pieces[t];
+        c.cell = i;
+        c.to = Cell( n.x + tx, n.y + ty, n.z + tz );
+        c.sx = 2 * (n.x + x) + sides[s][0];
+        c.sy = 2 * (n.y + y) + dy;
+        c.sz = 2 * (n.z + z) + sides[s][1];
+        crossings.push_back( c );
+      }
+    }
+  }
+  sort( crossings.begin(), crossings.end() );
+
+  // one node per cell, however many portals start there
+  vector< pair<int, Cell> > picked;
+  for ( int a = 0; a < crossings.size(); ) {
+    int b = a;
+    while ( b < crossings.size() && crossings[b].group == crossings[a].group ) b++;
+    const Crossing &mid = crossings[ a + (b - a) / 2 ];
+    picked.push_back( make_pair( mid.cell, mid.to ) );
+    a = b;
+  }
+  sort( picked.begin(), picked.end(),
+        []( const pair<int, Cell> &p, const pair<int, Cell> &q ) { return p.first < q.first; } );
+
+  n.nodes.clear();
+  for ( int i = 0; i < picked.size(); i++ ) {
+    if ( n.nodes.empty() || n.nodes.back().cell != picked[i].first ) {
+      Node node;
+      node.cell = picked[i].first;
+      node.piece = n.pieces[node.cell];
+      node.stamp = 0;
+      node.cost = INT_MAX;
+      node.closed = false;
+      node.parentChunk = 0;
+      node.parentNode = -1;
+      n.nodes.push_back( node );
+    }
+    n.nodes.back().across.push_back( picked[i].second );
+  }
+
+  // how far each portal is from the others in its piece
+  for ( int a = 0; a < n.nodes.size(); a++ ) {
+    spread( n, n.nodes[a].cell, walkFlood );
+    for ( int b = 0; b < n.nodes.size(); b++ ) {
+      if ( b == a || n.nodes[b].piece != n.nodes[a].piece ) continue;
+      if ( walkFlood.has( n.nodes[b].cell ) )
+        n.nodes[a].links.push_back( make_pair( b, walkFlood.value[ n.nodes[b].cell ] ) );
+    }
+  }
+
+  n.portalsStale = false;
+}
+
+// steps from `from` to every cell of its piece, or until `to` turns up
+void Pathfinder::spread( const NavChunk &n, int from, Flood &flood, int to )
+{
+  flood.begin();
+  flood.set( from, 0 );
+  flood.queue.push_back( from );
+
+  int out[12];
+  for ( int q = 0; q < flood.queue.size(); q++ ) {
+    const int c = flood.queue[q];
+    if ( c == to ) return;
+    const int d = flood.value[c] + 1;
+    const int k = steps( n, c, out );
+    for ( int i = 0; i < k; i++ ) {
+      if ( flood.has( out[i] ) ) continue;
+      flood.set( out[i], d );
+      flood.queue.push_back( out[i] );
+    }
+  }
+}
+
+// spreads back from `to` and walks downhill from `from`, adding the cells
+// after `from`
+void Pathfinder::walk( const NavChunk &n, int from, int to, vector<Cell> &path )
+{
+  spread( n, to, walkFlood, from );
+
+  int out[12];
+  int at = from;
+  while ( at != to ) {
+    const int k = steps( n, at, out );
+    int next = -1;
+    for ( int i = 0; i < k && next < 0; i++ )
+      if ( walkFlood.has( out[i] ) && walkFlood.value[out[i]] == walkFlood.value[at] - 1 )
+        next = out[i];
+    if ( next < 0 ) return;
+    at = next;
+    path.push_back( cellOf( n, at ) );
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+bool Pathfinder::find( const Cell &start, const Cell &goal, vector<Cell> &path )
+{
+  struct Open
+  {
+    int f, g;
+    NavChunk *chunk;
+    int node;
+
+    // cheapest first, deepest first among equals
+    bool operator<( const Open &o ) const { return f > o.f || ( f == o.f && g < o.g ); };
+  };
+
+  path.clear();
+  stats = Stats();
+  sweep();
+  search++;
+
+  NavChunk *sn = portalsAt( start.x, start.y, start.z );
+  NavChunk *gn = portalsAt( goal.x, goal.y, goal.z );
+  if ( !sn || !gn ) return false;
+  const int sc = Chunk::cell( start.x & Chunk::XMASK, start.y & Chunk::YMASK, start.z & Chunk::ZMASK );
+  const int gc = Chunk::cell( goal.x & Chunk::XMASK, goal.y & Chunk::YMASK, goal.z & Chunk::ZMASK );
+  if ( sn->pieces[sc] == NONE || gn->pieces[gc] == NONE ) return false;
+
+  spread( *sn, sc, startFlood );
+  spread( *gn, gc, goalFlood );
+
+  // the goal is reached from a portal in its piece, or straight from the
+  // start when both share one; parent 0 stands for the start
+  priority_queue<Open> open;
+  int goalCost = INT_MAX;
+  NavChunk *goalChunk = 0;
+  int goalNode = -1;
+
+  auto reach = [&]( NavChunk *m, int j, int g, NavChunk *pc, int pn ) {
+    Node &node = m->nodes[j];
+    if ( node.stamp != search ) {
+      node.stamp = search;
+      node.cost = INT_MAX;
+      node.closed = false;
+    }
+    if ( node.closed || g >= node.cost ) return;
+    node.cost = g;
+    node.parentChunk = pc;
+    node.parentNode = pn;
+
+    Open o;
+    o.g = g;
+    o.f = g + heuristic( cellOf( *m, node.cell ), goal );
+    o.chunk = m;
+    o.node = j;
+    open.push( o );
+  };
+
+  auto offerGoal = [&]( int cost, NavChunk *pc, int pn ) {
+    if ( cost >= goalCost ) return;
+    goalCost = cost;
+    goalChunk = pc;
+    goalNode = pn;
+    Open o;
+    o.f = o.g = cost;
+    o.chunk = 0;
+    o.node = -1;
+    open.push( o );
+  };
+
+  if ( sn == gn && startFlood.has( gc ) ) offerGoal( startFlood.value[gc], 0, -1 );
+  for ( int i = 0; i < sn->nodes.size(); i++ )
+    if ( startFlood.has( sn->nodes[i].cell ) )
+      reach( sn, i, startFlood.value[ sn->nodes[i].cell ], 0, -1 );
+
+  while ( !open.empty() ) {
+    const Open o = open.top();
+    open.pop();
+    if ( !o.chunk ) break;
+
+    Node &node = o.chunk->nodes[o.node];
+    if ( node.closed || o.g > node.cost ) continue;
+    node.closed = true;
+    stats.expanded++;
+
+    if ( o.chunk == gn && goalFlood.has( node.cell ) )
+      offerGoal( o.g + goalFlood.value[node.cell], o.chunk, o.node );
+
+    for ( int i = 0; i < node.links.size(); i++ )
+      reach( o.chunk, node.links[i].first, o.g + node.links[i].second, o.chunk, o.node );
+
+    for ( int i = 0; i < node.across.size(); i++ ) {
+      const Cell &c = node.across[i];
+      NavChunk *m = portalsAt( c.x, c.y, c.z );
+      if (!m) continue;
+      const int j = m->nodeAt( Chunk::cell( c.x & Chunk::XMASK, c.y & Chunk::YMASK, c.z & Chunk::ZMASK ) );
+      if ( j >= 0 ) reach( m, j, o.g + 1, o.chunk, o.node );
+    }
+  }
+
+  if ( goalCost == INT_MAX ) return false;
+
+  // portals back to the start, then each leg walked out
+  vector< pair<NavChunk*, int> > route;
+  for ( NavChunk *c = goalChunk; c; ) {
+    route.push_back( make_pair( c, goalNode ) );
+    const Node &node = c->nodes[goalNode];
+    c = node.parentChunk;
+    goalNode = node.parentNode;
+  }
+  reverse( route.begin(), route.end() );
+
+  path.push_back( start );
+  NavChunk *at = sn;
+  int atCell = sc;
+  for ( int i = 0; i < route.size(); i++ ) {
+    NavChunk *m = route[i].first;
+    const int cell = m->nodes[ route[i].second ].cell;
+    if ( m == at ) walk( *m, atCell, cell, path );
+    else path.push_back( cellOf( *m, cell ) );
+    at = m;
+    atCell = cell;
+  }
+  walk( *gn, atCell, gc, path );
+  return true;
+}
+
+bool Pathfinder::findFlat( const Cell &start, const Cell &goal, vector<Cell> &path, int limit )
+{
+  struct Open
+  {
+    int f, g;
+    Cell cell;
+
+    bool operator<( const Open &o ) const { return f > o.f || ( f == o.f && g < o.g ); };
+  };
+
+  struct Visit
+  {
+    int cost;
+    Cell parent;
+  };
+
+  path.clear();
+  stats = Stats();
+  sweep();
+  if ( !walkable( start.x, start.y, start.z ) || !walkable( goal.x, goal.y, goal.z ) ) return false;
+
+  auto key = []( const Cell &c ) {
+    return ( (long long)(c.x + (1 << 20)) << 42 ) | ( (long long)(c.y + (1 << 20)) << 21 ) |
+           (long long)(c.z + (1 << 20));
+  };
+
+  unordered_map<long long, Visit> visits;
+  priority_queue<Open> open;
+  Visit v;
+  v.cost = 0;
+  v.parent = start;
+  visits[ key(start) ] = v;
+  Open first;
+  first.f = heuristic( start, goal );
+  first.g = 0;
+  first.cell = start;
+  open.push( first );
+
+  while ( !open.empty() ) {
+    const Open o = open.top();
+    open.pop();
+    if ( o.g > visits[ key(o.cell) ].cost ) continue;
+
+    if ( o.cell == goal ) {
+      for ( Cell c = goal; !(c == start); c = visits[ key(c) ].parent ) path.push_back( c );
+      path.push_back( start );
+      reverse( path.begin(), path.end() );
+      return true;
+    }
+    if ( ++stats.expanded > limit ) return false;
+
+    const bool tall = flagsAt( o.cell.x, o.cell.y, o.cell.z ) & TALL;
+    for ( int s = 0; s < 4; s++ ) {
+      for ( int dy = -1; dy <= 1; dy++ ) {
+        const Cell t( o.cell.x + sides[s][0], o.cell.y + dy, o.cell.z + sides[s][1] );
+        const unsigned char f = flagsAt( t.x, t.y, t.z );
+        if ( !(f & WALK) ) continue;
+        if ( dy > 0 && !tall ) continue;
+        if ( dy < 0 && !(f & TALL) ) continue;
+
+        const long long k = key( t );
+        auto finder = visits.find( k );
+        if ( finder != visits.end() && finder->second.cost <= o.g + 1 ) continue;
+        Visit &next = visits[k];
+        next.cost = o.g + 1;
+        next.parent = o.cell;
+
+        Open n;
+        n.g = o.g + 1;
+        n.f = n.g + heuristic( t, goal );
+        n.cell = t;
+        open.push( n );
+      }
+    }
+  }
+  return false;
+}
+
+int Pathfinder::portals() const
+{
+  int count = 0;
+  for ( auto it = navs.begin(); it != navs.end(); ++it ) count += it->second->nodes.size();
+  return count;
+}
@@ -0,0 +1,141 @@
+// made by inny
+
+#ifndef OPENMINE_PATHFIND_H
+#define OPENMINE_PATHFIND_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "chunk.h"
+
+class World;
+
+// Walking routes for anything two blocks tall that steps up or down one
+// block at a time, found HPA* style. Each chunk splits the cells you can
+// stand in into pieces that connect inside the chunk. Where a piece meets a
+// piece of a neighbouring chunk, the crossing in the middle of their shared
+// border becomes a portal on both sides, and portals in one piece know how
+// far apart they are. A route is searched over portals only, then walked
+// out cell by cell inside the chunks it passes through.
+//
+// A chunk is worked out when a search first reaches it and again after it
+// or a neighbour changes. Chunk types are read as they are, so call this
+// from the thread that edits them or with World::editLock() held.
+class Pathfinder
+{
+  public:
+    struct Cell
+    {
+      int x, y, z;
+      Cell( int xx=0, int yy=0, int zz=0 ) : x(xx), y(yy), z(zz) { /* */ };
+      bool operator==( const Cell &c ) const { return x == c.x && y == c.y && z == c.z; };
+    };
+
+    // about the last search
+    struct Stats
+    {
+      int expanded;
+      int rebuilt;
+
+      Stats() : expanded(0), rebuilt(0) { /* */ };
+    };
+
+  protected:
+    // a cell in no piece
+    enum { NONE = 255 };
+
+    // room to stand in, and air two blocks over the floor for a step
+    enum { WALK = 1, TALL = 2 };
+
+    struct NavChunk;
+
+    struct Node
+    {
+      int cell;
+      unsigned char piece;
+      std::vector<Cell> across;
+      std::vector< std::pair<int, int> > links;
+
+      // search state, only good while stamp is the current search
+      int stamp;
+      int cost;
+      bool closed;
+      NavChunk *parentChunk;
+      int parentNode;
+    };
+
+    struct NavChunk
+    {
+      int x, y, z;
+
+      // of the 3x3x3 chunks around, 0 for none, when the cells were read
+      unsigned int revisions[27];
+      bool cellsStale;
+      bool portalsStale;
+
+      std::vector<unsigned char> flags;
+      std::vector<unsigned char> pieces;
+      int pieceCount;
+
+      // sorted by cell, at most one per cell
+      std::vector<Node> nodes;
+
+      int nodeAt( int cell ) const;
+    };
+
+    // breadth first over one chunk, value is a distance or a parent cell
+    struct Flood
+    {
+      std::vector<int> mark;
+      std::vector<int> value;
+      std::vector<int> queue;
+      int stamp;
+
+      Flood() : stamp(0) { /* */ };
+      void begin();
+      bool has( int i ) const { return mark[i] == stamp; };
+      void set( int i, int v ) { mark[i] = stamp; value[i] = v; };
+    };
+
+    World &world;
+    std::unordered_map<long long, NavChunk*> navs;
+    unsigned int seenRevision;
+    unsigned int seenLayout;
+    int search;
+    Stats stats;
+    Flood startFlood, goalFlood, walkFlood;
+
+    static long long keyOf( int x, int y, int z );
+    static int heuristic( const Cell &a, const Cell &b );
+    static Cell cellOf( const NavChunk &n, int cell );
+    static int steps( const NavChunk &n, int cell, int *out );
+
+    void sweep();
+    NavChunk *cellsAt( int x, int y, int z );
+    NavChunk *portalsAt( int x, int y, int z );
+    void readCells( NavChunk &n );
+    void findPortals( NavChunk &n );
+    void spread( const NavChunk &n, int from, Flood &flood, int to = -1 );
+    void walk( const NavChunk &n, int from, int to, std::vector<Cell> &path );
+    unsigned char flagsAt( int x, int y, int z );
+
+  public:
+    Pathfinder( World &w );
+    virtual ~Pathfinder();
+
+    bool walkable( int x, int y, int z ) { return flagsAt( x, y, z ) & WALK; };
+
+    // every cell from start to goal, both included; false if there's no way
+    bool find( const Cell &start, const Cell &goal, std::vector<Cell> &path );
+
+    // the same over single cells with no portals, a shortest path for
+    // comparing against; gives up after limit cells
+    bool findFlat( const Cell &start, const Cell &goal, std::vector<Cell> &path,
+                   int limit = 4000000 );
+
+    const Stats &lastSearch() const { return stats; };
+    int chunks() const { return navs.size(); };
+    int portals() const;
+};
+
+#endif
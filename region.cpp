@@ -0,0 +1,175 @@
+// made by inny
+
+#include <cmath>
+#include "memstats.h"
+#include "region.h"
+#include "world.h"
+
+using namespace std;
+
+Region::Region()
+  : buffer(0), capacity(0), scratch(0), dirty(0), visible(0), closest(0)
+{
+  for ( int i = 0; i < CHUNKS; i++ ) {
+    members[i] = 0;
+    first[i] = 0;
+    count[i] = 0;
+    reserved[i] = 0;
+    facing[i] = 0;
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) sides[i][d] = 0;
+  }
+}
+
+Region::~Region()
+{
+  if (buffer) glDeleteBuffers( 1, &buffer );
+  MemoryStats::add( MemoryStats::GL_BUFFERS, -long(capacity * 5 * sizeof(float)) );
+  MemoryStats::add( MemoryStats::MESH_SCRATCH, -scratch );
+}
+
+void Region::origin( float &x, float &y, float &z )
+{
+  x = floor( x / (Chunk::XSIZE*SIZE) ) * (Chunk::XSIZE*SIZE);
+  y = floor( y / (Chunk::YSIZE*SIZE) ) * (Chunk::YSIZE*SIZE);
+  z = floor( z / (Chunk::ZSIZE*SIZE) ) * (Chunk::ZSIZE*SIZE);
+}
+
+int Region::slotOf( float x, float y, float z )
+{
+  float ox = x, oy = y, oz = z;
+  origin( ox, oy, oz );
+  const int cx = int( floor( (x-ox) / Chunk::XSIZE ) );
+  const int cy = int( floor( (y-oy) / Chunk::YSIZE ) );
+  const int cz = int( floor( (z-oz) / Chunk::ZSIZE ) );
+  return ( cz * SIZE + cy ) * SIZE + cx;
+}
+
+void Region::add( Chunk *c, int slot )
+{
+  members[slot] = c;
+  c->joinRegion( this, slot );
+  invalidate( slot );
+}
+
+// the slot's mesh goes with the next update, on the render thread
+void Region::remove( int slot )
+{
+  members[slot] = 0;
+  invalidate( slot );
+}
+
+bool Region::isEmpty() const
+{
+  for ( int i = 0; i < CHUNKS; i++ )
+    if ( members[i] ) return false;
+  return true;
+}
+
+void Region::update()
+{
+  bool overflow = (buffer == 0);
+
+  for ( int i = 0; i < CHUNKS; i++ ) {
+    if ( !(dirty & (uint64_t(1) << i)) ) continue;
+    if ( !members[i] ) {
+      meshes[i].clear();
+      count[i] = 0;
+      for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) sides[i][d] = 0;
+      continue;
+    }
+    members[i]->buildVertices( meshes[i] );
+    count[i] = meshes[i].size() / 5;
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) sides[i][d] = members[i]->sideVertices( d );
+    if ( count[i] > reserved[i] ) overflow = true;
+  }
+
+  // the member meshes stay around so a repack can resend them
+  long kept = 0;
+  for ( int i = 0; i < CHUNKS; i++ ) kept += meshes[i].capacity() * sizeof(float);
+  MemoryStats::add( MemoryStats::MESH_SCRATCH, kept - scratch );
+  scratch = kept;
+
+  if (overflow) {
+    repack();
+  }
+  else {
+    // every rebuilt member still fits its slot, only send those bytes
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    for ( int i = 0; i < CHUNKS; i++ ) {
+      if ( !(dirty & (uint64_t(1) << i)) || count[i] == 0 ) continue;
+      glBufferSubData( GL_ARRAY_BUFFER, first[i] * 5 * sizeof(float),
+                       count[i] * 5 * sizeof(float), &meshes[i][0] );
+    }
+  }
+
+  dirty = 0;
+}
+
+void Region::repack()
+{
+  MemoryStats::add( MemoryStats::GL_BUFFERS, -long(capacity * 5 * sizeof(float)) );
+
+  // leave a quarter again as headroom so small edits don't repack
+  capacity = 0;
+  for ( int i = 0; i < CHUNKS; i++ ) {
+    first[i] = capacity;
+    reserved[i] = count[i] + count[i] / 4;
+    reserved[i] -= reserved[i] % 4;
+    capacity += reserved[i];
+  }
+
+  if (!buffer) glGenBuffers( 1, &buffer );
+  glBindBuffer( GL_ARRAY_BUFFER, buffer );
+  glBufferData( GL_ARRAY_BUFFER, capacity * 5 * sizeof(float), 0, GL_STATIC_DRAW );
+  MemoryStats::add( MemoryStats::GL_BUFFERS, capacity * 5 * sizeof(float) );
+
+  for ( int i = 0; i < CHUNKS; i++ ) {
+    if ( count[i] == 0 ) continue;
+    glBufferSubData( GL_ARRAY_BUFFER, first[i] * 5 * sizeof(float),
+                     count[i] * 5 * sizeof(float), &meshes[i][0] );
+  }
+}
+
+void Region::prepare()
+{
+  if (dirty) update();
+}
+
+void Region::draw( RenderStats &stats )
+{
+
+  // at most three runs per chunk once the far sides are dropped
+  GLint drawFirst[CHUNKS * 3];
+  GLsizei drawCount[CHUNKS * 3];
+  int draws = 0;
+
+  for ( int i = 0; i < CHUNKS; i++ ) {
+    if ( !(visible & (uint64_t(1) << i)) || count[i] == 0 ) continue;
+    stats.meshBytes += count[i] * 5 * sizeof(float);
+    stats.chunks++;
+
+    GLint start = first[i];
+    GLsizei run = 0;
+    for ( int d = 0; d <= Voxel::DIRECTIONS; d++ ) {
+      if ( d < Voxel::DIRECTIONS && (facing[i] & (1 << d)) ) {
+        run += sides[i][d];
+        continue;
+      }
+      if ( run ) {
+        drawFirst[draws] = start;
+        drawCount[draws] = run;
+        stats.vertices += run;
+        draws++;
+      }
+      if ( d < Voxel::DIRECTIONS ) start += run + sides[i][d];
+      run = 0;
+    }
+  }
+
+  if ( draws == 0 ) return;
+
+  glBindBuffer( GL_ARRAY_BUFFER, buffer );
+  glInterleavedArrays( GL_T2F_V3F, 0, 0 );
+  glMultiDrawArrays( GL_QUADS, drawFirst, drawCount, draws );
+  stats.drawCalls++;
+}
@@ -0,0 +1,69 @@
+// made by inny
+
+#ifndef OPENMINE_REGION_H
+#define OPENMINE_REGION_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "opengl.h"
+#include "chunk.h"
+
+struct RenderStats;
+
+// A cube of chunks whose meshes share one vertex buffer, so that every visible
+// member goes out in a single glMultiDrawArrays.
+class Region
+{
+  public:
+    static const int SIZE = 4;
+    static const int CHUNKS = SIZE * SIZE * SIZE;
+
+  protected:
+    Chunk *members[CHUNKS];
+    std::vector<float> meshes[CHUNKS];
+    GLint first[CHUNKS];
+    GLsizei count[CHUNKS];
+    GLsizei sides[CHUNKS][Voxel::DIRECTIONS];
+    GLsizei reserved[CHUNKS];
+    unsigned char facing[CHUNKS];
+
+    GLuint buffer;
+    int capacity;
+    long scratch;
+    uint64_t dirty;
+    uint64_t visible;
+    float closest;
+
+    void update();
+    void repack();
+
+  public:
+    Region();
+    virtual ~Region();
+
+    static void origin( float &x, float &y, float &z );
+    static int slotOf( float x, float y, float z );
+
+    void add( Chunk *c, int slot );
+    void remove( int slot );
+    void invalidate( int slot ) { dirty |= (uint64_t(1) << slot); };
+    // depth is how far off the chunk is, the region sorts by its nearest
+    void markVisible( int slot, unsigned char f, float depth ) {
+      closest = visible ? std::min( closest, depth ) : depth;
+      visible |= (uint64_t(1) << slot);
+      facing[slot] = f;
+    };
+    bool hasVisible() const { return visible != 0; };
+    float nearest() const { return closest; };
+
+    // draw() leaves the marks for a second pass, the frame's done with them here
+    void clearVisible() { visible = 0; };
+    bool isEmpty() const;
+
+    // uploads changed member meshes, which reads their voxels; see Chunk::prepare
+    void prepare();
+    void draw( RenderStats &stats );
+};
+
+#endif
@@ -0,0 +1,120 @@
+// made by inny
+
+#include "util.h"
+#include "renderqueue.h"
+
+using namespace std;
+
+RenderPacket::RenderPacket()
+  : frame(0), recorded(0.0), renderer(0), occlusion(false), prepass(false), wireframe(false),
+    report(false)
+{
+  /* */
+}
+
+void RenderPacket::clear()
+{
+  report = false;
+  chunks.clear();
+  facing.clear();
+  fresh.clear();
+  particles.clear();
+  hud.clear();
+}
+
+void RenderPacket::hudVertex( float x, float y, float r, float g, float b )
+{
+  hud.push_back( x );
+  hud.push_back( y );
+  hud.push_back( r );
+  hud.push_back( g );
+  hud.push_back( b );
+}
+
+void RenderPacket::line( float x1, float y1, float x2, float y2, float r, float g, float b )
+{
+  hudVertex( x1, y1, r, g, b );
+  hudVertex( x2, y2, r, g, b );
+}
+
+// -----------------------------------------------------------------------------
+
+RenderQueue::RenderQueue()
+  : writing(0), reading(0), closed(false), latencySum(0.0), latencyWorst(0.0),
+    latencyCount(0)
+{
+  for ( int i = 0; i < SLOTS; i++ ) states[i] = FREE;
+}
+
+RenderPacket *RenderQueue::record()
+{
+  unique_lock<mutex> hold( lock );
+  while ( !closed && states[writing] != FREE ) changed.wait( hold );
+  if (closed) return 0;
+
+  states[writing] = RECORDING;
+  RenderPacket *p = &packets[writing];
+  hold.unlock();
+
+  // the vectors keep their capacity, so a steady frame allocates nothing
+  p->clear();
+  return p;
+}
+
+void RenderQueue::publish()
+{
+  lock_guard<mutex> hold( lock );
+  packets[writing].recorded = seconds();
+  states[writing] = QUEUED;
+  writing = (writing + 1) % SLOTS;
+  changed.notify_all();
+}
+
+RenderPacket *RenderQueue::acquire()
+{
+  unique_lock<mutex> hold( lock );
+  while ( !closed && states[reading] != QUEUED ) changed.wait( hold );
+  if ( states[reading] != QUEUED ) return 0;
+
+  states[reading] = DRAWING;
+  RenderPacket *p = &packets[reading];
+
+  const double waited = seconds() - p->recorded;
+  latencySum += waited;
+  latencyCount++;
+  if ( waited > latencyWorst ) latencyWorst = waited;
+  return p;
+}
+
+void RenderQueue::release()
+{
+  lock_guard<mutex> hold( lock );
+  states[reading] = FREE;
+  reading = (reading + 1) % SLOTS;
+  changed.notify_all();
+}
+
+void RenderQueue::close()
+{
+  lock_guard<mutex> hold( lock );
+  closed = true;
+  changed.notify_all();
+}
+
+int RenderQueue::queued()
+{
+  lock_guard<mutex> hold( lock );
+  int n = 0;
+  for ( int i = 0; i < SLOTS; i++ ) if ( states[i] == QUEUED ) n++;
+  return n;
+}
+
+void RenderQueue::latency( double &average, double &worst )
+{
+  lock_guard<mutex> hold( lock );
+  average = latencyCount ? latencySum / latencyCount : 0.0;
+  worst = latencyWorst;
+  latencySum = 0.0;
+  latencyWorst = 0.0;
+  latencyCount = 0;
+}
@@ -0,0 +1,93 @@
+// made by inny
+
+#ifndef OPENMINE_RENDERQUEUE_H
+#define OPENMINE_RENDERQUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "camera.h"
+#include "chunk.h"
+
+// Everything the render thread needs to draw one frame, recorded by the game
+// thread: the camera as it was, the chunks that passed culling with the face
+// directions that can point back at it, and the 2D overlay as lines.
+struct RenderPacket
+{
+  int frame;
+  double recorded;
+  Camera camera;
+
+  int renderer;
+  bool occlusion;
+  bool prepass;
+  bool wireframe;
+
+  // print the render side of F3 after drawing
+  bool report;
+
+  std::vector<Chunk*> chunks;
+  std::vector<unsigned char> facing;
+
+  // set for chunks that weren't in view last frame, so stale occlusion
+  // answers about them get thrown out
+  std::vector<unsigned char> fresh;
+
+  // camera facing particle quads, see ParticleSystem::record
+  std::vector<float> particles;
+
+  // pairs of ends, x y r g b each, in 640x480 screen space
+  std::vector<float> hud;
+
+  RenderPacket();
+  void clear();
+  void hudVertex( float x, float y, float r, float g, float b );
+  void line( float x1, float y1, float x2, float y2, float r, float g, float b );
+};
+
+// A fixed ring of packets between the game thread and the render thread. One
+// can be recorded while another waits and a third is drawn, and the recorder
+// waits when it gets that far ahead, so frames show up at most two behind.
+class RenderQueue
+{
+  public:
+    static const int SLOTS = 3;
+
+  protected:
+    enum State { FREE, RECORDING, QUEUED, DRAWING };
+
+    RenderPacket packets[SLOTS];
+    State states[SLOTS];
+    int writing;
+    int reading;
+    bool closed;
+
+    std::mutex lock;
+    std::condition_variable changed;
+
+    // recorded to picked up by the render thread
+    double latencySum;
+    double latencyWorst;
+    int latencyCount;
+
+  public:
+    RenderQueue();
+
+    // the next packet to fill, cleared, or 0 once the queue has closed
+    RenderPacket *record();
+    void publish();
+
+    // the oldest recorded packet, or 0 once closed and empty
+    RenderPacket *acquire();
+    void release();
+
+    // wakes both sides and turns them away from then on
+    void close();
+
+    int queued();
+
+    // average and worst wait in seconds since the last call
+    void latency( double &average, double &worst );
+};
+
+#endif
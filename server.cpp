@@ -0,0 +1,440 @@
+// made by inny
+
+// openmine_server: owns the World without any window or GL context, and
+// streams chunks around each connected player over TCP on localhost.
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include "util.h"
+#include "world.h"
+#include "worldfile.h"
+#include "net.h"
+
+using namespace std;
+
+static volatile sig_atomic_t running = 1;
+
+static void stopServer( int )
+{
+  running = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+struct Client
+{
+  Connection conn;
+  float x, y, z;
+  bool placed;
+
+  // chunks the client holds, and the ones it should hold nearest first
+  set<Chunk*> known;
+  vector<Chunk*> wanted;
+  int cellX, cellY, cellZ;
+
+  // bytes we may still send, refilled every tick
+  double credit;
+
+  Client( int socket )
+    : conn(socket), x(0), y(0), z(0), placed(false),
+      cellX(-1), cellY(-1), cellZ(-1), credit(0) { /* */ };
+};
+
+// -----------------------------------------------------------------------------
+
+class Server
+{
+  public:
+    static const int TICKS = 20;
+
+  protected:
+    World world;
+    int listener;
+    vector<Client*> clients;
+
+    float radius;
+    int budget;
+
+    // edits applied since the last tick, as (cell, type) per chunk
+    typedef vector< pair<unsigned short, unsigned short> > EditList;
+    map<Chunk*, EditList> edits;
+
+    // encoded MSG_CHUNK per chunk, dropped when the chunk is edited
+    map<Chunk*, vector<unsigned char> > snapshots;
+
+    int ticks;
+    double tickTime;
+    double worstTick;
+    uint64_t bytesSent;
+    double lastReport;
+
+    void acceptClients();
+    void readClient( Client &c );
+    void applyEdit( int x, int y, int z, unsigned short type );
+    void updateInterest( Client &c );
+    void sendDeltas( Client &c );
+    void sendChunks( Client &c );
+    void sendStats();
+    const vector<unsigned char> &snapshot( Chunk *chunk );
+    void tick();
+
+  public:
+    Server( int port, float r, int bytesPerSecond );
+    virtual ~Server();
+
+    bool isValid() const { return listener >= 0; };
+
+    // starts from a world baked by openmine_world rather than generating
+    // chunks as players come near; false unless the whole file checked out
+    bool loadWorld( const string &path );
+    void run( double duration );
+};
+
+Server::Server( int port, float r, int bytesPerSecond )
+  : radius(r), budget(bytesPerSecond), ticks(0), tickTime(0),
+    worstTick(0), bytesSent(0), lastReport(seconds())
+{
+  listener = listenTcp( port );
+  if ( listener < 0 ) cout << "can't listen on port " << port << "\n";
+}
+
+Server::~Server()
+{
+  for ( int i = 0; i < clients.size(); i++ ) delete clients[i];
+  if ( listener >= 0 ) ::close( listener );
+}
+
+bool Server::loadWorld( const string &path )
+{
+  WorldReader reader( path );
+  if ( reader.isValid() ) world.setExtent( reader.worldBlocks(0), reader.worldBlocks(2) );
+
+  vector<unsigned char> message;
+  vector<unsigned short> types( Chunk::VOLUME );
+  int x, y, z, bad = 0;
+  while ( reader.next( message ) ) {
+    if ( WorldReader::decode( message, x, y, z, &types[0] ) ) world.placeChunk( x, y, z, &types[0] );
+    else bad++;
+  }
+
+  if ( bad ) cout << "can't load " << path << ": " << bad << " chunks failed their checksum\n";
+  else if ( !reader.complete() ) cout << "can't load " << path << ": " << reader.error() << "\n";
+  else cout << "loaded " << reader.chunks() << " chunks from " << path << "\n";
+  return reader.complete() && !bad;
+}
+
+void Server::acceptClients()
+{
+  while (true) {
+    int fd = acceptTcp( listener );
+    if ( fd < 0 ) break;
+    clients.push_back( new Client(fd) );
+  }
+}
+
+void Server::readClient( Client &c )
+{
+  c.conn.receive();
+
+  int type;
+  const unsigned char *data;
+  size_t length;
+  while ( c.conn.nextMessage( type, data, length ) ) {
+    MessageReader in( data, length );
+    if ( type == MSG_POSITION ) {
+      float x = in.getF32(), y = in.getF32(), z = in.getF32();
+      if ( in.ok() ) { c.x = x; c.y = y; c.z = z; c.placed = true; }
+    }
+    else if ( type == MSG_EDIT ) {
+      int x = in.getI32(), y = in.getI32(), z = in.getI32();
+      unsigned short t = in.getU16();
+      if ( in.ok() ) applyEdit( x, y, z, t );
+    }
+  }
+}
+
+void Server::applyEdit( int x, int y, int z, unsigned short type )
+{
+  Chunk *chunk = world.loadChunk( x, y, z );
+  if (!chunk) return;
+
+  const int lx = x & Chunk::XMASK, ly = y & Chunk::YMASK, lz = z & Chunk::ZMASK;
+  if ( chunk->typeAt( lx, ly, lz ) == type ) return;
+  chunk->setTypeAt( lx, ly, lz, type );
+
+  const int cell = (lz * Chunk::YSIZE + ly) * Chunk::XSIZE + lx;
+  edits[chunk].push_back( make_pair( (unsigned short)cell, type ) );
+  snapshots.erase( chunk );
+}
+
+// rebuilt only when the client crosses into another chunk
+void Server::updateInterest( Client &c )
+{
+  const int cx = floor( c.x / Chunk::XSIZE );
+  const int cy = floor( c.y / Chunk::YSIZE );
+  const int cz = floor( c.z / Chunk::ZSIZE );
+  if ( cx == c.cellX && cy == c.cellY && cz == c.cellZ ) return;
+  c.cellX = cx; c.cellY = cy; c.cellZ = cz;
+
+  const int rx = ceil( radius / Chunk::XSIZE );
+  const int ry = ceil( radius / Chunk::YSIZE );
+  const int rz = ceil( radius / Chunk::ZSIZE );
+
+  vector< pair<float, Chunk*> > inRange;
+  for ( int z = cz-rz; z <= cz+rz; z++ ) {
+    for ( int y = cy-ry; y <= cy+ry; y++ ) {
+      for ( int x = cx-rx; x <= cx+rx; x++ ) {
+        const float xp = (x + 0.5f) * Chunk::XSIZE - c.x;
+        const float yp = (y + 0.5f) * Chunk::YSIZE - c.y;
+        const float zp = (z + 0.5f) * Chunk::ZSIZE - c.z;
+        const float dist = sqrt( xp*xp + yp*yp + zp*zp );
+        if ( dist > radius + Chunk::RADIUS ) continue;
+
+        Chunk *chunk = world.loadChunk( x*Chunk::XSIZE, y*Chunk::YSIZE, z*Chunk::ZSIZE );
+        if (chunk) inRange.push_back( make_pair( dist, chunk ) );
+      }
+    }
+  }
+  sort( inRange.begin(), inRange.end() );
+
+  c.wanted.clear();
+  for ( int i = 0; i < inRange.size(); i++ )
+    c.wanted.push_back( inRange[i].second );
+
+  // unload a chunk slot further out than we load, so walking along a
+  // border doesn't resend the same chunk over and over
+  const float unloadRadius = radius + Chunk::RADIUS + Chunk::XSIZE;
+  set<Chunk*>::iterator it = c.known.begin();
+  while ( it != c.known.end() ) {
+    Chunk *chunk = *it;
+    const float xp = chunk->x() + 0.5f * Chunk::XSIZE - c.x;
+    const float yp = chunk->y() + 0.5f * Chunk::YSIZE - c.y;
+    const float zp = chunk->z() + 0.5f * Chunk::ZSIZE - c.z;
+    if ( sqrt( xp*xp + yp*yp + zp*zp ) <= unloadRadius ) {
+      ++it;
+      continue;
+    }
+
+    MessageWriter out( c.conn.output(), MSG_UNLOAD );
+    out.putI32( chunk->x() );
+    out.putI32( chunk->y() );
+    out.putI32( chunk->z() );
+    out.finish();
+    c.credit -= out.size();
+    c.known.erase( it++ );
+  }
+}
+
+const vector<unsigned char> &Server::snapshot( Chunk *chunk )
+{
+  vector<unsigned char> &encoded = snapshots[chunk];
+  if ( !encoded.empty() ) return encoded;
+
+  static unsigned short types[Chunk::VOLUME];
+  int i = 0;
+  for ( int z = 0; z < Chunk::ZSIZE; z++ )
+    for ( int y = 0; y < Chunk::YSIZE; y++ )
+      for ( int x = 0; x < Chunk::XSIZE; x++ )
+        types[i++] = chunk->voxel( x, y, z ).type();
+
+  MessageWriter out( encoded, MSG_CHUNK );
+  out.putI32( chunk->x() );
+  out.putI32( chunk->y() );
+  out.putI32( chunk->z() );
+  rleEncode( types, Chunk::VOLUME, out );
+  out.finish();
+  return encoded;
+}
+
+void Server::sendDeltas( Client &c )
+{
+  if ( edits.empty() ) return;
+
+  vector<unsigned char> &buffer = c.conn.output();
+  const size_t start = buffer.size();
+  MessageWriter out( buffer, MSG_DELTA );
+  out.putU16( 0 );
+
+  int groups = 0;
+  map<Chunk*, EditList>::iterator it;
+  for ( it = edits.begin(); it != edits.end(); ++it ) {
+    if ( !c.known.count( it->first ) ) continue;
+    const EditList &list = it->second;
+    out.putI32( it->first->x() );
+    out.putI32( it->first->y() );
+    out.putI32( it->first->z() );
+    out.putU16( list.size() );
+    for ( int i = 0; i < list.size(); i++ ) {
+      out.putU16( list[i].first );
+      out.putU16( list[i].second );
+    }
+    groups++;
+  }
+
+  if ( groups == 0 ) {
+    buffer.resize( start );
+    return;
+  }
+  buffer[start+5] = groups & 0xFF;
+  buffer[start+6] = groups >> 8;
+  out.finish();
+  c.credit -= out.size();
+}
+
+void Server::sendChunks( Client &c )
+{
+  for ( int i = 0; i < c.wanted.size(); i++ ) {
+    // stop when out of credit, or when the socket isn't keeping up
+    if ( c.credit <= 0 || c.conn.pending() > budget ) break;
+
+    Chunk *chunk = c.wanted[i];
+    if ( c.known.count( chunk ) ) continue;
+
+    const vector<unsigned char> &encoded = snapshot( chunk );
+    c.conn.output().insert( c.conn.output().end(), encoded.begin(), encoded.end() );
+    c.credit -= encoded.size();
+    c.known.insert( chunk );
+  }
+}
+
+void Server::sendStats()
+{
+  const float avg = ticks ? 1000.0 * tickTime / ticks : 0.0;
+  for ( int i = 0; i < clients.size(); i++ ) {
+    MessageWriter out( clients[i]->conn.output(), MSG_STATS );
+    out.putF32( avg );
+    out.putF32( 1000.0 * worstTick );
+    out.putU32( clients.size() );
+    out.finish();
+  }
+
+  cout << "clients: " << clients.size() << " avg tick ms: " << avg
+       << " worst tick ms: " << 1000.0 * worstTick
+       << " chunks loaded: " << world.loadedChunks()
+       << " out KB/s: " << bytesSent / 1024.0 << "\n";
+
+  ticks = 0;
+  tickTime = 0;
+  worstTick = 0;
+  bytesSent = 0;
+}
+
+void Server::tick()
+{
+  const double start = seconds();
+
+  for ( int i = 0; i < clients.size(); i++ ) {
+    Client &c = *clients[i];
+    if ( !c.placed ) continue;
+
+    c.credit = min( c.credit + double(budget) / TICKS, double(budget) );
+    updateInterest( c );
+    sendDeltas( c );
+    sendChunks( c );
+
+    const uint64_t before = c.conn.bytesOut;
+    c.conn.flush();
+    bytesSent += c.conn.bytesOut - before;
+  }
+  edits.clear();
+
+  const double elapsed = seconds() - start;
+  tickTime += elapsed;
+  worstTick = max( worstTick, elapsed );
+  ticks++;
+}
+
+void Server::run( double duration )
+{
+  const double begin = seconds();
+  double nextTick = begin;
+  vector<pollfd> fds;
+
+  while ( running && (duration <= 0 || seconds() - begin < duration) ) {
+    fds.resize( clients.size() + 1 );
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    for ( int i = 0; i < clients.size(); i++ ) {
+      fds[i+1].fd = clients[i]->conn.socket();
+      fds[i+1].events = POLLIN | ( clients[i]->conn.pending() ? POLLOUT : 0 );
+    }
+
+    const int wait = max( 0, int( (nextTick - seconds()) * 1000.0 ) );
+    poll( &fds[0], fds.size(), wait );
+
+    if ( fds[0].revents & POLLIN ) acceptClients();
+
+    // new clients were appended after fds was built, so they wait a round
+    for ( int i = 0; i+1 < fds.size(); i++ ) {
+      Client &c = *clients[i];
+      if ( fds[i+1].revents & (POLLIN | POLLHUP | POLLERR) ) readClient( c );
+      if ( fds[i+1].revents & POLLOUT ) {
+        const uint64_t before = c.conn.bytesOut;
+        c.conn.flush();
+        bytesSent += c.conn.bytesOut - before;
+      }
+    }
+
+    for ( int i = 0; i < clients.size(); ) {
+      if ( clients[i]->conn.isClosed() ) {
+        delete clients[i];
+        clients.erase( clients.begin() + i );
+      }
+      else i++;
+    }
+
+    const double now = seconds();
+    if ( now >= nextTick ) {
+      tick();
+      nextTick += 1.0 / TICKS;
+      if ( nextTick < now ) nextTick = now;
+    }
+
+    if ( now - lastReport >= 1.0 ) {
+      sendStats();
+      lastReport = now;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+int main( int argc, char **argv )
+{
+  int port = DEFAULT_PORT;
+  float radius = 48.0;
+  int budget = 256 * 1024;
+  double duration = 0;
+  string baked;
+
+  for ( int i = 1; i+1 < argc; i++ ) {
+    const string arg = argv[i];
+    if ( arg == "--port" ) port = atoi( argv[++i] );
+    else if ( arg == "--radius" ) radius = atof( argv[++i] );
+    else if ( arg == "--budget" ) budget = atoi( argv[++i] );
+    else if ( arg == "--seconds" ) duration = atof( argv[++i] );
+    else if ( arg == "--world" ) baked = argv[++i];
+  }
+
+  signal( SIGINT, stopServer );
+  signal( SIGTERM, stopServer );
+  signal( SIGPIPE, SIG_IGN );
+
+  Server server( port, radius, budget );
+  if ( !server.isValid() ) return 1;
+  if ( !baked.empty() && !server.loadWorld( baked ) ) return 1;
+
+  cout << "openmine_server on 127.0.0.1:" << port << ", view radius " << radius
+       << ", " << budget << " bytes/s per client\n";
+  server.run( duration );
+  return 0;
+}
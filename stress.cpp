@@ -0,0 +1,122 @@
+// made by inny
+
+// openmine_stress: hammers the chunk index and its epoch reclamation from
+// several threads at once, with nothing but the core library linked in, so
+// it builds and runs under ThreadSanitizer (cmake -DOPENMINE_TSAN=ON) or
+// -fsanitize=address without SDL or a GL context.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "util.h"
+#include "voxel.h"
+#include "chunk.h"
+#include "chunkindex.h"
+#include "epoch.h"
+#include "memstats.h"
+
+using namespace std;
+
+// hammers a chunk index from several threads at once, readers checking every
+// chunk they find against its key while writers add and remove underneath
+// them. Meant to be run under a sanitizer as much as to be timed
+int stressChunkIndex( double duration, int threads )
+{
+  const int KEYS = 1024;
+  const int writers = max( 1, threads / 4 );
+  const long long before = MemoryStats::get( MemoryStats::CHUNK_VOXELS );
+
+  atomic<bool> stop( false );
+  atomic<long> reads( 0 ), hits( 0 ), bad( 0 ), inserts( 0 ), removes( 0 );
+  long reclaims = 0;
+
+  {
+    ChunkIndex index;
+
+    // a key stands for a chunk 16 apart on x and z, 4 high
+    auto place = []( int k, float &x, float &y, float &z ) {
+      x = float( (k & 15) * Chunk::XSIZE );
+      y = float( ((k >> 4) & 3) * Chunk::YSIZE );
+      z = float( (k >> 6) * Chunk::ZSIZE );
+    };
+
+    vector<thread> crew;
+    for ( int t = 0; t < threads; t++ ) {
+      crew.push_back( thread( [&, t]() {
+        unsigned int n = 0;
+        while ( !stop.load() ) {
+          if ( t < writers ) {
+            const int k = cellHash( t, n++, 0, 7 ) % KEYS;
+            float x, y, z;
+            place( k, x, y, z );
+            if ( index.remove( k ) ) {
+              removes++;
+              continue;
+            }
+            Chunk *c = new Chunk( 0, x, y, z );
+            c->setTypeAt( 0, 0, 0, Voxel::STONE );
+            if ( index.insert( k, c ) ) inserts++;
+            else delete c;
+            continue;
+          }
+
+          Epoch::Guard guard;
+          for ( int i = 0; i < 64; i++ ) {
+            const int k = cellHash( t, n++, 1, 7 ) % KEYS;
+            Chunk *c = index.find( k );
+            reads++;
+            if ( !c ) continue;
+            hits++;
+            float x, y, z;
+            place( k, x, y, z );
+            if ( c->x() != x || c->y() != y || c->z() != z ||
+                 c->typeAt( 0, 0, 0 ) != Voxel::STONE ) bad++;
+          }
+        }
+      }));
+    }
+
+    const double start = seconds();
+    while ( seconds() - start < duration ) {
+      index.reclaim();
+      reclaims++;
+      this_thread::yield();
+    }
+    stop.store( true );
+    for ( int t = 0; t < threads; t++ ) crew[t].join();
+
+    // with every reader gone two more epochs free the rest
+    for ( int i = 0; i < 3 && index.retiring(); i++ ) index.reclaim();
+
+    cout << "threads: " << threads << " writers: " << writers
+         << " seconds: " << duration << "\n";
+    cout << "reads: " << reads.load() << " hits: " << hits.load()
+         << " inserts: " << inserts.load() << " removes: " << removes.load()
+         << " reclaim calls: " << reclaims << "\n";
+    cout << "reads/ms: " << double( reads.load() ) / ( duration * 1000.0 )
+         << " left in index: " << index.size()
+         << " left retiring: " << index.retiring() << "\n";
+  }
+
+  const long long leaked = MemoryStats::get( MemoryStats::CHUNK_VOXELS ) - before;
+  cout << "bad reads: " << bad.load() << " leaked voxel bytes: " << leaked << "\n";
+  return ( bad.load() || leaked ) ? 1 : 0;
+}
+
+int main( int argc, char **argv )
+{
+  double duration = 2.0;
+  int threads = 8;
+
+  for ( int i = 1; i < argc; i++ ) {
+    const string arg = argv[i];
+    if ( arg == "--threads" && i+1 < argc ) threads = max( 1, atoi( argv[++i] ) );
+    else if ( atof( argv[i] ) > 0 ) duration = atof( argv[i] );
+  }
+
+  return stressChunkIndex( duration, threads );
+}
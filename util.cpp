@@ -0,0 +1,32 @@
+// made by inny
+
+#include <sys/time.h>
+#include "util.h"
+
+using namespace std;
+
+float bound( float min, float val, float max )
+{
+  if ( min > val ) return min;
+  if ( max < val ) return max;
+  return val;
+}
+
+double seconds()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return double(tv.tv_sec) + double(tv.tv_usec) / 1000000.0;
+}
+
+unsigned int cellHash( int x, int y, int z, unsigned int salt )
+{
+  unsigned int h = salt * 0x9e3779b9u;
+  h ^= unsigned(x) * 0x85ebca6bu; h = (h << 13) | (h >> 19);
+  h ^= unsigned(y) * 0xc2b2ae35u; h = (h << 13) | (h >> 19);
+  h ^= unsigned(z) * 0x27d4eb2fu;
+  h ^= h >> 16; h *= 0x85ebca6bu;
+  h ^= h >> 13; h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
@@ -0,0 +1,15 @@
+// made by inny
+
+#ifndef OPENMINE_UTIL_H
+#define OPENMINE_UTIL_H
+
+float bound( float min, float val, float max );
+
+// wall clock in seconds, finer grained than SDL_GetTicks
+double seconds();
+
+// the same number for the same cell and salt every time, so generation comes
+// out alike whatever order or thread chunks are made on
+unsigned int cellHash( int x, int y, int z, unsigned int salt );
+
+#endif
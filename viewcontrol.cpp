@@ -0,0 +1,143 @@
+// made by inny
+
+#include <algorithm>
+#include "util.h"
+#include "camera.h"
+#include "world.h"
+#include "renderqueue.h"
+#include "viewcontrol.h"
+
+using namespace std;
+
+ViewControl::ViewControl( Camera &c, World &w, double frameBudget )
+  : camera(c), world(w), budget(frameBudget), automatic(true),
+    frameTime(frameBudget), gpuTime(0.0), submitTime(0.0),
+    slow(0), fast(0), settle(SETTLE_FRAMES), changes(0), timer(0)
+{
+  glGenQueries( TIMERS, timers );
+  for ( int i = 0; i < TIMERS; i++ ) timing[i] = false;
+}
+
+ViewControl::~ViewControl()
+{
+  glDeleteQueries( TIMERS, timers );
+}
+
+void ViewControl::beginGPU()
+{
+  // the oldest query comes round again, its answer is in by now or dropped
+  if ( timing[timer] ) readTimers();
+  timing[timer] = false;
+  glBeginQuery( GL_TIME_ELAPSED, timers[timer] );
+}
+
+void ViewControl::readTimers()
+{
+  for ( int i = 0; i < TIMERS; i++ ) {
+    const int t = (timer + i) % TIMERS;
+    if ( !timing[t] ) continue;
+
+    GLuint ready = 0;
+    glGetQueryObjectuiv( timers[t], GL_QUERY_RESULT_AVAILABLE, &ready );
+    if ( !ready ) continue;
+
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v( timers[t], GL_QUERY_RESULT, &ns );
+    timing[t] = false;
+    const double g = gpuTime.load();
+    gpuTime.store( g + ( double(ns) / 1000000000.0 - g ) * 0.1 );
+  }
+}
+
+void ViewControl::endGPU( double submitSeconds )
+{
+  glEndQuery( GL_TIME_ELAPSED );
+  timing[timer] = true;
+  timer = (timer + 1) % TIMERS;
+  readTimers();
+
+  const double s = submitTime.load();
+  submitTime.store( s + ( submitSeconds - s ) * 0.1 );
+}
+
+void ViewControl::endFrame( double frameSeconds )
+{
+  frameTime += ( frameSeconds - frameTime ) * 0.1;
+
+  // one slow frame is enough to hold chunk loading back on the next
+  world.setGenerateBudget( frameSeconds > budget ?
+    World::GENERATE_BUDGET * 0.25 : World::GENERATE_BUDGET );
+
+  if ( !automatic ) return;
+  if ( settle > 0 ) {
+    settle--;
+    return;
+  }
+
+  // the threads and the GPU overlap, so whichever is slowest sets the pace
+  const double cost = max( frameTime, max( submitTime.load(), gpuTime.load() ) );
+  if ( cost > budget * SLOW ) {
+    fast = 0;
+    if ( ++slow >= SLOW_FRAMES ) move( -STEP );
+  }
+  else if ( cost < budget * FAST ) {
+    slow = 0;
+    if ( ++fast >= FAST_FRAMES ) move( STEP );
+  }
+  else {
+    slow = 0;
+    fast = 0;
+  }
+}
+
+void ViewControl::move( float step )
+{
+  slow = 0;
+  fast = 0;
+
+  const float d = bound( MIN_DISTANCE, camera.viewDistance() + step, MAX_DISTANCE );
+  if ( d == camera.viewDistance() ) return;
+
+  camera.setViewDistance( d );
+  settle = SETTLE_FRAMES;
+  changes++;
+}
+
+void ViewControl::setManual( float distance )
+{
+  automatic = false;
+  camera.setViewDistance( bound( MIN_DISTANCE, distance, MAX_DISTANCE ) );
+}
+
+void ViewControl::setAutomatic( bool a )
+{
+  automatic = a;
+  slow = 0;
+  fast = 0;
+  settle = SETTLE_FRAMES;
+}
+
+void ViewControl::hud( RenderPacket &packet ) const
+{
+  const double cost = max( frameTime, max( submitTime.load(), gpuTime.load() ) );
+  const float distanceBar = 200.0 * camera.viewDistance() / MAX_DISTANCE;
+  const float costBar = 100.0 * min( cost / budget, 2.0 );
+
+  packet.line( 0.0, 4.0, distanceBar, 4.0, 0.0, automatic ? 1.0 : 0.5, 1.0 );
+  if ( cost > budget ) packet.line( 0.0, 8.0, costBar, 8.0, 1.0, 0.5, 0.0 );
+  else packet.line( 0.0, 8.0, costBar, 8.0, 0.0, 1.0, 0.0 );
+
+  // the budget mark
+  packet.line( 100.0, 2.0, 100.0, 10.0, 1.0, 1.0, 1.0 );
+}
+
+void ViewControl::report( ostream &out ) const
+{
+  out << "view distance: " << camera.viewDistance()
+      << ( automatic ? " auto" : " manual" )
+      << " budget ms: " << budget * 1000.0
+      << " frame ms: " << frameTime * 1000.0
+      << " submit ms: " << submitTime.load() * 1000.0
+      << " gpu ms: " << gpuTime.load() * 1000.0
+      << " generate ms: " << world.generationBudget() * 1000.0 << "\n";
+}
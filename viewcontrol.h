@@ -0,0 +1,89 @@
+// made by inny
+
+#ifndef OPENMINE_VIEWCONTROL_H
+#define OPENMINE_VIEWCONTROL_H
+
+#include <atomic>
+#include <ostream>
+#include "opengl.h"
+
+class Camera;
+class World;
+struct RenderPacket;
+
+// Keeps frames inside a time budget by moving the view distance. Frame and
+// GPU times are smoothed, the distance only shrinks after a run of slow
+// frames and only grows after a longer run of fast ones, and after every
+// move it waits for the timings to settle. The fog band follows the
+// distance. A slow frame also turns chunk generation down for the next one.
+//
+// The GPU side runs wherever GL does and hands its timings over through
+// atomics, so the rest can stay on the game thread.
+class ViewControl
+{
+  public:
+    static constexpr float MIN_DISTANCE = 20.0;
+    static constexpr float MAX_DISTANCE = 200.0;
+    static constexpr float STEP = 10.0;
+
+    // over this part of the budget counts as slow, under the other as fast
+    static constexpr double SLOW = 1.1;
+    static constexpr double FAST = 0.7;
+    static const int SLOW_FRAMES = 10;
+    static const int FAST_FRAMES = 60;
+    static const int SETTLE_FRAMES = 30;
+
+    // timer queries in flight, read back a few frames late so we never wait
+    static const int TIMERS = 4;
+
+  protected:
+    Camera &camera;
+    World &world;
+    double budget;
+    bool automatic;
+
+    double frameTime;
+    std::atomic<double> gpuTime;
+    std::atomic<double> submitTime;
+    int slow;
+    int fast;
+    int settle;
+    int changes;
+
+    GLuint timers[TIMERS];
+    bool timing[TIMERS];
+    int timer;
+
+    void readTimers();
+    void move( float step );
+
+  public:
+    ViewControl( Camera &c, World &w, double frameBudget = 1.0 / 60.0 );
+    virtual ~ViewControl();
+
+    // wrap the GL work of one frame; submitSeconds is the CPU time the GL
+    // thread spent on it
+    void beginGPU();
+    void endGPU( double submitSeconds );
+
+    // frameSeconds is the game thread's CPU time for the frame
+    void endFrame( double frameSeconds );
+
+    // a hand picked distance switches the controller off until it's set back
+    void setManual( float distance );
+    void setAutomatic( bool a );
+    bool isAutomatic() const { return automatic; };
+
+    void setBudget( double s ) { budget = s; };
+    double frameBudget() const { return budget; };
+    double smoothedFrame() const { return frameTime; };
+    double smoothedGPU() const { return gpuTime.load(); };
+    double smoothedSubmit() const { return submitTime.load(); };
+    int distanceChanges() const { return changes; };
+
+    // bars at the top of the 2D overlay: distance, and cost against budget
+    void hud( RenderPacket &packet ) const;
+    void report( std::ostream &out ) const;
+};
+
+#endif
@@ -0,0 +1,56 @@
+// made by inny
+
+#include "voxel.h"
+
+using namespace std;
+
+unsigned short Voxel::sharedType = 0;
+unsigned char Voxel::sharedVisible = 255;
+Voxel Voxel::shared( &Voxel::sharedType, &Voxel::sharedVisible );
+
+const Point Voxel::tiles[Voxel::TILES] = {
+  Point( 0.0, 0.0 ),
+  Point( 0.0, 16.0 ),
+  Point( 0.0, 24.0 )
+};
+
+const int Voxel::steps[Voxel::DIRECTIONS][3] = {
+  { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }
+};
+
+void Voxel::draw( vector<Face> *drawLists, float x, float y, float z, float s ) const
+{
+  if (*v == 0) return;
+
+  Vertex va( x,   y,   z );
+  Vertex vb( x,   y,   z+s );
+  Vertex vc( x,   y+s, z );
+  Vertex vd( x,   y+s, z+s );
+  Vertex ve( x+s, y,   z );
+  Vertex vf( x+s, y,   z+s );
+  Vertex vg( x+s, y+s, z );
+  Vertex vh( x+s, y+s, z+s );
+
+  const Point &top = tiles[TOP];
+  const Point &side = tiles[SIDE];
+  const Point &bottom = tiles[BOTTOM];
+
+  if (isVisible(UP)) drawLists[UP].push_back( Face( vc, vd, vh, vg, top ) );
+  if (isVisible(DOWN)) drawLists[DOWN].push_back( Face( va, ve, vf, vb, bottom ) );
+  if (isVisible(SOUTH)) drawLists[SOUTH].push_back( Face( vh, vd, vb, vf, side ) );
+  if (isVisible(NORTH)) drawLists[NORTH].push_back( Face( vc, vg, ve, va, side ) );
+  if (isVisible(EAST)) drawLists[EAST].push_back( Face( vg, vh, vf, ve, side ) );
+  if (isVisible(WEST)) drawLists[WEST].push_back( Face( vd, vc, va, vb, side ) );
+}
+
+// one 32 bit record per visible face: x, y, z bytes, 3 bits face, 5 bits tile
+void Voxel::pack( vector<GLuint> *records, int x, int y, int z ) const
+{
+  if (*v == 0) return;
+
+  const GLuint base = GLuint(x) | (GLuint(y) << 8) | (GLuint(z) << 16);
+  for ( int i = 0; i < DIRECTIONS; i++ ) {
+    if (!isVisible(i)) continue;
+    records[i].push_back( base | (GLuint(i) << 24) | (GLuint(tileFor(i)) << 27) );
+  }
+}
@@ -0,0 +1,58 @@
+// made by inny
+
+#ifndef OPENMINE_VOXEL_H
+#define OPENMINE_VOXEL_H
+
+#include <vector>
+#include "opengl.h"
+#include "geometry.h"
+
+// A handle onto one cell of a chunk. Chunks keep types and face masks in
+// separate arrays, so a Voxel just points into both.
+struct Voxel
+{
+  protected:
+    unsigned short *t;
+    unsigned char *v;
+
+    static unsigned short sharedType;
+    static unsigned char sharedVisible;
+
+  public:
+    static constexpr float SIZE = 1.0f;
+
+    // block types; water runs from WATER (level 1) to WATER+WATER_LEVELS-1
+    // (full), the level says how much further it may spread sideways
+    enum Type { AIR = 0, STONE = 1, SAND = 2, WOOD = 3, LEAVES = 4, WATER = 8 };
+    static const int WATER_LEVELS = 8;
+    static bool isWater( unsigned short t ) { return t >= WATER && t < WATER + WATER_LEVELS; };
+
+    // faces in visibility bit order: +y, -y, +z, -z, +x, -x
+    enum Direction { UP, DOWN, SOUTH, NORTH, EAST, WEST, DIRECTIONS };
+
+    // x, y, z one step along each Direction
+    static const int steps[DIRECTIONS][3];
+
+    Voxel( unsigned short *type, unsigned char *visible ): t(type), v(visible) { /* */ }
+
+    // both take one list per Direction
+    void draw( std::vector<Face> *drawLists, float x, float y, float z, float s ) const;
+    void pack( std::vector<GLuint> *records, int x, int y, int z ) const;
+
+    enum Tile { TOP, SIDE, BOTTOM, TILES };
+    static const Point tiles[TILES];
+    static Tile tileFor( int face ) { return face == 0 ? TOP : face == 1 ? BOTTOM : SIDE; };
+
+    static Voxel shared;
+    bool isShared() const { return t == &sharedType; };
+
+    unsigned short type() const { return *t; };
+    void setType( unsigned short type ) { if (!isShared()) *t = type; };
+    unsigned char visibility() const { return *v; };
+    void setVisibility( unsigned char mask ) { if (!isShared()) *v = mask; };
+
+    bool isTransparent() const { return *t==0; };
+    bool isVisible(int x) const { return (*v&(1<<x)); };
+};
+
+#endif
@@ -0,0 +1,79 @@
+// made by inny
+
+#include "workers.h"
+
+using namespace std;
+
+WorkerPool::WorkerPool( int count )
+  : job(0), next(0), items(0), generation(0), finished(0), quit(false)
+{
+  if ( count <= 0 ) count = thread::hardware_concurrency();
+  if ( count <= 0 ) count = 1;
+  for ( int i = 1; i < count; i++ )
+    threads.push_back( thread( &WorkerPool::work, this ) );
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    unique_lock<mutex> guard( lock );
+    quit = true;
+  }
+  wake.notify_all();
+  for ( int i = 0; i < threads.size(); i++ ) threads[i].join();
+}
+
+// hands out items one at a time until the range runs dry
+void WorkerPool::drain()
+{
+  while (true) {
+    const int i = next.fetch_add( 1 );
+    if ( i >= items ) break;
+    (*job)( i );
+  }
+}
+
+void WorkerPool::work()
+{
+  int seen = 0;
+  while (true) {
+    {
+      unique_lock<mutex> guard( lock );
+      wake.wait( guard, [&]{ return quit || generation != seen; } );
+      if ( quit ) return;
+      seen = generation;
+    }
+
+    drain();
+
+    unique_lock<mutex> guard( lock );
+    if ( ++finished == threads.size() ) done.notify_all();
+  }
+}
+
+void WorkerPool::run( int count, const function<void(int)> &task )
+{
+  if ( count <= 0 ) return;
+  if ( threads.empty() || count == 1 ) {
+    for ( int i = 0; i < count; i++ ) task( i );
+    return;
+  }
+
+  {
+    unique_lock<mutex> guard( lock );
+    job = &task;
+    items = count;
+    next = 0;
+    finished = 0;
+    generation++;
+  }
+  wake.notify_all();
+
+  drain();
+
+  // a worker that wakes late finds the range empty and leaves at once, but
+  // it still has to leave before job and items can change under it
+  unique_lock<mutex> guard( lock );
+  done.wait( guard, [&]{ return finished == threads.size(); } );
+  job = 0;
+}
@@ -0,0 +1,45 @@
+// made by inny
+
+#ifndef OPENMINE_WORKERS_H
+#define OPENMINE_WORKERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that split a range of work items between them.
+// The calling thread works too, and run() returns once every item is done.
+class WorkerPool
+{
+  protected:
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int)> *job;
+    std::atomic<int> next;
+    int items;
+    int generation;
+
+    // workers through with this generation; run() waits for all of them, so
+    // none is still in drain() when the next job goes in
+    int finished;
+    bool quit;
+
+    void work();
+    void drain();
+
+  public:
+    // zero picks one thread per core
+    WorkerPool( int count = 0 );
+    virtual ~WorkerPool();
+
+    int size() const { return threads.size() + 1; };
+    void run( int count, const std::function<void(int)> &task );
+};
+
+#endif
@@ -0,0 +1,783 @@
+// made by inny
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "opengl.h"
+#include "util.h"
+#include "camera.h"
+#include "column.h"
+#include "faceprogram.h"
+#include "memstats.h"
+#include "meshcache.h"
+#include "particles.h"
+#include "region.h"
+#include "workers.h"
+#include "worldgen.h"
+#include "blocksim.h"
+#include "world.h"
+
+using namespace std;
+
+World::World()
+  : renderer(DISPLAY_LISTS), faceProgram(0), occlusion(false), prepass(false),
+    drawing(0), texture(0), packedWarned(false),
+    recording(false),
+    pool(0), generator(0), meshCache(0), blockSim(0), blockClock(0),
+    particleSystem(0), particleBatch(0),
+    walkPitch(0), walkHeading(0), walkRange(0), layout(1), walkLayout(0), walkCache(true),
+    walks(0), extentX(XSIZE), extentZ(ZSIZE), generateBudget(GENERATE_BUDGET), chunksLoaded(0), messageDrop(false), drawCount(0)
+{
+  walkCell[0] = walkCell[1] = walkCell[2] = 0;
+  walkEye[0] = walkEye[1] = walkEye[2] = 0.0;
+}
+
+World::~World()
+{
+  delete particleBatch;
+  delete particleSystem;
+  delete blockSim;
+  delete generator;
+  clearChunks();
+  delete meshCache;
+  delete pool;
+  delete faceProgram;
+}
+
+void World::useWorkers( int threads )
+{
+  if (!pool) pool = new WorkerPool( threads );
+}
+
+WorkerPool &World::workers()
+{
+  if (!pool) pool = new WorkerPool();
+  return *pool;
+}
+
+WorldGen &World::generation()
+{
+  if (!generator) {
+    generator = new WorldGen( *this, workers() );
+    generator->useMeshes( meshCache );
+  }
+  return *generator;
+}
+
+void World::useMeshCache( const string &path, long budgetBytes )
+{
+  delete meshCache;
+  meshCache = new MeshCache( path, budgetBytes );
+  if (generator) generator->useMeshes( meshCache );
+}
+
+BlockSim &World::blocks()
+{
+  if (!blockSim) blockSim = new BlockSim( *this, workers() );
+  return *blockSim;
+}
+
+ParticleSystem &World::particles()
+{
+  if (!particleSystem) particleSystem = new ParticleSystem( *this );
+  return *particleSystem;
+}
+
+// keys only reach so far past the origin
+void World::setExtent( int xblocks, int zblocks )
+{
+  extentX = min( max( (xblocks + Chunk::XSIZE - 1) / Chunk::XSIZE, 1 ), KEY_REACH );
+  extentZ = min( max( (zblocks + Chunk::ZSIZE - 1) / Chunk::ZSIZE, 1 ), KEY_REACH );
+  layout++;
+}
+
+bool World::fitsBounds( float x, float y, float z ) const
+{
+  return ( x >= 0.0 && (x < extentX*Chunk::XSIZE) &&
+           y >= 0.0 && (y < World::YSIZE*Chunk::YSIZE) &&
+           z >= 0.0 && (z < extentZ*Chunk::ZSIZE) );
+}
+
+int World::hash( float x, float y, float z, bool &valid )
+{
+  const int xc = int(floor(x)) >> Chunk::XSHIFT;
+  const int yc = int(floor(y)) >> Chunk::YSHIFT;
+  const int zc = int(floor(z)) >> Chunk::ZSHIFT;
+
+  if ( xc < -KEY_REACH || xc >= KEY_REACH || zc < -KEY_REACH || zc >= KEY_REACH ||
+       yc < 0 || yc >= (MAXHEIGHT >> Chunk::YSHIFT) ) {
+    valid = false;
+    return 0;
+  }
+
+  const unsigned int xi = xc+KEY_REACH;
+  const unsigned int yi = yc;
+  const unsigned int zi = zc+KEY_REACH;
+  const unsigned int id = (yi << 26) | (zi << 13) | xi;
+  valid = true;
+  return id;
+}
+
+Chunk *World::getChunk( float x, float y, float z )
+{
+  bool valid = false;
+  const unsigned int id = hash( x, y, z, valid );
+  if (!valid) return 0;
+
+  return chunkIndex.find(id);
+}
+
+bool World::addChunk( Chunk *c, float x, float y, float z )
+{
+  bool valid = false;
+  const unsigned int id = hash( x, y, z, valid );
+  if (!valid || !chunkIndex.insert( id, c )) return false;
+  layout++;
+
+  Region *region = getRegion( x, y, z );
+  if (region) region->add( c, Region::slotOf( x, y, z ) );
+  return true;
+}
+
+Column *World::acquireColumn( float x, float z )
+{
+  bool valid = false;
+  const unsigned int id = hash( x, 0.0, z, valid );
+  if (!valid) return 0;
+
+  Column *column;
+  ColumnMap::iterator finder = columnMap.find(id);
+  if ( finder != columnMap.end() ) {
+    column = finder->second;
+  }
+  else {
+    column = new Column( int(floor( x / Chunk::XSIZE )) * Chunk::XSIZE,
+                         int(floor( z / Chunk::ZSIZE )) * Chunk::ZSIZE );
+    columnMap[id] = column;
+  }
+  column->acquire();
+  return column;
+}
+
+void World::releaseColumn( Column *c )
+{
+  if ( !c->release() ) return;
+
+  bool valid = false;
+  columnMap.erase( hash( c->x(), 0.0, c->z(), valid ) );
+  delete c;
+}
+
+int World::topSolid( int x, int z )
+{
+  bool valid = false;
+  const unsigned int id = hash( x, 0.0, z, valid );
+  if (!valid) return -1;
+
+  ColumnMap::iterator finder = columnMap.find(id);
+  if ( finder == columnMap.end() ) return -1;
+  return finder->second->top( x & Chunk::XMASK, z & Chunk::ZMASK );
+}
+
+Region *World::getRegion( float x, float y, float z )
+{
+  Region::origin( x, y, z );
+
+  bool valid = false;
+  const unsigned int id = hash( x, y, z, valid );
+  if (!valid) return 0;
+
+  RegionMap::iterator finder = regionMap.find(id);
+  if ( finder != regionMap.end() ) return finder->second;
+
+  Region *region = new Region();
+  regionMap[id] = region;
+  return region;
+}
+
+bool World::removeChunk( float x, float y, float z )
+{
+  bool valid = false;
+  const unsigned int id = hash( x, y, z, valid );
+  if (!valid) return false;
+
+  Region *region = getRegion( x, y, z );
+  if (region) region->remove( Region::slotOf( x, y, z ) );
+
+  // the chunk itself goes in update() once no thread can be reading it
+  if ( !chunkIndex.remove(id) ) return false;
+  layout++;
+  chunksLoaded--;
+  return true;
+}
+
+void World::clearChunks()
+{
+  chunkIndex.clear();
+
+  RegionMap::iterator rit;
+  for ( rit=regionMap.begin(); rit != regionMap.end(); rit++ ) {
+    delete rit->second;
+  }
+  regionMap.clear();
+}
+
+void World::draw( Camera &camera )
+{
+  record( camera, drawPacket );
+  submit( drawPacket );
+}
+
+void World::record( Camera &camera, RenderPacket &packet )
+{
+  recording = true;
+  drawCount += 1;
+  packet.frame = drawCount;
+  packet.camera = camera;
+  packet.renderer = renderer;
+  packet.occlusion = occlusion;
+  packet.prepass = prepass;
+
+  const int xp = floor(camera.x()/Chunk::XSIZE)*Chunk::XSIZE;
+  const int yp = floor(camera.y()/Chunk::YSIZE)*Chunk::YSIZE;
+  const int zp = floor(camera.z()/Chunk::ZSIZE)*Chunk::ZSIZE;
+  if ( !walkCache || walkStale( camera, xp, yp, zp ) ) walkVisible( camera, xp, yp, zp );
+
+  // the walk took in everything the camera might see before it's walked
+  // again, this keeps what it sees now
+  for ( int i = 0; i < walkFound.size(); i++ ) {
+    Chunk *chunk = walkFound[i];
+    if ( chunk->isEmpty() ) continue;
+    if ( !Chunk::visibleToCamera( camera, chunk->x(), chunk->y(), chunk->z() ) ) continue;
+
+    // whatever we knew about a chunk that left the frustum is stale
+    packet.fresh.push_back( chunk->lastDrawn() != drawCount-1 );
+    chunk->setDrawn( drawCount );
+    chunk->markShown();
+    packet.chunks.push_back( chunk );
+  }
+
+  // which face directions of each chunk could point at us
+  packet.facing.resize( packet.chunks.size() );
+  for ( int i = 0; i < packet.chunks.size(); i++ )
+    packet.facing[i] = packet.chunks[i]->facingMask( camera.x(), camera.y(), camera.z() );
+
+  if ( particleSystem ) particleSystem->record( camera, packet.particles );
+
+  messageDrop = false;
+}
+
+bool World::walkStale( const Camera &camera, int xp, int yp, int zp )
+{
+  if ( layout != walkLayout || camera.viewDistance() != walkRange ) return true;
+  if ( xp != walkCell[0] || yp != walkCell[1] || zp != walkCell[2] ) return true;
+
+  const float dx = camera.x() - walkEye[0], dy = camera.y() - walkEye[1], dz = camera.z() - walkEye[2];
+  if ( dx*dx + dy*dy + dz*dz > MOVE_BLOCKS * MOVE_BLOCKS ) return true;
+
+  float turned = fabs( camera.heading() - walkHeading );
+  if ( turned > 180.0f ) turned = 360.0f - fmod( turned, 360.0f );
+  return turned > TURN_DEGREES || fabs( camera.pitch() - walkPitch ) > TURN_DEGREES;
+}
+
+// Breadth first out from the camera's chunk through loaded chunks, over a
+// box of cells as wide as the view distance. Each sphere test is padded by
+// how far the camera can move and turn before the next walk, so what's
+// found stays a superset of what it sees until then. Missing chunks get
+// queued for loading, and chunks still waiting on a neighbour are walked
+// through but not drawn.
+void World::walkVisible( Camera &camera, int xp, int yp, int zp )
+{
+  walks++;
+  walkLayout = layout;
+  walkRange = camera.viewDistance();
+  walkPitch = camera.pitch();
+  walkHeading = camera.heading();
+  walkCell[0] = xp; walkCell[1] = yp; walkCell[2] = zp;
+  walkEye[0] = camera.x(); walkEye[1] = camera.y(); walkEye[2] = camera.z();
+  walkFound.clear();
+
+  // walked every frame it needn't look any further than the frustum
+  const float slack = Chunk::RADIUS + (walkCache ? MOVE_BLOCKS : 0.0f);
+  const float turn = walkCache ? sin( 1.5f * TURN_DEGREES / 180.0f * M_PI ) : 0.0f;
+
+  const float reach = camera.reach() * (1.0f + turn) + slack;
+  const int rx = int( ceil( reach / Chunk::XSIZE ) ) + 1;
+  const int ry = int( ceil( reach / Chunk::YSIZE ) ) + 1;
+  const int rz = int( ceil( reach / Chunk::ZSIZE ) ) + 1;
+  const int sx = 2*rx + 1, sy = 2*ry + 1, sz = 2*rz + 1;
+  const int cells = sx * sy * sz;
+  if ( walkQueue.size() < cells ) walkQueue.resize( cells );
+  walkSeen.assign( (cells + 31) / 32, 0 );
+
+  // every cell goes in at most once, so the queue never wraps
+  int head = 0, tail = 0;
+  const int start = (rz * sy + ry) * sx + rx;
+  walkSeen[start >> 5] |= 1u << (start & 31);
+  walkQueue[tail++] = start;
+
+  while ( head < tail ) {
+    const int at = walkQueue[head++];
+    const int cx = at % sx, cy = (at / sx) % sy, cz = at / (sx * sy);
+    const int xi = xp + (cx - rx) * Chunk::XSIZE;
+    const int yi = yp + (cy - ry) * Chunk::YSIZE;
+    const int zi = zp + (cz - rz) * Chunk::ZSIZE;
+
+    const float mx = xi + 0.5f*Chunk::XSIZE - camera.x();
+    const float my = yi + 0.5f*Chunk::YSIZE - camera.y();
+    const float mz = zi + 0.5f*Chunk::ZSIZE - camera.z();
+    const float away = sqrt( mx*mx + my*my + mz*mz );
+    if ( !camera.frustumContainsSphere( xi + 0.5f*Chunk::XSIZE, yi + 0.5f*Chunk::YSIZE,
+                                        zi + 0.5f*Chunk::ZSIZE, slack + away * turn ) )
+      continue;
+
+    Chunk *chunk = getChunk( xi, yi, zi );
+    if ( !chunk ) {
+      if ( fitsBounds(xi, yi, zi) ) chunkLoadList.push_back( Vertex(xi, yi, zi) );
+      continue;
+    }
+
+    // a new chunk with a side still open isn't meshed until its neighbour
+    // turns up, it would only be meshed again then
+    if ( chunk->state() == Chunk::GENERATED ) {
+      for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+        const int *s = Voxel::steps[d];
+        const int xn = xi + s[0]*Chunk::XSIZE, yn = yi + s[1]*Chunk::YSIZE, zn = zi + s[2]*Chunk::ZSIZE;
+        if ( !chunk->sideCulled( d ) && fitsBounds( xn, yn, zn ) && !getChunk( xn, yn, zn ) )
+          chunkLoadList.push_back( Vertex(xn, yn, zn) );
+      }
+    }
+    else walkFound.push_back( chunk );
+
+    for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+      const int *s = Voxel::steps[d];
+      const int nx = cx + s[0], ny = cy + s[1], nz = cz + s[2];
+      if ( nx < 0 || ny < 0 || nz < 0 || nx >= sx || ny >= sy || nz >= sz ) continue;
+      const int next = (nz * sy + ny) * sx + nx;
+      if ( walkSeen[next >> 5] & (1u << (next & 31)) ) continue;
+      walkSeen[next >> 5] |= 1u << (next & 31);
+      walkQueue[tail++] = next;
+    }
+  }
+}
+
+void World::submit( const RenderPacket &packet )
+{
+  frameStats.reset();
+  const Camera &camera = packet.camera;
+
+  drawChunks.assign( packet.chunks.begin(), packet.chunks.end() );
+  drawFacing.assign( packet.facing.begin(), packet.facing.end() );
+  for ( int i = 0; i < drawChunks.size(); i++ )
+    if ( packet.fresh[i] ) drawChunks[i]->setOccluded( false );
+
+  if (packet.occlusion) {
+    cullOccluded( packet.frame,
+                  floor(camera.x()/Chunk::XSIZE)*Chunk::XSIZE,
+                  floor(camera.y()/Chunk::YSIZE)*Chunk::YSIZE,
+                  floor(camera.z()/Chunk::ZSIZE)*Chunk::ZSIZE );
+  }
+
+  int r = packet.renderer;
+  if ( r == PACKED_FACES && !packedReady() ) r = DISPLAY_LISTS;
+
+  // stale meshes are rebuilt from the voxels, so edits wait; the draws after
+  // only touch what this thread built
+  {
+    lock_guard<mutex> hold( edits );
+    if ( r == REGION_BATCHES ) {
+      for ( int i = 0; i < drawChunks.size(); i++ ) {
+        Region *region = drawChunks[i]->memberOf();
+        if ( !region->hasVisible() ) drawRegions.push_back( region );
+        region->markVisible( drawChunks[i]->memberSlot(), drawFacing[i],
+                             drawChunks[i]->distanceTo( camera.x(), camera.y(), camera.z() ) );
+      }
+      for ( int i = 0; i < drawRegions.size(); i++ ) drawRegions[i]->prepare();
+    }
+    else {
+      for ( int i = 0; i < drawChunks.size(); i++ )
+        drawChunks[i]->prepare( r == PACKED_FACES );
+    }
+  }
+
+  // fog and the tile atlas for everything in the scene, fill or wire
+  DrawState scene;
+  scene.texture = texture;
+  scene.fog = camera.fogEnabled();
+  scene.polygon = packet.wireframe ? GL_LINE : GL_FILL;
+  float fogStart, fogEnd;
+  camera.fogRange( fogStart, fogEnd );
+  drawQueue.glState().fogRange( fogStart, fogEnd );
+
+  drawing = &packet;
+  queueChunks( packet, r, scene );
+
+  // boxes go after the scene so its depth buffer does the occluding
+  if (packet.occlusion) {
+    DrawState boxes = scene;
+    boxes.texture = 0;
+    boxes.colorWrite = false;
+    boxes.depthWrite = false;
+    boxes.cull = false;
+    const int state = drawQueue.state( boxes );
+    for ( int i = 0; i < queryChunks.size(); i++ )
+      drawQueue.add( DrawQueue::QUERIES, state, 0.0, this, DRAW_QUERY, i );
+    frameStats.queries = queryChunks.size();
+  }
+
+  if ( !packet.particles.empty() ) {
+    if ( !particleBatch ) particleBatch = new ParticleBatch();
+    DrawState quads = scene;
+    quads.arrays = true;
+    drawQueue.add( DrawQueue::EFFECTS, drawQueue.state( quads ), 0.0, this, DRAW_PARTICLES, 0 );
+  }
+
+  drawQueue.flush( frameStats );
+  drawing = 0;
+
+  for ( int i = 0; i < drawRegions.size(); i++ ) drawRegions[i]->clearVisible();
+  drawRegions.clear();
+  drawChunks.clear();
+  queryChunks.clear();
+
+  // packets hold chunk pointers without a guard, and every slot of the ring
+  // can name a chunk removed after it was recorded. Only this moves the
+  // epoch on while recording, once per packet drawn, so SLOTS + 1 moves
+  // after a removal no packet naming the chunk is left. Its destructor
+  // wants the lock for the column
+  lock_guard<mutex> hold( edits );
+  chunkIndex.reclaim( RenderQueue::SLOTS + 1 );
+}
+
+// the chunks, or their regions, nearest first. With the prepass they go
+// twice: depth alone, then colour only where it matches what's there
+void World::queueChunks( const RenderPacket &packet, int r, const DrawState &scene )
+{
+  const Camera &camera = packet.camera;
+  DrawState opaque = scene;
+  opaque.arrays = ( r == REGION_BATCHES );
+  opaque.program = ( r == PACKED_FACES ) ? faceProgram : 0;
+
+  // the face program wants its texture and fog whatever it's writing
+  DrawState depth = opaque;
+  depth.colorWrite = false;
+  if ( !depth.program ) depth.texture = 0;
+  if (packet.prepass) opaque.depthWrite = false;
+  const int opaqueState = drawQueue.state( opaque );
+  const int depthState = packet.prepass ? drawQueue.state( depth ) : 0;
+
+  const float ex = camera.x(), ey = camera.y(), ez = camera.z();
+  if ( r == REGION_BATCHES ) {
+    for ( int i = 0; i < drawRegions.size(); i++ ) {
+      const float d = drawRegions[i]->nearest();
+      drawQueue.add( DrawQueue::OPAQUE, opaqueState, d, this, DRAW_REGION, i );
+      if (packet.prepass) drawQueue.add( DrawQueue::PREPASS, depthState, d, this, DRAW_REGION, i );
+    }
+    return;
+  }
+
+  const int kind = ( r == PACKED_FACES ) ? DRAW_PACKED : DRAW_LIST;
+  for ( int i = 0; i < drawChunks.size(); i++ ) {
+    const float d = drawChunks[i]->distanceTo( ex, ey, ez );
+    drawQueue.add( DrawQueue::OPAQUE, opaqueState, d, this, kind, i );
+    if (packet.prepass) drawQueue.add( DrawQueue::PREPASS, depthState, d, this, kind, i );
+  }
+}
+
+// the queue calls back for each item, in its order and with its state set
+void World::drawItem( int kind, int index, int pass, RenderStats &stats )
+{
+  const bool counted = ( pass != DrawQueue::PREPASS );
+  switch (kind) {
+    case DRAW_LIST:
+    case DRAW_PACKED: {
+      Chunk *chunk = drawChunks[index];
+      if ( kind == DRAW_LIST ) chunk->draw( drawFacing[index] );
+      else chunk->drawPacked( *faceProgram, drawFacing[index] );
+      stats.drawCalls++;
+      stats.vertices += chunk->vertexCount( drawFacing[index] );
+      if (counted) {
+        stats.meshBytes += ( kind == DRAW_LIST ) ? chunk->listBytes() : chunk->packedBytes();
+        stats.chunks++;
+      }
+      break;
+    }
+    case DRAW_REGION: {
+      if (counted) {
+        drawRegions[index]->draw( stats );
+        break;
+      }
+      RenderStats depth;
+      drawRegions[index]->draw( depth );
+      stats.drawCalls += depth.drawCalls;
+      stats.vertices += depth.vertices;
+      break;
+    }
+    case DRAW_QUERY:
+      queryChunks[index]->issueQuery();
+      break;
+    case DRAW_PARTICLES:
+      particleBatch->draw( drawing->particles, stats );
+      break;
+  }
+}
+
+bool World::packedReady()
+{
+  if (!faceProgram) faceProgram = new FaceProgram();
+  if ( !faceProgram->isValid() && !packedWarned ) {
+    cout << "packed faces need GLSL 1.30, using display lists\n";
+    packedWarned = true;
+  }
+  return faceProgram->isValid();
+}
+
+// Coherent hierarchical culling, flattened to the chunk level. Answers from
+// earlier frames decide what gets drawn now: hidden chunks are skipped and
+// asked about again every frame, visible ones are drawn and re-asked a slice
+// at a time. The camera's own chunk and its neighbours are always drawn since
+// their boxes can reach through the near plane.
+void World::cullOccluded( int frame, int xp, int yp, int zp )
+{
+  int kept = 0;
+  for ( int i = 0; i < drawChunks.size(); i++ ) {
+    Chunk *chunk = drawChunks[i];
+    chunk->pollQuery();
+
+    const int cx = (int(chunk->x()) - xp) / Chunk::XSIZE;
+    const int cy = (int(chunk->y()) - yp) / Chunk::YSIZE;
+    const int cz = (int(chunk->z()) - zp) / Chunk::ZSIZE;
+    if ( abs(cx) <= 1 && abs(cy) <= 1 && abs(cz) <= 1 ) {
+      chunk->setOccluded( false );
+      drawFacing[kept] = drawFacing[i];
+      drawChunks[kept++] = chunk;
+      continue;
+    }
+
+    if ( chunk->isOccluded() ) {
+      if ( !chunk->queryPending() ) queryChunks.push_back( chunk );
+      frameStats.occluded++;
+      continue;
+    }
+
+    // stagger the rechecks over the grid so each frame asks about a few
+    const int stagger = (cx * 3 + cy * 5 + cz * 7) & 0xffff;
+    if ( !chunk->queryPending() && (frame + stagger) % RECHECK_FRAMES == 0 )
+      queryChunks.push_back( chunk );
+    drawFacing[kept] = drawFacing[i];
+    drawChunks[kept++] = chunk;
+  }
+  drawChunks.resize( kept );
+  drawFacing.resize( kept );
+}
+
+const char *World::rendererName( int r )
+{
+  switch (r) {
+    case DISPLAY_LISTS: return "lists";
+    case REGION_BATCHES: return "regions";
+    case PACKED_FACES: return "packed";
+  }
+  return "unknown";
+}
+
+int World::rendererByName( const string &name )
+{
+  for ( int r = 0; r < RENDERERS; r++ )
+    if ( name == rendererName(r) ) return r;
+  return -1;
+}
+
+Voxel World::voxel( int x, int y, int z )
+{
+  Chunk *chunk = getChunk( x, y, z );
+  if (!chunk) return Voxel::shared;
+
+  int vx = x & Chunk::XMASK;
+  int vy = y & Chunk::YMASK;
+  int vz = z & Chunk::ZMASK;
+  return chunk->voxel(vx, vy, vz);
+}
+
+// returns the chunk covering a point, running the generator until it's made
+Chunk *World::loadChunk( float x, float y, float z )
+{
+  const float xp = floor( x / Chunk::XSIZE ) * Chunk::XSIZE;
+  const float yp = floor( y / Chunk::YSIZE ) * Chunk::YSIZE;
+  const float zp = floor( z / Chunk::ZSIZE ) * Chunk::ZSIZE;
+  if ( !fitsBounds(xp, yp, zp) ) return 0;
+
+  Chunk *chunk = getChunk( xp, yp, zp );
+  if (chunk) return chunk;
+
+  generation().request( xp, yp, zp );
+  while ( !chunk ) {
+    const bool ran = generator->step();
+    adoptGenerated();
+    chunk = getChunk( xp, yp, zp );
+    if ( !ran ) break;
+  }
+  return chunk;
+}
+
+Chunk *World::blankChunk( float x, float y, float z )
+{
+  Chunk *chunk = getChunk( x, y, z );
+  if (chunk) return chunk;
+  return placeChunk( x, y, z, 0 );
+}
+
+Chunk *World::placeChunk( float x, float y, float z, const unsigned short *types )
+{
+  const float xp = floor( x / Chunk::XSIZE ) * Chunk::XSIZE;
+  const float yp = floor( y / Chunk::YSIZE ) * Chunk::YSIZE;
+  const float zp = floor( z / Chunk::ZSIZE ) * Chunk::ZSIZE;
+  if ( getChunk( xp, yp, zp ) ) return 0;
+
+  Chunk *chunk = new Chunk( this, xp, yp, zp );
+  if (types) {
+    for ( int cz = 0; cz < Chunk::ZSIZE; cz++ )
+      for ( int cy = 0; cy < Chunk::YSIZE; cy++ )
+        chunk->writeRow( 0, Chunk::XSIZE, cy, cz, types + (cz * Chunk::YSIZE + cy) * Chunk::XSIZE );
+  }
+  if ( !addChunk( chunk, xp, yp, zp ) ) {
+    delete chunk;
+    return 0;
+  }
+  chunk->cullFaces();
+  settle( chunk );
+  chunksLoaded++;
+  return chunk;
+}
+
+bool World::unloadChunk( Chunk *c )
+{
+  return removeChunk( c->x(), c->y(), c->z() );
+}
+
+// a removed chunk waits out two epoch moves, and with nothing reading each
+// call makes one, so this goes round until they're all gone
+void World::reclaim()
+{
+  for ( int i = 0; i < 3 && chunkIndex.retiring(); i++ ) chunkIndex.reclaim();
+
+  RegionMap::iterator rit = regionMap.begin();
+  while ( rit != regionMap.end() ) {
+    if ( rit->second->isEmpty() ) {
+      delete rit->second;
+      regionMap.erase( rit++ );
+    }
+    else rit++;
+  }
+}
+
+// synchronously generates everything left inside the bounds
+void World::loadAll( vector<Chunk*> &loaded )
+{
+  for ( int z = 0; z < extentZ; z++ ) {
+    for ( int y = 0; y < YSIZE; y++ ) {
+      for ( int x = 0; x < extentX; x++ ) {
+        const float xp = x * Chunk::XSIZE;
+        const float yp = y * Chunk::YSIZE;
+        const float zp = z * Chunk::ZSIZE;
+        if ( !getChunk( xp, yp, zp ) ) generation().request( xp, yp, zp );
+      }
+    }
+  }
+  generateRequested( loaded );
+}
+
+void World::generateRequested( vector<Chunk*> &loaded )
+{
+  while ( generation().pending() && generator->step() ) adoptGenerated( &loaded );
+  adoptGenerated( &loaded );
+}
+
+// finished chunks come out culled against their final neighbours, and those
+// neighbours waited for them in turn, so nothing around needs another pass
+// unless something was edited next to a chunk that hadn't loaded yet
+void World::adoptGenerated( vector<Chunk*> *adopted )
+{
+  vector<Chunk*> done;
+  generator->collect( done );
+  for ( int i = 0; i < done.size(); i++ ) {
+    addChunk( done[i], done[i]->x(), done[i]->y(), done[i]->z() );
+    chunksLoaded++;
+  }
+  for ( int i = 0; i < done.size(); i++ ) settle( done[i] );
+  if (adopted) adopted->insert( adopted->end(), done.begin(), done.end() );
+}
+
+// where either chunk on a shared wall was culled without the other there,
+// the one cell slabs on both sides of it are culled again and nothing else
+void World::settle( Chunk *c )
+{
+  Chunk *near[27];
+  for ( int d = 0; d < Voxel::DIRECTIONS; d++ ) {
+    const int *s = Voxel::steps[d];
+    Chunk *n = getChunk( c->x() + s[0]*Chunk::XSIZE, c->y() + s[1]*Chunk::YSIZE,
+                         c->z() + s[2]*Chunk::ZSIZE );
+    const int back = d ^ 1;
+    if ( !n || (c->sideCulled( d ) && n->sideCulled( back )) ) continue;
+
+    around( c, near );
+    c->cullSide( near, d );
+    c->invalidateMesh();
+    around( n, near );
+    n->cullSide( near, back );
+    n->invalidateMesh();
+  }
+}
+
+void World::around( Chunk *c, Chunk **near )
+{
+  for ( int dz = -1; dz <= 1; dz++ )
+    for ( int dy = -1; dy <= 1; dy++ )
+      for ( int dx = -1; dx <= 1; dx++ )
+        near[ (dx+1) + (dy+1)*3 + (dz+1)*9 ] =
+          getChunk( c->x() + dx*Chunk::XSIZE, c->y() + dy*Chunk::YSIZE, c->z() + dz*Chunk::ZSIZE );
+}
+
+void World::update( float dt )
+{
+  lock_guard<mutex> hold( edits );
+
+  // once something draws, submit() frees removed chunks on the GL thread
+  if (!recording) chunkIndex.reclaim();
+
+  if ( blockSim ) {
+    // drop time rather than spiral when a tick runs long
+    blockClock = min( blockClock + dt, 4 * BLOCK_TICK );
+    while ( blockClock >= BLOCK_TICK ) {
+      blockSim->tick();
+      blockClock -= BLOCK_TICK;
+    }
+  }
+
+  // after the blocks, so crumbs see what just fell
+  if ( particleSystem ) particleSystem->step( dt );
+
+  if ( chunksLoaded >= (extentX * YSIZE * extentZ) ) {
+    chunkLoadList.clear();
+    return;
+  }
+
+  // draw() queues every missing chunk its walks run into
+  for ( int i = 0; i < chunkLoadList.size(); i++ ) {
+    const Vertex &v = chunkLoadList[i];
+    if ( messageDrop ) cout << "ChunkLoad: " << v.x() << " " << v.y() << " " << v.z() << "\n";
+    generation().request( v.x(), v.y(), v.z() );
+  }
+  chunkLoadList.clear();
+
+  if ( generator ) {
+    const double start = seconds();
+    while ( generator->pending() && seconds() - start < generateBudget ) {
+      const bool ran = generator->step();
+      adoptGenerated();
+      if ( !ran ) break;
+    }
+    MemoryStats::set( MemoryStats::LOAD_QUEUE, generator->pending() );
+  }
+}
@@ -0,0 +1,285 @@
+// made by inny
+
+#ifndef OPENMINE_WORLD_H
+#define OPENMINE_WORLD_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "geometry.h"
+#include "voxel.h"
+#include "chunk.h"
+#include "chunkindex.h"
+#include "renderqueue.h"
+#include "drawqueue.h"
+
+class Camera;
+class Column;
+class Region;
+class FaceProgram;
+class WorkerPool;
+class BlockSim;
+class WorldGen;
+class MeshCache;
+class ParticleSystem;
+class ParticleBatch;
+
+// blocks from the bottom of the world to the top, pick with
+// OPENMINE_WORLD_HEIGHT
+#ifndef OPENMINE_WORLD_HEIGHT
+#define OPENMINE_WORLD_HEIGHT 80
+#endif
+
+struct RenderStats
+{
+  int drawCalls;
+  int vertices;
+  int chunks;
+  int meshBytes;
+  int occluded;
+  int queries;
+  int particles;
+
+  // GL state calls the draw queue sent and held back as already set, and
+  // samples the opaque pass wrote per pixel a couple of frames ago
+  int stateChanges;
+  int stateSkipped;
+  float overdraw;
+
+  RenderStats() { reset(); };
+  void reset() { drawCalls = 0; vertices = 0; chunks = 0; meshBytes = 0; occluded = 0; queries = 0; particles = 0;
+                 stateChanges = 0; stateSkipped = 0; overdraw = 0; };
+};
+
+// -----------------------------------------------------------------------------
+
+class World : public Drawable
+{
+  public:
+    // chunk keys hold x and z in 13 bits each, either side of the origin,
+    // and y in the 6 bits above; nothing hashes above MAXHEIGHT blocks
+    static const int KEY_REACH = 4096;
+    static const int MAXHEIGHT = 64 * Chunk::YSIZE;
+
+    // world extent in blocks, the chunk grid is rounded up to cover it
+    static const int XBLOCKS = 80;
+    static const int YBLOCKS = OPENMINE_WORLD_HEIGHT;
+    static const int ZBLOCKS = 80;
+    static const int XSIZE = (XBLOCKS + Chunk::XSIZE - 1) / Chunk::XSIZE;
+    static const int YSIZE = (YBLOCKS + Chunk::YSIZE - 1) / Chunk::YSIZE;
+    static const int ZSIZE = (ZBLOCKS + Chunk::ZSIZE - 1) / Chunk::ZSIZE;
+
+    // the terrain is shaped for this many blocks. The chunk rows covering it
+    // are generated, the ones above start out empty until something's built
+    static const int GROUND = 80;
+    static const int GROUND_ROWS = (GROUND + Chunk::YSIZE - 1) / Chunk::YSIZE;
+    static_assert( YBLOCKS >= GROUND && YBLOCKS <= MAXHEIGHT,
+                   "the world must cover the terrain and fit the chunk keys" );
+
+    // time a frame may spend generating chunks, unless it's been turned down
+    static constexpr double GENERATE_BUDGET = 0.004;
+
+    // sand and water step at a fixed rate
+    static constexpr float BLOCK_TICK = 0.05;
+
+    // a visible chunk gets its box queried again every this many frames
+    static const int RECHECK_FRAMES = 8;
+
+    // the camera may turn or move this far before the visible chunks are
+    // walked again
+    static constexpr float TURN_DEGREES = 5.0;
+    static constexpr float MOVE_BLOCKS = 4.0;
+
+    enum Renderer {
+      DISPLAY_LISTS,
+      REGION_BATCHES,
+      PACKED_FACES,
+      RENDERERS
+    };
+
+  protected:
+    ChunkIndex chunkIndex;
+
+    typedef std::map<unsigned int, Column*> ColumnMap;
+    ColumnMap columnMap;
+
+    typedef std::map<unsigned int, Region*> RegionMap;
+    RegionMap regionMap;
+    std::vector<Region*> drawRegions;
+    std::vector<Chunk*> drawChunks;
+    std::vector<unsigned char> drawFacing;
+    int renderer;
+    FaceProgram *faceProgram;
+
+    bool occlusion;
+    bool prepass;
+    std::vector<Chunk*> queryChunks;
+
+    // every draw goes through here, the packet's in it while it flushes
+    enum DrawKind { DRAW_LIST, DRAW_PACKED, DRAW_REGION, DRAW_QUERY, DRAW_PARTICLES };
+    DrawQueue drawQueue;
+    const RenderPacket *drawing;
+    GLuint texture;
+    bool packedWarned;
+
+    // held while anything edits chunks or reads their voxels for a mesh
+    std::mutex edits;
+    RenderPacket drawPacket;
+    bool recording;
+
+    WorkerPool *pool;
+    WorldGen *generator;
+    MeshCache *meshCache;
+    BlockSim *blockSim;
+    float blockClock;
+    ParticleSystem *particleSystem;
+    ParticleBatch *particleBatch;
+
+    // what the last walk out from the camera found, in the order it found
+    // them, kept until the camera leaves its chunk, moves or turns past the
+    // limits above, sees further or a chunk comes or goes
+    std::vector<Chunk*> walkFound;
+    int walkCell[3];
+    float walkEye[3];
+    float walkPitch;
+    float walkHeading;
+    float walkRange;
+    unsigned int layout;
+    unsigned int walkLayout;
+    bool walkCache;
+    int walks;
+
+    // sized to the view distance and kept, so a walk allocates nothing
+    std::vector<int> walkQueue;
+    std::vector<unsigned int> walkSeen;
+
+    std::vector<Vertex> chunkLoadList;
+    int extentX;
+    int extentZ;
+    double generateBudget;
+    int chunksLoaded;
+    bool messageDrop;
+    int drawCount;
+    RenderStats frameStats;
+
+    static int hash( float x, float y, float z, bool &valid );
+    Chunk *getChunk( float x, float y, float z );
+    bool addChunk( Chunk *c, float x, float y, float z );
+    bool removeChunk( float x, float y, float z );
+    void clearChunks();
+    void adoptGenerated( std::vector<Chunk*> *adopted = 0 );
+    void settle( Chunk *c );
+    void around( Chunk *c, Chunk **near );
+
+    Region *getRegion( float x, float y, float z );
+    bool packedReady();
+    void queueChunks( const RenderPacket &packet, int r, const DrawState &scene );
+    bool walkStale( const Camera &camera, int xp, int yp, int zp );
+    void walkVisible( Camera &camera, int xp, int yp, int zp );
+    void cullOccluded( int frame, int xp, int yp, int zp );
+
+  public:
+    World();
+    virtual ~World();
+
+    // draw() is record() then submit(). Split, record() culls on the game
+    // thread and submit() makes every GL call on the render thread
+    void draw( Camera &camera );
+    void record( Camera &camera, RenderPacket &packet );
+    void submit( const RenderPacket &packet );
+    void update( float dt );
+
+    // take this to edit chunks outside update(), which holds it itself
+    std::mutex &editLock() { return edits; };
+    void loadAll( std::vector<Chunk*> &loaded );
+    Chunk *loadChunk( float x, float y, float z );
+
+    // runs the generator until everything requested of it has loaded
+    void generateRequested( std::vector<Chunk*> &loaded );
+
+    // the chunk covering a point, or an all air one the generator never
+    // touches, so tools and benchmarks can build past the terrain
+    Chunk *blankChunk( float x, float y, float z );
+
+    // a chunk made from types given x fastest, then y, then z, as if it had
+    // been generated; 0 if there's one there already or it's out of reach
+    Chunk *placeChunk( float x, float y, float z, const unsigned short *types );
+
+    // the chunk goes from the world at once and is deleted by reclaim(),
+    // which also drops regions left with nothing in them. Only for tools
+    // and servers, nothing may be drawing
+    bool unloadChunk( Chunk *c );
+    void reclaim();
+
+    // all made on first use; useWorkers() picks how many threads the pool
+    // gets, before anything has used it
+    void useWorkers( int threads );
+    WorkerPool &workers();
+    WorldGen &generation();
+    BlockSim &blocks();
+
+    // stepped by update() and drawn with the chunks once something's
+    // asked for it
+    ParticleSystem &particles();
+
+    // keeps culled meshes in a file between runs, see MeshCache; call
+    // before anything generates. Chunks point into it, so it goes last
+    void useMeshCache( const std::string &path, long budgetBytes );
+    MeshCache *meshes() const { return meshCache; };
+
+    // chunks load from the origin out to this many blocks along x and z,
+    // XBLOCKS by ZBLOCKS unless changed. The terrain doesn't move with it,
+    // though chunks on the edge miss the trees of the ones past it
+    void setExtent( int xblocks, int zblocks );
+    int extentBlocksX() const { return extentX * Chunk::XSIZE; };
+    int extentBlocksZ() const { return extentZ * Chunk::ZSIZE; };
+    bool fitsBounds( float x, float y, float z ) const;
+
+    // chunks hold on to the column they stand in while they're loaded
+    Column *acquireColumn( float x, float z );
+    void releaseColumn( Column *c );
+
+    // highest solid block seen at x, z, or -1 if no chunk there has loaded
+    int topSolid( int x, int z );
+
+    Voxel voxel( int x, int y, int z );
+    Chunk *chunkAt( float x, float y, float z ) { return getChunk( x, y, z ); };
+    void dropMessage() { messageDrop = true; };
+
+    int loadedChunks() const { return chunksLoaded; };
+
+    // bumped whenever a chunk is added or removed
+    unsigned int layoutStamp() const { return layout; };
+    const RenderStats &stats() const { return frameStats; };
+
+    void setRenderer( int r ) { renderer = r; };
+    int currentRenderer() const { return renderer; };
+    static const char *rendererName( int r );
+    static int rendererByName( const std::string &name );
+
+    // off walks every frame, for comparing
+    void setVisibilityCache( bool c ) { walkCache = c; };
+    int visibilityWalks() const { return walks; };
+
+    void setOcclusion( bool o ) { occlusion = o; };
+    bool occlusionEnabled() const { return occlusion; };
+
+    // lays down the chunks' depth before drawing them, so each pixel's
+    // colour is drawn once
+    void setPrepass( bool p ) { prepass = p; };
+    bool prepassEnabled() const { return prepass; };
+
+    // the tile atlas the chunks and particles draw with
+    void useTexture( GLuint t ) { texture = t; };
+
+    // anything queued before submit() is drawn in key order along with the
+    // world, see DrawQueue
+    DrawQueue &draws() { return drawQueue; };
+    void drawItem( int kind, int index, int pass, RenderStats &stats );
+
+    void setGenerateBudget( double s ) { generateBudget = s; };
+    double generationBudget() const { return generateBudget; };
+};
+
+#endif
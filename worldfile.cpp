@@ -0,0 +1,231 @@
+// made by inny
+
+#include <cstring>
+#include "net.h"
+#include "worldfile.h"
+
+using namespace std;
+
+namespace {
+  const char MAGIC[4] = { 'O', 'M', 'W', 'D' };
+
+  struct CrcTable
+  {
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+      for ( uint32_t i = 0; i < 256; i++ ) {
+        uint32_t c = i;
+        for ( int k = 0; k < 8; k++ ) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        entries[i] = c;
+      }
+    };
+  };
+
+  const CrcTable crcTable;
+
+  // the types as little endian u16s, without copying them out first
+  uint32_t typesCrc( const unsigned short *types, int count )
+  {
+    uint32_t c = 0xFFFFFFFF;
+    for ( int i = 0; i < count; i++ ) {
+      c = crcTable.entries[ (c ^ types[i]) & 0xFF ] ^ (c >> 8);
+      c = crcTable.entries[ (c ^ (types[i] >> 8)) & 0xFF ] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+  }
+
+  void putSum( uint32_t &sum, uint32_t crc )
+  {
+    const unsigned char bytes[4] = { (unsigned char)(crc & 0xFF), (unsigned char)((crc >> 8) & 0xFF),
+                                     (unsigned char)((crc >> 16) & 0xFF), (unsigned char)(crc >> 24) };
+    sum = crc32( bytes, 4, sum );
+  }
+}
+
+uint32_t crc32( const void *data, size_t bytes, uint32_t crc )
+{
+  const unsigned char *p = (const unsigned char*)data;
+  uint32_t c = crc ^ 0xFFFFFFFF;
+  for ( size_t i = 0; i < bytes; i++ ) c = crcTable.entries[ (c ^ p[i]) & 0xFF ] ^ (c >> 8);
+  return c ^ 0xFFFFFFFF;
+}
+
+// -----------------------------------------------------------------------------
+
+WorldWriter::WorldWriter( const string &path, int xblocks, int yblocks, int zblocks )
+  : file(0), count(0), sum(0), written(0), good(false)
+{
+  file = fopen( path.c_str(), "wb" );
+  if (!file) return;
+  good = true;
+
+  MessageWriter out( buffer, WORLD_HEADER );
+  for ( int i = 0; i < 4; i++ ) out.putU8( MAGIC[i] );
+  out.putU32( FORMAT );
+  out.putU32( Chunk::XSIZE );
+  out.putU32( Chunk::YSIZE );
+  out.putU32( Chunk::ZSIZE );
+  out.putU32( xblocks );
+  out.putU32( yblocks );
+  out.putU32( zblocks );
+  out.finish();
+  put( buffer );
+}
+
+// a writer that never finished leaves a file without an end, which readers
+// turn down
+WorldWriter::~WorldWriter()
+{
+  if (file) fclose( file );
+}
+
+void WorldWriter::put( const vector<unsigned char> &message )
+{
+  if ( !file || message.empty() ) return;
+  if ( fwrite( &message[0], 1, message.size(), file ) != message.size() ) good = false;
+  written += message.size();
+}
+
+uint32_t WorldWriter::encode( const Chunk &c, vector<unsigned char> &out )
+{
+  vector<unsigned short> types( Chunk::VOLUME );
+  for ( int z = 0; z < Chunk::ZSIZE; z++ )
+    for ( int y = 0; y < Chunk::YSIZE; y++ )
+      c.readRow( 0, Chunk::XSIZE, y, z, &types[ (z * Chunk::YSIZE + y) * Chunk::XSIZE ] );
+  const uint32_t crc = typesCrc( &types[0], Chunk::VOLUME );
+
+  MessageWriter message( out, WORLD_CHUNK );
+  message.putI32( int(c.x()) );
+  message.putI32( int(c.y()) );
+  message.putI32( int(c.z()) );
+  message.putU32( crc );
+  rleEncode( &types[0], Chunk::VOLUME, message );
+  message.finish();
+  return crc;
+}
+
+void WorldWriter::write( const vector<unsigned char> &message, uint32_t crc )
+{
+  put( message );
+  putSum( sum, crc );
+  count++;
+}
+
+bool WorldWriter::finish()
+{
+  if (!file) return false;
+
+  buffer.clear();
+  MessageWriter out( buffer, WORLD_END );
+  out.putU32( count );
+  out.putU32( sum );
+  out.finish();
+  put( buffer );
+
+  if ( fclose( file ) != 0 ) good = false;
+  file = 0;
+  return good;
+}
+
+// -----------------------------------------------------------------------------
+
+WorldReader::WorldReader( const string &path )
+  : file(0), count(0), sum(0), ended(false), readBytes(0)
+{
+  for ( int i = 0; i < 3; i++ ) chunkSize[i] = worldSize[i] = 0;
+
+  file = fopen( path.c_str(), "rb" );
+  if (!file) {
+    fail( "can't open " + path );
+    return;
+  }
+
+  vector<unsigned char> header;
+  if ( !read( header ) ) return;
+
+  MessageReader in( &header[0], header.size() );
+  char magic[4];
+  const int type = in.getU8();
+  for ( int i = 0; i < 4; i++ ) magic[i] = in.getU8();
+  const unsigned int format = in.getU32();
+  for ( int i = 0; i < 3; i++ ) chunkSize[i] = in.getU32();
+  for ( int i = 0; i < 3; i++ ) worldSize[i] = in.getU32();
+
+  if ( !in.ok() || type != WORLD_HEADER || memcmp( magic, MAGIC, 4 ) != 0 ) {
+    fail( path + " isn't a world file" );
+  }
+  else if ( format != WorldWriter::FORMAT ) {
+    fail( path + " is a format this build doesn't read" );
+  }
+  else if ( chunkSize[0] != Chunk::XSIZE || chunkSize[1] != Chunk::YSIZE ||
+            chunkSize[2] != Chunk::ZSIZE ) {
+    fail( path + " was baked with other chunk sizes" );
+  }
+}
+
+WorldReader::~WorldReader()
+{
+  if (file) fclose( file );
+}
+
+bool WorldReader::fail( const string &why )
+{
+  if ( failure.empty() ) failure = why;
+  return false;
+}
+
+bool WorldReader::read( vector<unsigned char> &message )
+{
+  unsigned char length[4];
+  if ( fread( length, 1, 4, file ) != 4 ) return fail( "the file ends before its end message" );
+
+  const uint32_t size = length[0] | (length[1] << 8) | (length[2] << 16) | (uint32_t(length[3]) << 24);
+  if ( size == 0 || size > MAX_MESSAGE ) return fail( "a message has a bad length" );
+
+  message.resize( size );
+  if ( fread( &message[0], 1, size, file ) != size ) return fail( "the file ends inside a message" );
+  readBytes += 4 + size;
+  return true;
+}
+
+bool WorldReader::next( vector<unsigned char> &message )
+{
+  if ( !isValid() || ended || !read( message ) ) return false;
+
+  MessageReader in( &message[0], message.size() );
+  const int type = in.getU8();
+  if ( type == WORLD_CHUNK ) {
+    in.getI32();
+    in.getI32();
+    in.getI32();
+    putSum( sum, in.getU32() );
+    if ( !in.ok() ) return fail( "a chunk message is cut short" );
+    count++;
+    return true;
+  }
+  if ( type != WORLD_END ) return fail( "a message of unknown type" );
+
+  const int chunks = in.getU32();
+  const uint32_t total = in.getU32();
+  if ( !in.ok() || chunks != count || total != sum )
+    return fail( "the end message doesn't match the chunks before it" );
+  ended = true;
+  return false;
+}
+
+bool WorldReader::decode( const vector<unsigned char> &message, int &x, int &y, int &z,
+                          unsigned short *types )
+{
+  if ( message.empty() ) return false;
+
+  MessageReader in( &message[0], message.size() );
+  if ( in.getU8() != WORLD_CHUNK ) return false;
+  x = in.getI32();
+  y = in.getI32();
+  z = in.getI32();
+  const uint32_t crc = in.getU32();
+  return rleDecode( in, types, Chunk::VOLUME ) && in.left() == 0 &&
+         typesCrc( types, Chunk::VOLUME ) == crc;
+}
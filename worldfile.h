@@ -0,0 +1,112 @@
+// made by inny
+
+#ifndef OPENMINE_WORLDFILE_H
+#define OPENMINE_WORLDFILE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "chunk.h"
+
+// A baked world, as openmine_world writes it and openmine_server --world
+// reads it. The file is a stream of messages framed the same way as on the
+// wire (see net.h): a little endian u32 length covering type and payload,
+// a u8 type, then the payload. A header comes first, a chunk message per
+// chunk in any order, and an end message last.
+//
+// Chunk types go x fastest, then y, then z, whatever order the chunk keeps
+// them in, and the crc is CRC-32 (as zip uses it) over those types as
+// little endian u16s. Files only load into builds with the same chunk size.
+enum WorldMessage
+{
+  WORLD_HEADER = 1,   // u8[4] "OMWD", u32 format, u32 chunk x, y, z size, u32 world x, y, z blocks
+  WORLD_CHUNK,        // i32 x, y, z, u32 crc, rle types
+  WORLD_END           // u32 chunks, u32 crc of every chunk's crc in file order
+};
+
+// carries on from crc, which starts at 0
+uint32_t crc32( const void *data, size_t bytes, uint32_t crc = 0 );
+
+// -----------------------------------------------------------------------------
+
+class WorldWriter
+{
+  public:
+    static const unsigned int FORMAT = 1;
+
+  protected:
+    FILE *file;
+    std::vector<unsigned char> buffer;
+    int count;
+    uint32_t sum;
+    long long written;
+    bool good;
+
+    void put( const std::vector<unsigned char> &message );
+
+  public:
+    // the world's extent in blocks, for whoever loads it
+    WorldWriter( const std::string &path, int xblocks, int yblocks, int zblocks );
+    virtual ~WorldWriter();
+
+    // appends a chunk's message to out and returns its crc. Only reads the
+    // chunk, so any thread can encode while another writes
+    static uint32_t encode( const Chunk &c, std::vector<unsigned char> &out );
+
+    // a message and crc from encode()
+    void write( const std::vector<unsigned char> &message, uint32_t crc );
+
+    // writes the end message and closes, false if anything failed on the way
+    bool finish();
+
+    bool isValid() const { return good; };
+    int chunks() const { return count; };
+    long long bytes() const { return written; };
+};
+
+// -----------------------------------------------------------------------------
+
+// Reads one message at a time, so a file of any size streams through a
+// buffer the size of its largest chunk.
+class WorldReader
+{
+  protected:
+    FILE *file;
+    std::string failure;
+    int chunkSize[3];
+    int worldSize[3];
+    int count;
+    uint32_t sum;
+    bool ended;
+    long long readBytes;
+
+    bool read( std::vector<unsigned char> &message );
+    bool fail( const std::string &why );
+
+  public:
+    WorldReader( const std::string &path );
+    virtual ~WorldReader();
+
+    // the next chunk message, type byte first; false at the end or on a
+    // broken file, see error()
+    bool next( std::vector<unsigned char> &message );
+
+    // unpacks a message from next() into types x fastest; false if it's
+    // cut short or doesn't match its crc. Any thread
+    static bool decode( const std::vector<unsigned char> &message, int &x, int &y, int &z,
+                        unsigned short *types );
+
+    bool isValid() const { return failure.empty(); };
+    const std::string &error() const { return failure; };
+
+    // true once the end message came and agreed with every chunk read
+    bool complete() const { return ended; };
+    uint32_t checksum() const { return sum; };
+
+    int worldBlocks( int axis ) const { return worldSize[axis]; };
+    int chunks() const { return count; };
+    long long bytes() const { return readBytes; };
+};
+
+#endif
@@ -0,0 +1,374 @@
+// made by inny
+
+#include <algorithm>
+#include <cmath>
+#include "util.h"
+#include "column.h"
+#include "meshcache.h"
+#include "workers.h"
+#include "world.h"
+#include "worldgen.h"
+
+using namespace std;
+
+const int WorldGen::reach[WorldGen::STAGES] = { 0, 0, 1, 1 };
+
+// caves are worms of spheres that start in one chunk in four
+static const int CAVE_ODDS = 4;
+static const int CAVE_LENGTH = 24;
+static const float CAVE_RADIUS = 2.5;
+
+// a chunk tries this many tree spots, one in three takes
+static const int TREE_TRIES = 3;
+
+static int caveReach( int size )
+{
+  return int( CAVE_LENGTH + CAVE_RADIUS ) / size + 1;
+}
+
+WorldGen::WorldGen( World &w, WorkerPool &p )
+  : world(w), pool(p), meshes(0), rounds(0)
+{
+  for ( int s = 0; s < STAGES; s++ ) {
+    stageTime[s] = 0.0;
+    stageRuns[s] = 0;
+  }
+}
+
+WorldGen::~WorldGen()
+{
+  for ( EntryMap::iterator it = entries.begin(); it != entries.end(); ++it ) {
+    delete it->second->chunk;
+    delete it->second;
+  }
+}
+
+const char *WorldGen::stageName( int s )
+{
+  switch (s) {
+    case TERRAIN: return "terrain";
+    case CARVERS: return "carvers";
+    case FEATURES: return "features";
+    case CULL: return "cull";
+  }
+  return "unknown";
+}
+
+unsigned int WorldGen::key( int x, int y, int z )
+{
+  const unsigned int xi = (x >> Chunk::XSHIFT) + World::KEY_REACH;
+  const unsigned int yi = y >> Chunk::YSHIFT;
+  const unsigned int zi = (z >> Chunk::ZSHIFT) + World::KEY_REACH;
+  return (yi << 26) | (zi << 13) | xi;
+}
+
+WorldGen::Entry *WorldGen::entryAt( int x, int y, int z )
+{
+  const unsigned int id = key( x, y, z );
+  EntryMap::iterator finder = entries.find( id );
+  if ( finder != entries.end() ) return finder->second;
+
+  Entry *e = new Entry;
+  e->chunk = new Chunk( &world, x, y, z );
+  e->done = 0;
+  e->wanted = false;
+  e->queued = false;
+  e->round = 0;
+  e->seenFor = 0;
+  e->used = 0;
+  entries[id] = e;
+  return e;
+}
+
+void WorldGen::request( float x, float y, float z )
+{
+  const int xp = int( floor( x / Chunk::XSIZE ) ) * Chunk::XSIZE;
+  const int yp = int( floor( y / Chunk::YSIZE ) ) * Chunk::YSIZE;
+  const int zp = int( floor( z / Chunk::ZSIZE ) ) * Chunk::ZSIZE;
+  if ( !world.fitsBounds( xp, yp, zp ) || world.chunkAt( xp, yp, zp ) ) return;
+
+  Entry *e = entryAt( xp, yp, zp );
+  if ( e->wanted ) return;
+  e->wanted = true;
+  wanted.push_back( e );
+}
+
+// -----------------------------------------------------------------------------
+
+// walks back from what e needs to whatever can run now and queues it;
+// true if e has already got that far
+bool WorldGen::need( Entry *e, int stage )
+{
+  e->used = rounds;
+  if ( e->done >= stage ) return true;
+  if ( e->round == rounds && e->seenFor >= stage ) return false;
+  e->round = rounds;
+  e->seenFor = stage;
+  if ( e->queued ) return false;
+
+  const int s = e->done;
+  const int r = reach[s];
+  Chunk *c = e->chunk;
+
+  Job job;
+  job.entry = e;
+  job.stage = s;
+  job.seconds = 0.0;
+  for ( int i = 0; i < 27; i++ ) job.near[i] = 0;
+  job.near[13] = c;
+
+  bool ready = true;
+  for ( int dz = -r; dz <= r; dz++ ) {
+    for ( int dy = -r; dy <= r; dy++ ) {
+      for ( int dx = -r; dx <= r; dx++ ) {
+        if ( !dx && !dy && !dz ) continue;
+        const int x = int(c->x()) + dx * Chunk::XSIZE;
+        const int y = int(c->y()) + dy * Chunk::YSIZE;
+        const int z = int(c->z()) + dz * Chunk::ZSIZE;
+        if ( !world.fitsBounds( x, y, z ) ) continue;
+
+        const int slot = (dx+1) + (dy+1)*3 + (dz+1)*9;
+        Chunk *loaded = world.chunkAt( x, y, z );
+        if (loaded) {
+          job.near[slot] = loaded;
+          continue;
+        }
+
+        Entry *n = entryAt( x, y, z );
+        if ( !need( n, s ) ) ready = false;
+        job.near[slot] = n->chunk;
+      }
+    }
+  }
+
+  if (ready) {
+    e->queued = true;
+    jobs.push_back( job );
+  }
+  return false;
+}
+
+bool WorldGen::step()
+{
+  rounds++;
+  jobs.clear();
+  for ( int i = 0; i < wanted.size(); i++ ) need( wanted[i], STAGES );
+  if ( jobs.empty() ) return false;
+
+  pool.run( jobs.size(), [&]( int i ) { run( jobs[i] ); } );
+
+  for ( int i = 0; i < jobs.size(); i++ ) {
+    Entry *e = jobs[i].entry;
+    e->done++;
+    e->queued = false;
+    stageTime[ jobs[i].stage ] += jobs[i].seconds;
+    stageRuns[ jobs[i].stage ]++;
+
+    // the column is shared, so it only hears about blocks from this thread
+    if ( jobs[i].stage == FEATURES ) e->chunk->publishTops();
+  }
+
+  evict();
+  return true;
+}
+
+void WorldGen::collect( vector<Chunk*> &done )
+{
+  int kept = 0;
+  for ( int i = 0; i < wanted.size(); i++ ) {
+    Entry *e = wanted[i];
+    if ( e->done < STAGES ) {
+      wanted[kept++] = e;
+      continue;
+    }
+    done.push_back( e->chunk );
+    entries.erase( key( e->chunk->x(), e->chunk->y(), e->chunk->z() ) );
+    delete e;
+  }
+  wanted.resize( kept );
+}
+
+// drops the cached chunks nothing looked at for longest; they come out the
+// same if they're ever needed again
+void WorldGen::evict()
+{
+  if ( entries.size() <= wanted.size() + CACHE ) return;
+
+  vector< pair<int, unsigned int> > idle;
+  for ( EntryMap::iterator it = entries.begin(); it != entries.end(); ++it ) {
+    Entry *e = it->second;
+    if ( e->wanted || e->used == rounds ) continue;
+    idle.push_back( make_pair( e->used, it->first ) );
+  }
+  sort( idle.begin(), idle.end() );
+
+  const int extra = entries.size() - wanted.size() - CACHE;
+  for ( int i = 0; i < extra && i < idle.size(); i++ ) {
+    EntryMap::iterator finder = entries.find( idle[i].second );
+    delete finder->second->chunk;
+    delete finder->second;
+    entries.erase( finder );
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void WorldGen::run( Job &job )
+{
+  const double start = seconds();
+  Chunk &c = *job.entry->chunk;
+
+  switch ( job.stage ) {
+    case TERRAIN: c.randomize(); break;
+    case CARVERS: carve( c ); break;
+    case FEATURES: plant( c, job.near ); break;
+    case CULL: cull( c, job.near ); break;
+  }
+
+  job.seconds = seconds() - start;
+}
+
+// sky is culled in no time, so it never goes near the cache. A miss still
+// gathers the records here on the pool, and the chunk uploads the cached
+// copy later rather than gathering them again
+void WorldGen::cull( Chunk &c, Chunk * const *near )
+{
+  if ( !meshes || c.isSky() ) {
+    c.cullFaces( near );
+    return;
+  }
+
+  const unsigned long long key = c.meshKey( near );
+  MeshCache::Mesh mesh;
+  if ( meshes->find( key, mesh ) ) {
+    c.adoptFaces( near, mesh.records, mesh.counts, mesh.fresh );
+    return;
+  }
+
+  c.cullFaces( near );
+  vector<GLuint> records;
+  int counts[Voxel::DIRECTIONS];
+  c.gatherFaces( records, counts );
+  meshes->store( key, records, counts, mesh );
+  c.keepFaces( mesh.records, mesh.counts, mesh.fresh );
+}
+
+// replays every cave that could reach this chunk, then notes where the
+// ground is for the trees. Caves only take blocks away and sky has no
+// ground, so an empty chunk is left as it is
+void WorldGen::carve( Chunk &c )
+{
+  if ( c.isEmpty() ) return;
+
+  const int cx = int(c.x()) >> Chunk::XSHIFT;
+  const int cy = int(c.y()) >> Chunk::YSHIFT;
+  const int cz = int(c.z()) >> Chunk::ZSHIFT;
+  const int rx = caveReach( Chunk::XSIZE );
+  const int ry = caveReach( Chunk::YSIZE );
+  const int rz = caveReach( Chunk::ZSIZE );
+  const float ceiling = 0.5 * float(World::GROUND) - 4.0;
+
+  for ( int oz = cz-rz; oz <= cz+rz; oz++ ) {
+    for ( int oy = cy-ry; oy <= cy+ry; oy++ ) {
+      for ( int ox = cx-rx; ox <= cx+rx; ox++ ) {
+        const unsigned int h = cellHash( ox, oy, oz, 1 );
+        if ( h % CAVE_ODDS != 0 ) continue;
+
+        float px = ox * Chunk::XSIZE + (h >> 4) % Chunk::XSIZE;
+        float py = oy * Chunk::YSIZE + (h >> 12) % Chunk::YSIZE;
+        float pz = oz * Chunk::ZSIZE + (h >> 20) % Chunk::ZSIZE;
+        if ( py >= ceiling || py < 2.0 ) continue;
+        float yaw = (h % 628) / 100.0;
+        float pitch = 0.0;
+
+        for ( int step = 0; step < CAVE_LENGTH; step++ ) {
+          const unsigned int turn = cellHash( ox, oy, oz, 2 + step );
+          const float radius = 1.5 + (turn % 100) / 100.0;
+          yaw += ((turn >> 8) % 100 - 50) / 100.0;
+          pitch = bound( -0.5, pitch + ((turn >> 16) % 100 - 50) / 200.0, 0.5 );
+          px += cos(yaw) * cos(pitch);
+          py = bound( 2.0, py + sin(pitch), ceiling );
+          pz += sin(yaw) * cos(pitch);
+
+          const int x0 = max( 0, int(floor(px - radius - c.x())) );
+          const int x1 = min( Chunk::XSIZE-1, int(floor(px + radius - c.x())) );
+          const int y0 = max( 0, int(floor(py - radius - c.y())) );
+          const int y1 = min( Chunk::YSIZE-1, int(floor(py + radius - c.y())) );
+          const int z0 = max( 0, int(floor(pz - radius - c.z())) );
+          const int z1 = min( Chunk::ZSIZE-1, int(floor(pz + radius - c.z())) );
+
+          for ( int z = z0; z <= z1; z++ )
+            for ( int y = y0; y <= y1; y++ )
+              for ( int x = x0; x <= x1; x++ ) {
+                const float dx = c.x() + x + 0.5 - px;
+                const float dy = c.y() + y + 0.5 - py;
+                const float dz = c.z() + z + 0.5 - pz;
+                if ( dx*dx + dy*dy + dz*dz < radius*radius )
+                  c.types[ Chunk::cell(x, y, z) ] = Voxel::AIR;
+              }
+        }
+      }
+    }
+  }
+
+  // trees only take on the hills, where there's solid ground under the top
+  const int hills = int( 0.5 * float(World::GROUND) ) - int(c.y());
+  for ( int z = 0; z < Chunk::ZSIZE; z++ ) {
+    for ( int x = 0; x < Chunk::XSIZE; x++ ) {
+      short &ground = c.surface[ z * Chunk::XSIZE + x ];
+      ground = -1;
+      for ( int y = Chunk::YSIZE-2; y >= 2 && y >= hills; y-- ) {
+        if ( c.types[ Chunk::cell(x, y+1, z) ] != 0 ) continue;
+        if ( c.types[ Chunk::cell(x, y, z) ] == 0 ) continue;
+        if ( c.types[ Chunk::cell(x, y-1, z) ] && c.types[ Chunk::cell(x, y-2, z) ] ) ground = y;
+        break;
+      }
+    }
+  }
+}
+
+// grows the trees rooted here and in every neighbour, keeping our part
+void WorldGen::plant( Chunk &c, Chunk * const *near )
+{
+  for ( int n = 0; n < 27; n++ ) {
+    const Chunk *origin = near[n];
+    if (!origin) continue;
+
+    const int ox = int(origin->x()), oy = int(origin->y()), oz = int(origin->z());
+    for ( int t = 0; t < TREE_TRIES; t++ ) {
+      const unsigned int h = cellHash( ox >> Chunk::XSHIFT, oy >> Chunk::YSHIFT,
+                                       oz >> Chunk::ZSHIFT, 100 + t );
+      if ( h % 3 != 0 ) continue;
+
+      const int lx = (h >> 4) % Chunk::XSIZE;
+      const int lz = (h >> 12) % Chunk::ZSIZE;
+      const int ground = origin->surface[ lz * Chunk::XSIZE + lx ];
+      if ( ground < 0 ) continue;
+
+      const int bx = ox + lx - int(c.x());
+      const int by = oy + ground + 1 - int(c.y());
+      const int bz = oz + lz - int(c.z());
+      const int trunk = 4 + (h >> 20) % 3;
+
+      // a blob of leaves around the top, rounded off at the corners
+      for ( int dy = trunk-2; dy <= trunk+1; dy++ ) {
+        const int r = dy > trunk-1 ? 1 : 2;
+        for ( int dz = -r; dz <= r; dz++ )
+          for ( int dx = -r; dx <= r; dx++ ) {
+            if ( r == 2 && abs(dx) == 2 && abs(dz) == 2 ) continue;
+            const int x = bx+dx, y = by+dy, z = bz+dz;
+            if ( !Chunk::contains( x, y, z ) || c.types[ Chunk::cell(x, y, z) ] ) continue;
+            c.own();
+            c.types[ Chunk::cell(x, y, z) ] = Voxel::LEAVES;
+          }
+      }
+
+      for ( int dy = 0; dy < trunk; dy++ ) {
+        if ( !Chunk::contains( bx, by+dy, bz ) ) continue;
+        c.own();
+        unsigned short &cell = c.types[ Chunk::cell(bx, by+dy, bz) ];
+        if ( cell == 0 || cell == Voxel::LEAVES ) cell = Voxel::WOOD;
+      }
+    }
+  }
+}
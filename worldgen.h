@@ -0,0 +1,105 @@
+// made by inny
+
+#ifndef OPENMINE_WORLDGEN_H
+#define OPENMINE_WORLDGEN_H
+
+#include <map>
+#include <vector>
+#include "chunk.h"
+
+class World;
+class WorkerPool;
+class MeshCache;
+
+// Chunks are generated in stages, and a stage may read the chunks around it
+// as long as they have got far enough. Features can then cross chunk borders:
+// every chunk works out the caves and trees of its neighbours too and keeps
+// the parts that land inside itself, so nothing is ever written twice.
+//
+// Each round queues every stage whose neighbours are ready and runs them all
+// on the pool. A stage only writes its own chunk and only reads neighbours
+// that are past the stages that write theirs, so rounds need no locks.
+// Chunks made only because a neighbour needed them wait in a bounded cache
+// until they're asked for or pushed out.
+class WorldGen
+{
+  public:
+    enum Stage { TERRAIN, CARVERS, FEATURES, CULL, STAGES };
+
+    // a stage needs every chunk this far around to have finished the stage
+    // before it; one at most, since jobs carry a 3x3x3 block of neighbours
+    static const int reach[STAGES];
+
+    // chunks held beyond the ones asked for
+    static const int CACHE = 512;
+
+  protected:
+    struct Entry
+    {
+      Chunk *chunk;
+      int done;
+      bool wanted;
+      bool queued;
+      int round;
+      int seenFor;
+
+      // the last round anything needed it, done or not
+      int used;
+    };
+
+    struct Job
+    {
+      Entry *entry;
+      int stage;
+      Chunk *near[27];
+      double seconds;
+    };
+
+    World &world;
+    WorkerPool &pool;
+    MeshCache *meshes;
+
+    typedef std::map<unsigned int, Entry*> EntryMap;
+    EntryMap entries;
+    std::vector<Entry*> wanted;
+    std::vector<Job> jobs;
+    int rounds;
+
+    double stageTime[STAGES];
+    int stageRuns[STAGES];
+
+    static unsigned int key( int x, int y, int z );
+    Entry *entryAt( int x, int y, int z );
+    bool need( Entry *e, int stage );
+    void evict();
+
+    void run( Job &job );
+    void cull( Chunk &c, Chunk * const *near );
+    static void carve( Chunk &c );
+    static void plant( Chunk &c, Chunk * const *near );
+
+  public:
+    WorldGen( World &w, WorkerPool &p );
+    virtual ~WorldGen();
+
+    // x, y, z is any point inside the chunk
+    void request( float x, float y, float z );
+
+    // the cull stage looks meshes up here first and leaves new ones in it;
+    // none by default
+    void useMeshes( MeshCache *cache ) { meshes = cache; };
+
+    // runs one round, false when nothing was left to run
+    bool step();
+
+    // hands over the asked for chunks that are done, the world owns them now
+    void collect( std::vector<Chunk*> &done );
+
+    int pending() const { return wanted.size(); };
+    int cached() const { return entries.size(); };
+    double stageSeconds( int s ) const { return stageTime[s]; };
+    int stageCount( int s ) const { return stageRuns[s]; };
+    static const char *stageName( int s );
+};
+
+#endif
@@ -0,0 +1,243 @@
+// made by inny
+
+// openmine_world: bakes worlds ahead of time, without any window or GL
+// context. export generates a disc of chunk columns a band at a time on the
+// worker pool and streams each band out to a world file (see worldfile.h)
+// before moving on. A band spans the disc, so memory grows with the radius
+// but not with the disc's area. import loads a file into a World the way
+// the server would, and verify reads one through, checking every chunk, and
+// keeps nothing.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "memstats.h"
+#include "workers.h"
+#include "world.h"
+#include "worldgen.h"
+#include "worldfile.h"
+
+using namespace std;
+
+// chunks decoded on the pool at once when reading
+static const int BATCH = 256;
+
+static void usage()
+{
+  cerr << "usage: openmine_world export <file> [--radius chunks] [--band rows] [--threads n]\n"
+       << "       openmine_world import <file> [--threads n]\n"
+       << "       openmine_world verify <file> [--threads n]\n";
+}
+
+static void reportRate( long long bytes, int chunks, double elapsed )
+{
+  elapsed = max( elapsed, 1e-6 );
+  cout << fixed << setprecision(2)
+       << "  " << bytes / (1024.0 * 1024.0) << " MB in " << elapsed << " s, "
+       << bytes / (1024.0 * 1024.0) / elapsed << " MB/s, "
+       << setprecision(0) << chunks / elapsed << " chunks/s\n";
+}
+
+// -----------------------------------------------------------------------------
+
+// the disc is centred in an extent just big enough for it, rows of chunk
+// columns along x make a band, and the band before stays loaded while the
+// next one generates so the chunks on their border aren't made twice
+static int exportWorld( const string &path, int radius, int band, int threads )
+{
+  World world;
+  world.useWorkers( threads );
+  const int across = 2 * radius + 1;
+  world.setExtent( across * Chunk::XSIZE, across * Chunk::ZSIZE );
+
+  WorldWriter writer( path, world.extentBlocksX(), World::YBLOCKS, world.extentBlocksZ() );
+  if ( !writer.isValid() ) {
+    cerr << "openmine_world: can't write " << path << "\n";
+    return 1;
+  }
+
+  const double start = seconds();
+  double generating = 0.0;
+  double writing = 0.0;
+  long long peakVoxels = 0;
+  int columns = 0;
+
+  vector<Chunk*> previous, current;
+  vector< vector<unsigned char> > messages;
+  vector<uint32_t> crcs;
+  for ( int z0 = 0; z0 < across; z0 += band ) {
+    double t = seconds();
+    for ( int z = z0; z < min( z0 + band, across ); z++ ) {
+      for ( int x = 0; x < across; x++ ) {
+        const int dx = x - radius, dz = z - radius;
+        if ( dx*dx + dz*dz > radius*radius ) continue;
+        columns++;
+        for ( int y = 0; y < World::YSIZE; y++ )
+          world.generation().request( x * Chunk::XSIZE, y * Chunk::YSIZE, z * Chunk::ZSIZE );
+      }
+    }
+    current.clear();
+    world.generateRequested( current );
+    peakVoxels = max( peakVoxels, MemoryStats::get( MemoryStats::CHUNK_VOXELS ) );
+    generating += seconds() - t;
+
+    // chunks finish in whatever order the pool got to them, the file
+    // doesn't, so baking twice gives the same bytes
+    t = seconds();
+    sort( current.begin(), current.end(), []( Chunk *a, Chunk *b ) {
+      if ( a->z() != b->z() ) return a->z() < b->z();
+      if ( a->y() != b->y() ) return a->y() < b->y();
+      return a->x() < b->x();
+    });
+    messages.resize( current.size() );
+    crcs.resize( current.size() );
+    world.workers().run( current.size(), [&]( int i ) {
+      messages[i].clear();
+      crcs[i] = WorldWriter::encode( *current[i], messages[i] );
+    });
+    for ( int i = 0; i < current.size(); i++ ) writer.write( messages[i], crcs[i] );
+    writing += seconds() - t;
+
+    for ( int i = 0; i < previous.size(); i++ ) world.unloadChunk( previous[i] );
+    world.reclaim();
+    previous.swap( current );
+  }
+
+  if ( !writer.finish() ) {
+    cerr << "openmine_world: writing " << path << " failed\n";
+    return 1;
+  }
+
+  cout << "export: " << writer.chunks() << " chunks in " << columns << " columns, radius "
+       << radius << ", to " << path << "\n";
+  reportRate( writer.bytes(), writer.chunks(), seconds() - start );
+  cout << fixed << setprecision(2)
+       << "  generate " << generating << " s, encode and write " << writing << " s, "
+       << world.workers().size() << " threads, peak voxels "
+       << peakVoxels / (1024.0 * 1024.0) << " MB\n";
+  return 0;
+}
+
+// reads batches of chunks, checks them on the pool, and hands each one that
+// passed to place on this thread
+template<typename F>
+static int readWorld( WorldReader &reader, WorkerPool &pool, F place )
+{
+  vector< vector<unsigned char> > messages( BATCH );
+  vector< vector<unsigned short> > types( BATCH, vector<unsigned short>( Chunk::VOLUME ) );
+  vector<int> where( BATCH * 3 );
+  vector<char> good( BATCH );
+
+  int bad = 0;
+  while ( reader.isValid() && !reader.complete() ) {
+    int n = 0;
+    while ( n < BATCH && reader.next( messages[n] ) ) n++;
+
+    pool.run( n, [&]( int i ) {
+      good[i] = WorldReader::decode( messages[i], where[i*3], where[i*3+1], where[i*3+2], &types[i][0] );
+    });
+    for ( int i = 0; i < n; i++ ) {
+      if (!good[i]) bad++;
+      else place( where[i*3], where[i*3+1], where[i*3+2], &types[i][0] );
+    }
+  }
+  return bad;
+}
+
+static int importWorld( const string &path, int threads )
+{
+  WorldReader reader( path );
+  if ( !reader.isValid() ) {
+    cerr << "openmine_world: " << reader.error() << "\n";
+    return 1;
+  }
+
+  World world;
+  world.useWorkers( threads );
+  world.setExtent( reader.worldBlocks(0), reader.worldBlocks(2) );
+
+  const double start = seconds();
+  int placed = 0;
+  const int bad = readWorld( reader, world.workers(),
+    [&]( int x, int y, int z, const unsigned short *types ) {
+      if ( world.placeChunk( x, y, z, types ) ) placed++;
+    });
+  const double elapsed = seconds() - start;
+
+  cout << "import: " << placed << " of " << reader.chunks() << " chunks from " << path
+       << " into a " << world.extentBlocksX() << "x" << World::YBLOCKS << "x"
+       << world.extentBlocksZ() << " world\n";
+  reportRate( reader.bytes(), reader.chunks(), elapsed );
+  cout << fixed << setprecision(2) << "  voxels "
+       << MemoryStats::get( MemoryStats::CHUNK_VOXELS ) / (1024.0 * 1024.0) << " MB\n";
+
+  if ( !reader.isValid() ) cerr << "openmine_world: " << reader.error() << "\n";
+  if ( bad ) cerr << "openmine_world: " << bad << " chunks failed their checksum\n";
+  return ( reader.complete() && !bad ) ? 0 : 1;
+}
+
+static int verifyWorld( const string &path, int threads )
+{
+  WorldReader reader( path );
+  if ( !reader.isValid() ) {
+    cerr << "openmine_world: " << reader.error() << "\n";
+    return 1;
+  }
+
+  WorkerPool pool( threads );
+  const double start = seconds();
+  long long solid = 0;
+  const int bad = readWorld( reader, pool,
+    [&]( int, int, int, const unsigned short *types ) {
+      for ( int i = 0; i < Chunk::VOLUME; i++ ) solid += (types[i] != 0);
+    });
+  const double elapsed = seconds() - start;
+
+  cout << "verify: " << reader.chunks() << " chunks in " << path << ", world "
+       << reader.worldBlocks(0) << "x" << reader.worldBlocks(1) << "x" << reader.worldBlocks(2)
+       << ", " << solid << " solid blocks, checksum " << hex << setw(8) << setfill('0')
+       << reader.checksum() << dec << setfill(' ') << "\n";
+  reportRate( reader.bytes(), reader.chunks(), elapsed );
+
+  if ( !reader.isValid() ) cerr << "openmine_world: " << reader.error() << "\n";
+  if ( bad ) cerr << "openmine_world: " << bad << " chunks failed their checksum\n";
+  const bool ok = reader.complete() && !bad;
+  cout << "  " << (ok ? "ok" : "broken") << "\n";
+  return ok ? 0 : 1;
+}
+
+// -----------------------------------------------------------------------------
+
+int main( int argc, char **argv )
+{
+  if ( argc < 3 ) {
+    usage();
+    return 1;
+  }
+  const string command = argv[1];
+  const string path = argv[2];
+  int radius = 8;
+  int band = 4;
+  int threads = 0;
+
+  for ( int i = 3; i+1 < argc; i++ ) {
+    const string arg = argv[i];
+    if ( arg == "--radius" ) radius = atoi( argv[++i] );
+    else if ( arg == "--band" ) band = atoi( argv[++i] );
+    else if ( arg == "--threads" ) threads = atoi( argv[++i] );
+  }
+
+  // chunk keys stop KEY_REACH chunks out from the origin
+  radius = bound( 0, radius, (World::KEY_REACH - 1) / 2 );
+  band = max( band, 1 );
+
+  if ( command == "export" ) return exportWorld( path, radius, band, threads );
+  if ( command == "import" ) return importWorld( path, threads );
+  if ( command == "verify" ) return verifyWorld( path, threads );
+  usage();
+  return 1;
+}